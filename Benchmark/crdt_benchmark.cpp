@@ -0,0 +1,96 @@
+#include <random>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "document.h"
+#include "crdt_document.h"
+#include "text_fixture.h"
+
+constexpr size_t inlineStringCapacity = 15;
+
+size_t documentMemoryUsage(Document& doc) {
+	const auto& lines = doc.get();
+	size_t bytes = sizeof(doc) + lines.capacity() * sizeof(std::string);
+	for (const auto& line : lines) {
+		if (line.capacity() > inlineStringCapacity) {
+			bytes += line.capacity() + 1;
+		}
+	}
+	return bytes;
+}
+
+static void BM_DocumentTyping(benchmark::State& state) {
+	for (auto _ : state) {
+		Document doc;
+		for (int i = 0; i < state.range(0); i++) {
+			doc.write(static_cast<char>('a' + i % 26));
+		}
+		state.counters["bytes"] = static_cast<double>(documentMemoryUsage(doc));
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DocumentTyping)->RangeMultiplier(8)->Range(1 << 9, 1 << 15);
+
+static void BM_CrdtTyping(benchmark::State& state) {
+	for (auto _ : state) {
+		crdt::CrdtDocument doc{ 1 };
+		for (int i = 0; i < state.range(0); i++) {
+			doc.insert(i, std::string{ static_cast<char>('a' + i % 26) });
+		}
+		state.counters["bytes"] = static_cast<double>(doc.memoryUsage());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CrdtTyping)->RangeMultiplier(8)->Range(1 << 9, 1 << 15);
+
+static void BM_DocumentRandomEdits(benchmark::State& state) {
+	const std::string text = makeText(static_cast<int>(state.range(0)));
+	std::mt19937 engine{ 0 };
+	Document doc{ text };
+	const SHORT lines = static_cast<SHORT>(doc.get().size());
+	for (auto _ : state) {
+		COORD pos{ static_cast<SHORT>(engine() % (lineLength - 1)), static_cast<SHORT>(engine() % (lines - 1)) };
+		if (doc.setCursorPos(pos)) {
+			doc.write('x');
+			doc.erase();
+		}
+	}
+	state.counters["bytes"] = static_cast<double>(documentMemoryUsage(doc));
+	state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_DocumentRandomEdits)->RangeMultiplier(8)->Range(1 << 12, 1 << 18);
+
+static void BM_CrdtRandomEdits(benchmark::State& state) {
+	crdt::CrdtDocument doc{ 1 };
+	doc.setText(makeText(static_cast<int>(state.range(0))));
+	std::mt19937 engine{ 0 };
+	for (auto _ : state) {
+		size_t pos = engine() % doc.size();
+		doc.insert(pos, "x");
+		doc.erase(pos, 1);
+	}
+	state.counters["bytes"] = static_cast<double>(doc.memoryUsage());
+	state.counters["runs"] = static_cast<double>(doc.runCount());
+	doc.collectGarbage({ { 1, doc.getClock() } });
+	state.counters["bytesAfterGc"] = static_cast<double>(doc.memoryUsage());
+	state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_CrdtRandomEdits)->RangeMultiplier(8)->Range(1 << 12, 1 << 18);
+
+static void BM_CrdtApplyRemoteTyping(benchmark::State& state) {
+	crdt::CrdtDocument author{ 1 };
+	std::vector<crdt::Op> ops;
+	for (int i = 0; i < state.range(0); i++) {
+		ops.push_back(author.insert(i, std::string{ static_cast<char>('a' + i % 26) }));
+	}
+	for (auto _ : state) {
+		crdt::CrdtDocument replica{ 2 };
+		for (const auto& op : ops) {
+			replica.apply(op);
+		}
+		benchmark::DoNotOptimize(replica.size());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CrdtApplyRemoteTyping)->RangeMultiplier(8)->Range(1 << 9, 1 << 15);
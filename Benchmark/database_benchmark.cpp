@@ -0,0 +1,86 @@
+#include <string>
+#include <fstream>
+#include <cstdio>
+
+#include <benchmark/benchmark.h>
+
+#include "database.h"
+#include "scratch.h"
+#include "logger.h"
+
+#pragma push_macro("ERROR")
+#undef ERROR
+
+const std::string benchmarkDb = "benchmark_users.csv";
+const std::string databaseLog = "database_benchmark.log";
+
+std::string rowUuid(const int64_t row) {
+	char uuid[37];
+	snprintf(uuid, sizeof(uuid), "00000000-0000-4000-8000-%012lld", static_cast<long long>(row));
+	return uuid;
+}
+
+std::string rowUsername(const int64_t row) {
+	return "user" + std::to_string(row);
+}
+
+// Written directly, creating a million users through Database::create would take hours
+void populateUsers(const int64_t rows) {
+	std::ofstream db(benchmarkDb, std::ios::out | std::ios::trunc);
+	for (int64_t i = 0; i < rows; i++) {
+		db << rowUuid(i) << "," << rowUsername(i) << ",password\n";
+	}
+}
+
+void userRows(benchmark::internal::Benchmark* benchmark) {
+	benchmark->ArgName("rows")->Arg(1000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+}
+
+// Every create scans the whole file for a duplicate username before appending
+static void BM_DatabaseCreate(benchmark::State& state) {
+	populateUsers(state.range(0));
+	logs::Logger logger(databaseLog, logs::Level::ERROR);
+	db::Database<db::User> users(benchmarkDb, logger);
+	int64_t created = 0;
+	for (auto _ : state) {
+		db::User user{ "new" + std::to_string(created++), "password" };
+		benchmark::DoNotOptimize(users.create(user));
+		// As the server does after each request, scanned rows are parsed in the scratch arena
+		scratch::Arena::local().reset();
+	}
+	state.SetItemsProcessed(state.iterations());
+	std::remove(benchmarkDb.c_str());
+}
+BENCHMARK(BM_DatabaseCreate)->Apply(userRows);
+
+// The row in the middle, on average a lookup scans half of the file
+static void BM_DatabaseRead(benchmark::State& state) {
+	populateUsers(state.range(0));
+	logs::Logger logger(databaseLog, logs::Level::ERROR);
+	db::Database<db::User> users(benchmarkDb, logger);
+	const std::string uuid = rowUuid(state.range(0) / 2);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(users.read(uuid));
+		scratch::Arena::local().reset();
+	}
+	state.SetItemsProcessed(state.iterations());
+	std::remove(benchmarkDb.c_str());
+}
+BENCHMARK(BM_DatabaseRead)->Apply(userRows);
+
+// Login looks users up by username
+static void BM_DatabaseReadWithAttribute(benchmark::State& state) {
+	populateUsers(state.range(0));
+	logs::Logger logger(databaseLog, logs::Level::ERROR);
+	db::Database<db::User> users(benchmarkDb, logger);
+	const std::string username = rowUsername(state.range(0) / 2);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(users.readWithAttribute(username, 1));
+		scratch::Arena::local().reset();
+	}
+	state.SetItemsProcessed(state.iterations());
+	std::remove(benchmarkDb.c_str());
+}
+BENCHMARK(BM_DatabaseReadWithAttribute)->Apply(userRows);
+
+#pragma pop_macro("ERROR")
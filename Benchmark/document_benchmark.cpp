@@ -0,0 +1,90 @@
+#include <string>
+#include <algorithm>
+
+#include <benchmark/benchmark.h>
+
+#include "document.h"
+#include "text_fixture.h"
+
+enum EditPosition { atStart, inMiddle, atEnd };
+
+/*
+	Edits go round a region of lines at the start, in the middle or at the end of the document,
+	the middle of each line. After editsPerLine rounds the text is set back, so lines do not
+	grow or shrink without bound and every iteration sees the same document size.
+*/
+constexpr int editsPerLine = 32;
+
+struct EditRegion {
+	SHORT first;
+	SHORT lines;
+};
+
+EditRegion editRegion(Document& doc, const int64_t position) {
+	const SHORT total = static_cast<SHORT>(doc.get().size());
+	const SHORT lines = (std::max)(SHORT{ 1 }, static_cast<SHORT>(total / 8));
+	switch (position) {
+	case atStart:
+		return { 0, lines };
+	case inMiddle:
+		return { static_cast<SHORT>((total - lines) / 2), lines };
+	default:
+		// The last line has no '\n' and may be shorter
+		return { static_cast<SHORT>((std::max)(0, total - lines - 1)), lines };
+	}
+}
+
+template<typename EDIT>
+void runEdits(benchmark::State& state, EDIT edit) {
+	const std::string text = makeText(static_cast<int>(state.range(0)));
+	Document doc{ text };
+	const EditRegion region = editRegion(doc, state.range(1));
+	int64_t i = 0;
+	for (auto _ : state) {
+		if (i == static_cast<int64_t>(region.lines) * editsPerLine) {
+			state.PauseTiming();
+			doc.setText(text);
+			i = 0;
+			state.ResumeTiming();
+		}
+		doc.setCursorPos(COORD{ lineLength / 2, static_cast<SHORT>(region.first + i++ % region.lines) });
+		benchmark::DoNotOptimize(edit(doc));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+// Sizes 1KB, 64KB and 1MB at every edit position
+void documentSizesAndPositions(benchmark::internal::Benchmark* benchmark) {
+	benchmark->ArgNames({ "size", "position" });
+	benchmark->ArgsProduct({ { 1 << 10, 1 << 16, 1 << 20 }, { atStart, inMiddle, atEnd } });
+}
+
+static void BM_DocumentWrite(benchmark::State& state) {
+	runEdits(state, [](Document& doc) { return doc.write('x'); });
+}
+BENCHMARK(BM_DocumentWrite)->Apply(documentSizesAndPositions);
+
+static void BM_DocumentErase(benchmark::State& state) {
+	runEdits(state, [](Document& doc) { return doc.erase(); });
+}
+BENCHMARK(BM_DocumentErase)->Apply(documentSizesAndPositions);
+
+static void BM_DocumentSetText(benchmark::State& state) {
+	const std::string text = makeText(static_cast<int>(state.range(0)));
+	Document doc;
+	for (auto _ : state) {
+		doc.setText(text);
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DocumentSetText)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+
+static void BM_DocumentGetText(benchmark::State& state) {
+	Document doc{ makeText(static_cast<int>(state.range(0))) };
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(doc.getText());
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DocumentGetText)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
@@ -0,0 +1,88 @@
+#include <string>
+#include <chrono>
+#include <ctime>
+
+#include <benchmark/benchmark.h>
+
+#include "logger.h"
+
+#pragma push_macro("ERROR")
+#undef ERROR
+
+const std::string benchmarkLog = "benchmark.log";
+const std::string typed = "letters";
+
+// The same line Repository::writeToDoc logs on every keystroke
+static void BM_LogEnabled(benchmark::State& state) {
+	logs::Logger logger(benchmarkLog);
+	int x = 0;
+	for (auto _ : state) {
+		logger.log(logs::Level::INFO, "[", x++, ",", 7, "] wrote '", typed, "'");
+	}
+	logger.flush();
+	state.counters["dropped"] = static_cast<double>(logger.droppedCount());
+}
+BENCHMARK(BM_LogEnabled);
+
+static void BM_LogBinary(benchmark::State& state) {
+	logs::Logger logger(benchmarkLog, logs::Level::DEBUG, logs::Encoding::binary);
+	int x = 0;
+	for (auto _ : state) {
+		LOG_INFO(logger, "[", x++, ",", 7, "] wrote '", typed, "'");
+	}
+	logger.flush();
+	state.counters["dropped"] = static_cast<double>(logger.droppedCount());
+}
+BENCHMARK(BM_LogBinary);
+
+static void BM_LogDisabledAtRuntime(benchmark::State& state) {
+	logs::Logger logger(benchmarkLog, logs::Level::ERROR);
+	int x = 0;
+	for (auto _ : state) {
+		logger.log(logs::Level::INFO, "[", x++, ",", 7, "] wrote '", typed, "'");
+	}
+}
+BENCHMARK(BM_LogDisabledAtRuntime);
+
+// log() still builds its arguments, the macro skips them together with the call
+static void BM_LogBuiltArgumentsDisabledAtRuntime(benchmark::State& state) {
+	logs::Logger logger(benchmarkLog, logs::Level::INFO);
+	for (auto _ : state) {
+		logger.log(logs::Level::DEBUG, "Not found obj with uuid: " + typed + " from db");
+	}
+}
+BENCHMARK(BM_LogBuiltArgumentsDisabledAtRuntime);
+
+// In release builds (LOGS_COMPILED_LEVEL 1) this measures a call site compiled out entirely
+static void BM_LogMacroDisabled(benchmark::State& state) {
+	logs::Logger logger(benchmarkLog, logs::Level::INFO);
+	for (auto _ : state) {
+		LOG_DEBUG(logger, "Not found obj with uuid: " + typed + " from db");
+	}
+}
+BENCHMARK(BM_LogMacroDisabled);
+
+// What every line used to cost before timestamps were cached
+static void BM_TimestampCtime(benchmark::State& state) {
+	std::string out;
+	for (auto _ : state) {
+		time_t timestamp = time(nullptr);
+		char timeBuffer[100];
+		ctime_s(timeBuffer, 100, &timestamp);
+		out.assign(timeBuffer);
+		benchmark::DoNotOptimize(out.data());
+	}
+}
+BENCHMARK(BM_TimestampCtime);
+
+static void BM_TimestampCached(benchmark::State& state) {
+	std::string out;
+	for (auto _ : state) {
+		out.clear();
+		logs::appendTimestamp(out, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+		benchmark::DoNotOptimize(out.data());
+	}
+}
+BENCHMARK(BM_TimestampCached);
+
+#pragma pop_macro("ERROR")
@@ -0,0 +1,32 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+/*
+	Like BENCHMARK_MAIN, but results also go to benchmark_results.json unless --benchmark_out
+	is given. Two such files are compared with tools/compare.py from Google Benchmark, e.g.
+	compare.py benchmarks baseline.json benchmark_results.json
+*/
+int main(int argc, char** argv) {
+	std::vector<char*> args{ argv, argv + argc };
+	bool hasOut = false;
+	for (const std::string_view arg : args) {
+		hasOut = hasOut || arg.substr(0, 16) == "--benchmark_out=";
+	}
+	std::string out = "--benchmark_out=benchmark_results.json";
+	std::string format = "--benchmark_out_format=json";
+	if (!hasOut) {
+		args.push_back(out.data());
+		args.push_back(format.data());
+	}
+	int count = static_cast<int>(args.size());
+	benchmark::Initialize(&count, args.data());
+	if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,59 @@
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "messages.h"
+
+const std::string keystroke = "x";
+const COORD cursor{ 40, 1200 };
+
+// The fixed layout of the first version and the current varint one with sentAt
+void messageVersions(benchmark::internal::Benchmark* benchmark) {
+	benchmark->ArgName("version")->Arg(1)->Arg(msg::timedVersion);
+}
+
+msg::Buffer serializedWrite(const int version) {
+	msg::Buffer buffer{ 128 };
+	msg::Write{ version, 0, 7, cursor, keystroke, 1000, 123456 }.serializeTo(buffer);
+	return buffer;
+}
+
+static void BM_WriteSerialize(benchmark::State& state) {
+	msg::Buffer buffer{ 128 };
+	msg::Write message{ static_cast<int>(state.range(0)), 0, 7, cursor, keystroke, 1000, 123456 };
+	for (auto _ : state) {
+		buffer.clear();
+		message.serializeTo(buffer);
+		benchmark::DoNotOptimize(buffer.get());
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size);
+}
+BENCHMARK(BM_WriteSerialize)->Apply(messageVersions);
+
+static void BM_WriteParse(benchmark::State& state) {
+	auto buffer = serializedWrite(static_cast<int>(state.range(0)));
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(msg::Write::parse(buffer));
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size);
+}
+BENCHMARK(BM_WriteParse)->Apply(messageVersions);
+
+// What the server parses on the hot path, no copy of the text
+static void BM_WriteViewParse(benchmark::State& state) {
+	auto buffer = serializedWrite(static_cast<int>(state.range(0)));
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(msg::WriteView::parse(buffer));
+	}
+	state.SetBytesProcessed(state.iterations() * buffer.size);
+}
+BENCHMARK(BM_WriteViewParse)->Apply(messageVersions);
+
+static void BM_HeaderParse(benchmark::State& state) {
+	auto buffer = serializedWrite(msg::timedVersion);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(msg::Header::parse(buffer));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HeaderParse);
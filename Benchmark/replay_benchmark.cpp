@@ -0,0 +1,70 @@
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+
+#include <benchmark/benchmark.h>
+
+#include "trace.h"
+
+#pragma push_macro("ERROR")
+#undef ERROR
+
+const std::string replayUserDb = "replay_users.csv";
+const std::string replayDocDb = "replay_docs.csv";
+const std::string replayLog = "replay_benchmark.log";
+
+// Document files the replay created are named after the rows of its doc db
+void removeReplayFiles() {
+	{
+		std::ifstream docs(replayDocDb);
+		std::string row;
+		while (std::getline(docs, row)) {
+			const auto userStart = row.find(',') + 1;
+			const auto filenameStart = row.find(',', userStart) + 1;
+			std::remove((row.substr(userStart, filenameStart - userStart - 1) + "-" + row.substr(filenameStart)).c_str());
+		}
+	}
+	std::remove(replayUserDb.c_str());
+	std::remove(replayDocDb.c_str());
+}
+
+/*
+	Replays the trace captured by a server started with a trace file, path taken from
+	TEXTEDITOR_TRACE. Argument 0 feeds the requests back to back, 1 keeps the recorded gaps.
+	Each iteration starts from empty databases, so run it in a scratch directory.
+*/
+static void BM_ReplayTrace(benchmark::State& state) {
+	const char* path = std::getenv("TEXTEDITOR_TRACE");
+	if (path == nullptr) {
+		state.SkipWithError("TEXTEDITOR_TRACE is not set");
+		return;
+	}
+	const auto pace = state.range(0) == 0 ? trace::Pace::flatOut : trace::Pace::original;
+	logs::Logger logger(replayLog, logs::Level::ERROR);
+	metrics::HistogramSnapshot processNs;
+	trace::ReplayReport report;
+	for (auto _ : state) {
+		trace::Reader reader{ path };
+		if (!reader.valid()) {
+			state.SkipWithError("Not a trace file");
+			return;
+		}
+		{
+			Repository repo{ replayUserDb, replayDocDb, logger };
+			trace::Replayer replayer{ repo };
+			report = replayer.run(reader, pace);
+		}
+		state.SetIterationTime(std::chrono::duration<double>(report.elapsed).count());
+		processNs.add(report.processNs);
+		removeReplayFiles();
+	}
+	state.SetItemsProcessed(state.iterations() * report.requests);
+	state.counters["errors"] = static_cast<double>(report.errors);
+	state.counters["p50_ns"] = static_cast<double>(processNs.quantile(0.5));
+	state.counters["p99_ns"] = static_cast<double>(processNs.quantile(0.99));
+	state.counters["p999_ns"] = static_cast<double>(processNs.quantile(0.999));
+}
+BENCHMARK(BM_ReplayTrace)->ArgName("originalPace")->Arg(0)->Arg(1)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+#pragma pop_macro("ERROR")
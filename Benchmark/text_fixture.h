@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+
+constexpr int lineLength = 64;
+
+// Lines of lineLength characters with the '\n', letters cycling through the alphabet
+inline std::string makeText(const int size) {
+	std::string text;
+	text.reserve(size);
+	for (int i = 0; i < size; i++) {
+		text += (i + 1) % lineLength == 0 ? '\n' : static_cast<char>('a' + i % 26);
+	}
+	return text;
+}
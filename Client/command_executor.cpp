@@ -13,19 +13,34 @@ std::pair<std::string, int> CommandExecutor::processCommand(const std::string& c
 	std::string msg;
 	switch (commandType) {
 	case CommandType::registration:
-		tcpClient.sendMsg<msg::Register>(1, 0, commandVec[1], commandVec[2]);
+		tcpClient.sendMsg<msg::Register>(clientVer, 0, commandVec[1], commandVec[2]);
 		break;
 	case CommandType::login:
-		tcpClient.sendMsg<msg::Login>(1, 0, commandVec[1], commandVec[2]);
+		tcpClient.sendMsg<msg::Login>(clientVer, 0, commandVec[1], commandVec[2]);
 		break;
 	case CommandType::create:
-		tcpClient.sendMsg<msg::Create>(1, 0, tcpClient.getUserId(), commandVec[1]);
+		tcpClient.sendMsg<msg::Create>(clientVer, 0, tcpClient.getUserId(), commandVec[1]);
 		break;
 	case CommandType::load:
-		tcpClient.sendMsg<msg::Load>(1, 0, tcpClient.getUserId(), commandVec[1]);
+		tcpClient.sendMsg<msg::Load>(clientVer, 0, tcpClient.getUserId(), commandVec[1]);
 		break;
 	case CommandType::join:
-		tcpClient.sendMsg<msg::Join>(1, 0, tcpClient.getUserId(), commandVec[1]);
+		tcpClient.sendMsg<msg::Join>(clientVer, 0, tcpClient.getUserId(), commandVec[1]);
+		break;
+	case CommandType::resync:
+		if (tcpClient.resync()) {
+			return { "Cannot reach the server", 1 };
+		}
+		break;
+	case CommandType::stats: {
+		const std::string prefix = commandVec.size() > 1 ? commandVec[1] : "";
+		tcpClient.sendMsg<msg::Stats>(clientVer, 0, prefix);
+		auto [text, code] = tcpClient.waitForResponse();
+		// Server metrics first, then the ones only this client can measure
+		return { text + tcpClient.latencyReport(prefix), code };
+	}
+	case CommandType::spans:
+		tcpClient.sendMsg<msg::Spans>(clientVer, 0, tcpClient.getUserId());
 		break;
 	case CommandType::help:
 		return {
@@ -33,7 +48,10 @@ std::pair<std::string, int> CommandExecutor::processCommand(const std::string& c
 			"login <username> <password>\n"
 			"create <filename>\n"
 			"load <filename>\n"
-			"join <access_code>\n", 0 };
+			"join <access_code>\n"
+			"resync\n"
+			"stats [metric_prefix]\n"
+			"spans\n", 0 };
 	case CommandType::err:
 		msg = errMsg;
 		errMsg = "";
@@ -93,6 +111,19 @@ CommandExecutor::CommandType CommandExecutor::checkCommandType(const std::vector
 		desiredSize = 2;
 		commandType = CommandType::join;
 	}
+	else if (typeStr == "resync") {
+		desiredSize = 1;
+		commandType = CommandType::resync;
+	}
+	else if (typeStr == "stats") {
+		// The prefix is optional, without it every metric is shown
+		desiredSize = args.size() == 2 ? 2 : 1;
+		commandType = CommandType::stats;
+	}
+	else if (typeStr == "spans") {
+		desiredSize = 1;
+		commandType = CommandType::spans;
+	}
 	else if (typeStr == "help") {
 		desiredSize = 1;
 		commandType = CommandType::help;
@@ -5,7 +5,7 @@
 
 class CommandExecutor {
 public:
-	enum class CommandType {registration, login, create, load, join, help, exit, err};
+	enum class CommandType {registration, login, create, load, join, resync, stats, spans, help, exit, err};
 
 	CommandExecutor(Client& tcpClient);
 	std::pair<std::string, int> processCommand(const std::string& command);
@@ -0,0 +1,154 @@
+#include "edit_batcher.h"
+
+bool samePos(const COORD& first, const COORD& second) {
+	return first.X == second.X && first.Y == second.Y;
+}
+
+COORD endOfWrite(COORD pos, const std::string& text) {
+	for (const auto letter : text) {
+		if (letter == '\n') {
+			pos.X = 0;
+			pos.Y++;
+		}
+		else {
+			pos.X++;
+		}
+	}
+	return pos;
+}
+
+EditBatcher::EditBatcher(Client& tcpClient, const int version, std::chrono::milliseconds window, const size_t maxBytes) :
+	tcpClient(tcpClient),
+	version(version),
+	window(window),
+	maxBytes(maxBytes),
+	flusher(&EditBatcher::flushWhenDue, this) {}
+
+EditBatcher::~EditBatcher() {
+	{
+		std::scoped_lock guard{ lock };
+		flushLocked();
+		stopping = true;
+	}
+	wakeUp.notify_one();
+	flusher.join();
+}
+
+void EditBatcher::write(const COORD docCursorPos, const std::string& text) {
+	std::scoped_lock guard{ lock };
+	const bool firstPending = edits.empty();
+	COORD pos = nextPos(docCursorPos);
+	if (!edits.empty() && edits.back().type == msg::MessageType::write) {
+		edits.back().text += text;
+	}
+	else {
+		edits.push_back(PendingEdit{ msg::MessageType::write, pos, text, 0 });
+	}
+	expectedCursor = endOfWrite(pos, text);
+	cursorKnown = true;
+	pendingBytes += text.size();
+	if (firstPending) {
+		firstEditTime = std::chrono::steady_clock::now();
+		wakeUp.notify_one();
+	}
+	if (pendingBytes >= maxBytes) {
+		flushLocked();
+	}
+}
+
+void EditBatcher::erase(const COORD docCursorPos) {
+	std::scoped_lock guard{ lock };
+	const bool firstPending = edits.empty();
+	COORD pos = nextPos(docCursorPos);
+	if (!edits.empty() && edits.back().type == msg::MessageType::write && !edits.back().text.empty()) {
+		// Letter which has not left yet is simply not sent
+		std::string& text = edits.back().text;
+		text.pop_back();
+		pendingBytes--;
+		expectedCursor = endOfWrite(edits.back().cursorPos, text);
+		if (text.empty()) {
+			edits.pop_back();
+		}
+		return;
+	}
+	if (!edits.empty() && edits.back().type == msg::MessageType::erase) {
+		edits.back().eraseSize++;
+	}
+	else {
+		edits.push_back(PendingEdit{ msg::MessageType::erase, pos, "", 1 });
+	}
+	// Moving back over a line start depends on the length of the previous line
+	cursorKnown = pos.X > 0;
+	expectedCursor = COORD{ static_cast<SHORT>(pos.X - 1), pos.Y };
+	pendingBytes++;
+	if (firstPending) {
+		firstEditTime = std::chrono::steady_clock::now();
+		wakeUp.notify_one();
+	}
+	if (pendingBytes >= maxBytes || !cursorKnown) {
+		flushLocked();
+	}
+}
+
+void EditBatcher::flush() {
+	std::scoped_lock guard{ lock };
+	flushLocked();
+	// Cursor is moved by the user now, positions are taken from the document again
+	cursorKnown = false;
+}
+
+COORD EditBatcher::nextPos(const COORD docCursorPos) {
+	if (!edits.empty()) {
+		return expectedCursor;
+	}
+	if (cursorKnown && samePos(docCursorPos, staleCursor)) {
+		// Echo of the edits sent before has not come back yet
+		return expectedCursor;
+	}
+	staleCursor = docCursorPos;
+	return docCursorPos;
+}
+
+void EditBatcher::flushLocked() {
+	if (edits.empty()) {
+		return;
+	}
+	const uint32_t sessionId = tcpClient.getSessionId();
+	if (edits.size() == 1) {
+		const auto& edit = edits.front();
+		// Round trip is measured from the keystroke, so the time spent waiting here counts too
+		const uint32_t sentAt = msg::opTimestamp(firstEditTime);
+		if (edit.type == msg::MessageType::write) {
+			tcpClient.sendMsg<msg::Write>(version, 0, sessionId, edit.cursorPos, edit.text, 0u, sentAt);
+		}
+		else {
+			tcpClient.sendMsg<msg::Erase>(version, 0, sessionId, edit.cursorPos, edit.eraseSize, 0u, sentAt);
+		}
+	}
+	else {
+		std::pmr::vector<msg::BatchOp> ops;
+		ops.reserve(edits.size());
+		for (const auto& edit : edits) {
+			ops.push_back(msg::BatchOp{ edit.type, edit.cursorPos, edit.text, edit.eraseSize });
+		}
+		tcpClient.sendMsg<msg::Batch>(version, 0, sessionId, std::move(ops));
+	}
+	edits.clear();
+	pendingBytes = 0;
+}
+
+void EditBatcher::flushWhenDue() {
+	std::unique_lock guard{ lock };
+	while (!stopping) {
+		if (edits.empty()) {
+			wakeUp.wait(guard);
+			continue;
+		}
+		auto due = firstEditTime + window;
+		if (std::chrono::steady_clock::now() >= due) {
+			flushLocked();
+			continue;
+		}
+		wakeUp.wait_until(guard, due);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+#include "tcp_client.h"
+
+/*
+	Coalesces keystrokes into as few msgs as possible. Letters typed one after another grow
+	the pending Write, backspaces grow the pending Erase (or take letters back from the pending
+	Write). Pending edits are sent after window has passed since the first of them, when they
+	reach maxBytes, or right away on flush (cursor jump, undo/redo, leaving the document).
+	One edit goes out as Write/Erase, more as one Batch.
+
+	Own edits show up in the document only when the server echoes them, so the document cursor
+	lags behind typing. Positions of pending and in-flight edits are therefore chained here.
+*/
+class EditBatcher {
+public:
+	EditBatcher(Client& tcpClient, const int version,
+		std::chrono::milliseconds window = std::chrono::milliseconds{ 10 }, const size_t maxBytes = 64);
+	~EditBatcher();
+	void write(const COORD docCursorPos, const std::string& text);
+	void erase(const COORD docCursorPos);
+	void flush();
+
+private:
+	struct PendingEdit {
+		msg::MessageType type;
+		COORD cursorPos;
+		std::string text;
+		int eraseSize;
+	};
+
+	COORD nextPos(const COORD docCursorPos);
+	void flushLocked();
+	void flushWhenDue();
+
+	Client& tcpClient;
+	const int version;
+	const std::chrono::milliseconds window;
+	const size_t maxBytes;
+
+	std::vector<PendingEdit> edits;
+	size_t pendingBytes = 0;
+	std::chrono::steady_clock::time_point firstEditTime;
+	// Where the cursor ends up after all sent and pending edits, valid while cursorKnown
+	COORD expectedCursor{ 0, 0 };
+	bool cursorKnown = false;
+	// Document cursor when the first unechoed edit was made, it stays there until the echo
+	COORD staleCursor{ 0, 0 };
+
+	std::mutex lock;
+	std::condition_variable wakeUp;
+	bool stopping = false;
+	std::thread flusher;
+};
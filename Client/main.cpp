@@ -4,12 +4,11 @@
 #include "document.h"
 #include "terminal.h"
 #include "command_executor.h"
+#include "edit_batcher.h"
    
-constexpr int clientVer = 1;
 constexpr int errCode = 0;
-constexpr int eraseSize = 1;
 
-TerminalManager::Mode writingMode(Document& doc, TerminalManager& terminal, Client& tcpClient) {
+TerminalManager::Mode writingMode(Document& doc, TerminalManager& terminal, Client& tcpClient, EditBatcher& batcher) {
     terminal.setMode(TerminalManager::Mode::document);
     terminal.render(doc);
     while (true) {
@@ -20,18 +19,28 @@ TerminalManager::Mode writingMode(Document& doc, TerminalManager& terminal, Clie
         int keyCode = terminal.readChar();
         COORD docCursorPos = doc.getCursorPos();
         if (keyCode >= 32 && keyCode <= 127) {
-            tcpClient.sendMsg<msg::Write>(clientVer, errCode, tcpClient.getUserId(), docCursorPos, std::string{static_cast<char>(keyCode)});
+            batcher.write(docCursorPos, std::string{static_cast<char>(keyCode)});
             continue;
         }
+        if (keyCode != ENTER && keyCode != TABULAR && keyCode != BACKSPACE) {
+            // Anything else than typing moves the cursor or depends on all edits being sent
+            batcher.flush();
+        }
         switch (keyCode) {
         case ENTER:
-            tcpClient.sendMsg<msg::Write>(clientVer, errCode, tcpClient.getUserId(), docCursorPos, "\n");
+            batcher.write(docCursorPos, "\n");
             break;
         case TABULAR:
-            tcpClient.sendMsg<msg::Write>(clientVer, errCode, tcpClient.getUserId(), docCursorPos, "    ");
+            batcher.write(docCursorPos, "    ");
             break;
         case BACKSPACE:
-            tcpClient.sendMsg<msg::Erase>(clientVer, errCode, tcpClient.getUserId(), docCursorPos, eraseSize);
+            batcher.erase(docCursorPos);
+            break;
+        case CTRL_Z:
+            tcpClient.sendMsg<msg::Undo>(clientVer, errCode, tcpClient.getUserId());
+            break;
+        case CTRL_Y:
+            tcpClient.sendMsg<msg::Redo>(clientVer, errCode, tcpClient.getUserId());
             break;
         case ARROW_LEFT:
             doc.moveCursorLeft();
@@ -113,6 +122,7 @@ int main()
     TerminalManager terminal;
     Client tcpClient{"192.168.1.10", 8081, "client.log", doc, terminal};
     CommandExecutor commandExec{ tcpClient };
+    EditBatcher batcher{ tcpClient, clientVer };
     if (tcpClient.connectToServer()) {
         std::cout << "Error when connecting to the server\n";
         return -1;
@@ -123,7 +133,7 @@ int main()
             mode = commandMode(commandExec, terminal, tcpClient);
         }
         else if (mode == TerminalManager::Mode::document) {
-            mode = writingMode(doc, terminal, tcpClient);
+            mode = writingMode(doc, terminal, tcpClient, batcher);
         }
     }
 
@@ -4,11 +4,12 @@
 #pragma push_macro("ERROR")
 #undef ERROR
 
-Processor::Processor(Document& doc, TerminalManager& terminal, logs::Logger& logger, std::string& userId) :
+Processor::Processor(Document& doc, TerminalManager& terminal, logs::Logger& logger, std::string& userId, uint32_t& sessionId) :
 	doc(doc),
 	terminal(terminal),
 	logger(logger),
-	userId{ userId } {}
+	userId{ userId },
+	sessionId{ sessionId } {}
 
 std::pair<std::string, int> Processor::waitForResponse() {
 	time_t currTime, timeoutTime;
@@ -24,6 +25,30 @@ std::pair<std::string, int> Processor::waitForResponse() {
 	return { response, errCode };
 }
 
+void Processor::beginResync() {
+	resyncing = true;
+}
+
+void Processor::abortResync() {
+	resyncing = false;
+}
+
+uint32_t Processor::getRevision() const {
+	return revision;
+}
+
+std::string Processor::getAccessCode() const {
+	return accessCode;
+}
+
+std::string Processor::latencyReport(std::string_view prefix) const {
+	metrics::HistogramSnapshot snapshot;
+	roundTrip.addTo(snapshot);
+	std::string report;
+	metrics::appendHistogram(report, prefix, "edit_round_trip_us", snapshot);
+	return report;
+}
+
 void Processor::process(msg::Buffer& buffer) {
 	auto header = msg::Header::parse(buffer);
 	std::pair<std::string, int> responseAndErrCode;
@@ -34,6 +59,9 @@ void Processor::process(msg::Buffer& buffer) {
 	case msg::MessageType::erase:
 		responseAndErrCode = processEraseMsg(buffer);
 		break;
+	case msg::MessageType::batch:
+		responseAndErrCode = processBatchMsg(buffer);
+		break;
 	case msg::MessageType::registration:
 		responseAndErrCode = processRegisterMsg(buffer);
 		break;
@@ -52,8 +80,20 @@ void Processor::process(msg::Buffer& buffer) {
 	case msg::MessageType::error:
 		responseAndErrCode = processErrorMsg(buffer);
 		break;
+	case msg::MessageType::resync:
+		responseAndErrCode = processResyncMsg(buffer);
+		break;
+	case msg::MessageType::stats:
+		responseAndErrCode = processStatsMsg(buffer);
+		break;
+	case msg::MessageType::spans:
+		responseAndErrCode = processSpansMsg(buffer);
+		break;
+	case msg::MessageType::chunk:
+		// Part of the body of a Load/Join response which comes right after the last chunk
+		return processChunkMsg(buffer);
 	default:
-		logger.log(logs::Level::ERROR, "Unknown header type in incoming message");
+		LOG_ERROR(logger, "Unknown header type in incoming message");
 	}
 	response = responseAndErrCode.first;
 	errCode = responseAndErrCode.second;
@@ -61,48 +101,183 @@ void Processor::process(msg::Buffer& buffer) {
 }
 
 std::pair<std::string, int> Processor::processWriteMsg(msg::Buffer& buffer) {
-	auto msg = msg::Write::parse(buffer);
+	auto [msg, valid] = msg::Write::parse(buffer);
+	if (!valid) {
+		LOG_ERROR(logger, "Malformed write msg");
+		return { "", 1 };
+	}
+	if (!acceptRevision(buffer, msg.revision)) {
+		return { "", msg.header.errCode };
+	}
+	applyWrite(msg.sessionId, msg.cursorPos, msg.text);
+	recordRoundTrip(msg.sessionId, msg.sentAt);
+	terminal.render(doc);
+	return { "", msg.header.errCode };
+}
+
+std::pair<std::string, int> Processor::processEraseMsg(msg::Buffer& buffer) {
+	auto [msg, valid] = msg::Erase::parse(buffer);
+	if (!valid) {
+		LOG_ERROR(logger, "Malformed erase msg");
+		return { "", 1 };
+	}
+	if (!acceptRevision(buffer, msg.revision)) {
+		return { "", msg.header.errCode };
+	}
+	applyErase(msg.sessionId, msg.cursorPos, msg.eraseSize);
+	recordRoundTrip(msg.sessionId, msg.sentAt);
+	terminal.render(doc);
+	return { "", msg.header.errCode };
+}
+
+void Processor::recordRoundTrip(const uint32_t author, const uint32_t sentAt) {
+	if (author != sessionId || sentAt == 0) {
+		return;
+	}
+	// Unsigned difference is right also when the 32 bit clock wrapped around in between
+	roundTrip.record(msg::opTimestamp(std::chrono::steady_clock::now()) - sentAt);
+}
+
+std::pair<std::string, int> Processor::processBatchMsg(msg::Buffer& buffer) {
+	auto [msg, valid] = msg::Batch::parse(buffer);
+	if (!valid) {
+		LOG_ERROR(logger, "Malformed batch msg");
+		return { "", 1 };
+	}
+	if (!acceptRevision(buffer, msg.revision)) {
+		return { "", msg.header.errCode };
+	}
+	for (const auto& op : msg.ops) {
+		if (op.type == msg::MessageType::write) {
+			applyWrite(msg.sessionId, op.cursorPos, op.text);
+		}
+		else {
+			applyErase(msg.sessionId, op.cursorPos, op.eraseSize);
+		}
+	}
+	terminal.render(doc);
+	return { "", msg.header.errCode };
+}
+
+std::pair<std::string, int> Processor::processResyncMsg(msg::Buffer& buffer) {
+	auto [msg, valid] = msg::ResyncReply::parse(buffer);
+	resyncing = false;
+	if (!valid) {
+		LOG_ERROR(logger, "Malformed resync msg");
+		deferred.clear();
+		return { "Resync failed", 1 };
+	}
+	if (msg.snapshot) {
+		std::string inlineText{ msg.payload };
+		doc.setText(takeBody(inlineText));
+	}
+	else {
+		msg::FrameReader frameReader;
+		frameReader.append(msg.payload.data(), static_cast<int>(msg.payload.size()));
+		auto frame = msg::BufferPool::local().acquire(msg::BufferPool::sizeClasses[1]);
+		while (frameReader.next(frame)) {
+			applyEditMsg(frame);
+		}
+	}
+	revision = msg.revision;
+	for (const auto& message : deferred) {
+		auto frame = msg::BufferPool::local().acquire(static_cast<int>(message.size()));
+		memcpy(frame.get(), message.data(), message.size());
+		frame.size = static_cast<int>(message.size());
+		applyEditMsg(frame);
+	}
+	deferred.clear();
+	terminal.render(doc);
+	return { msg.snapshot ? "Document reloaded" : "Missed edits applied", msg.header.errCode };
+}
+
+void Processor::applyEditMsg(msg::Buffer& buffer) {
+	switch (msg::Header::parse(buffer).type) {
+	case msg::MessageType::write:
+		processWriteMsg(buffer);
+		break;
+	case msg::MessageType::erase:
+		processEraseMsg(buffer);
+		break;
+	case msg::MessageType::batch:
+		processBatchMsg(buffer);
+		break;
+	default:
+		LOG_ERROR(logger, "Unexpected msg among missed edits");
+	}
+}
+
+/*
+	Edits stamped with a revision not newer than the last applied one came also in the
+	ResyncReply. Revision 0 means the author's client is older than msg::resyncVersion.
+*/
+bool Processor::acceptRevision(msg::Buffer& buffer, const uint32_t msgRevision) {
+	if (resyncing) {
+		deferred.emplace_back(buffer.get(), buffer.size);
+		return false;
+	}
+	if (msgRevision == 0) {
+		return true;
+	}
+	if (msgRevision <= revision) {
+		return false;
+	}
+	revision = msgRevision;
+	return true;
+}
+
+void Processor::applyWrite(const uint32_t author, const COORD pos, std::string_view text) {
 	COORD docCursorPos = doc.getCursorPos();
-	if (doc.setCursorPos(msg.cursorPos)) {
-		doc.write(msg.text);
-		if (msg.token != userId) {
+	if (doc.setCursorPos(pos)) {
+		doc.write(text);
+		if (author != sessionId) {
 			doc.setCursorPos(docCursorPos);
-			if (msg.cursorPos.Y == docCursorPos.Y && msg.cursorPos.X <= docCursorPos.X) {
+			if (pos.Y == docCursorPos.Y && pos.X <= docCursorPos.X) {
 				doc.moveCursorRight();
 			}
 		}
-		logger.log(logs::Level::INFO, "[", msg.cursorPos.X, ",", msg.cursorPos.Y, "] wrote '", msg.text, "'");
+		LOG_INFO(logger, "[", pos.X, ",", pos.Y, "] wrote '", text, "'");
 	}
 	else {
-		logger.log(logs::Level::ERROR, "[", msg.cursorPos.X, ",", msg.cursorPos.Y, "] Cannot place cursor on write msg!");
+		LOG_ERROR(logger, "[", pos.X, ",", pos.Y, "] Cannot place cursor on write msg!");
 	}
-	terminal.render(doc);
-	return { "", msg.header.errCode };
 }
 
-std::pair<std::string, int> Processor::processEraseMsg(msg::Buffer& buffer) {
-	auto msg = msg::Erase::parse(buffer);
+void Processor::applyErase(const uint32_t author, const COORD pos, const int eraseSize) {
 	COORD docCursorPos = doc.getCursorPos();
-	if (doc.setCursorPos(msg.cursorPos)) {
-		for (int i = 0; i < msg.eraseSize; i++) {
+	if (doc.setCursorPos(pos)) {
+		for (int i = 0; i < eraseSize; i++) {
 			doc.erase();
 		}
-		if (msg.token != userId) {
+		if (author != sessionId) {
 			doc.setCursorPos(docCursorPos);
-			if (msg.cursorPos.Y == docCursorPos.Y && msg.cursorPos.X <= docCursorPos.X) {
+			if (pos.Y == docCursorPos.Y && pos.X <= docCursorPos.X) {
 				doc.moveCursorLeft();
 			}
 		}
-		logger.log(logs::Level::INFO, "[", msg.cursorPos.X, ",", msg.cursorPos.Y, "] erased ", msg.eraseSize, " letters");
+		LOG_INFO(logger, "[", pos.X, ",", pos.Y, "] erased ", eraseSize, " letters");
 	}
 	else {
-		logger.log(logs::Level::ERROR, "[", msg.cursorPos.X, ",", msg.cursorPos.Y, "] Cannot place cursor on erase msg!");
+		LOG_ERROR(logger, "[", pos.X, ",", pos.Y, "] Cannot place cursor on erase msg!");
 	}
-	terminal.render(doc);
-	return { "", msg.header.errCode };
 }
 
 std::pair<std::string, int> Processor::processErrorMsg(msg::Buffer& buffer) {
+	auto msg = msg::ServerResponse<1>::parse(buffer);
+	if (resyncing) {
+		// Resync rejected, edits kept for it would be applied to a document which is out of date anyway
+		resyncing = false;
+		deferred.clear();
+	}
+	return { msg.messages[0], msg.header.errCode };
+}
+
+std::pair<std::string, int> Processor::processStatsMsg(msg::Buffer& buffer) {
+	auto msg = msg::ServerResponse<1>::parse(buffer);
+	return { msg.messages[0], msg.header.errCode };
+}
+
+std::pair<std::string, int> Processor::processSpansMsg(msg::Buffer& buffer) {
 	auto msg = msg::ServerResponse<1>::parse(buffer);
 	return { msg.messages[0], msg.header.errCode };
 }
@@ -113,26 +288,63 @@ std::pair<std::string, int> Processor::processRegisterMsg(msg::Buffer& buffer) {
 }
 
 std::pair<std::string, int> Processor::processLoginMsg(msg::Buffer& buffer) {
-	auto msg = msg::ServerResponse<1>::parse(buffer);
+	auto msg = msg::ServerResponse<2>::parse(buffer);
 	userId = msg.messages[0];
+	sessionId = static_cast<uint32_t>(std::stoul(msg.messages[1]));
 	return { "Login successful", msg.header.errCode};
 }
 
 std::pair<std::string, int> Processor::processCreateMsg(msg::Buffer& buffer) {
 	auto msg = msg::ServerResponse<1>::parse(buffer);
+	accessCode = msg.messages[0];
+	revision = 0;
 	return { msg.messages[0], msg.header.errCode };
 }
 
 std::pair<std::string, int> Processor::processLoadMsg(msg::Buffer& buffer) {
-	auto msg = msg::ServerResponse<2>::parse(buffer);
-	doc.setText(msg.messages[0]);
-	return { msg.messages[1], msg.header.errCode };
+	auto msg = msg::ServerResponse<3>::parse(buffer);
+	openDoc(msg);
+	return { accessCode, msg.header.errCode };
 }
 
 std::pair<std::string, int> Processor::processJoinMsg(msg::Buffer& buffer) {
-	auto msg = msg::ServerResponse<1>::parse(buffer);
-	doc.setText(msg.messages[0]);
-	return { msg.messages[0], msg.header.errCode };
+	auto msg = msg::ServerResponse<3>::parse(buffer);
+	openDoc(msg);
+	return { doc.getText(), msg.header.errCode };
+}
+
+void Processor::openDoc(msg::ServerResponse<3>& msg) {
+	doc.setText(takeBody(msg.messages[0]));
+	accessCode = msg.messages[1];
+	revision = static_cast<uint32_t>(std::stoul(msg.messages[2]));
+}
+
+void Processor::processChunkMsg(msg::Buffer& buffer) {
+	auto [msg, valid] = msg::Chunk::parse(buffer);
+	if (!valid || body.size() + msg.rawSize > msg.totalSize) {
+		LOG_ERROR(logger, "Malformed document chunk");
+		body.clear();
+		return;
+	}
+	if (body.empty()) {
+		body.reserve(msg.totalSize);
+	}
+	if (!msg.compressed()) {
+		body += msg.text;
+	}
+	else if (!lz4::decompress(msg.text, body, msg.rawSize)) {
+		LOG_ERROR(logger, "Cannot decompress document chunk");
+		body.clear();
+	}
+}
+
+std::string Processor::takeBody(std::string& inlineText) {
+	if (!inlineText.empty() || body.empty()) {
+		return std::move(inlineText);
+	}
+	std::string text = std::move(body);
+	body.clear();
+	return text;
 }
 
 #pragma pop_macro("ERROR")
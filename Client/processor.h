@@ -1,32 +1,66 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <atomic>
 
 #include "messages.h"
+#include "compression.h"
 #include "terminal.h"
 #include "document.h"
 #include "logger.h"
+#include "histogram.h"
 
 class Processor {
 public:
-	Processor(Document& doc, TerminalManager& terminal, logs::Logger& logger, std::string& userId);
+	Processor(Document& doc, TerminalManager& terminal, logs::Logger& logger, std::string& userId, uint32_t& sessionId);
 	void process(msg::Buffer& buffer);
 	std::pair<std::string, int> waitForResponse();
+	void beginResync();
+	void abortResync();
+	uint32_t getRevision() const;
+	std::string getAccessCode() const;
+	// Round trip of own edits from keystroke to the echo, lines of the metrics starting with prefix
+	std::string latencyReport(std::string_view prefix) const;
 
 private:
 	std::pair<std::string, int> processWriteMsg(msg::Buffer& buffer);
 	std::pair<std::string, int> processEraseMsg(msg::Buffer& buffer);
+	std::pair<std::string, int> processBatchMsg(msg::Buffer& buffer);
+	std::pair<std::string, int> processResyncMsg(msg::Buffer& buffer);
+	void applyEditMsg(msg::Buffer& buffer);
+	bool acceptRevision(msg::Buffer& buffer, const uint32_t msgRevision);
+	void recordRoundTrip(const uint32_t author, const uint32_t sentAt);
+	void applyWrite(const uint32_t author, const COORD pos, std::string_view text);
+	void applyErase(const uint32_t author, const COORD pos, const int eraseSize);
 	std::pair<std::string, int> processRegisterMsg(msg::Buffer& buffer);
 	std::pair<std::string, int> processLoginMsg(msg::Buffer& buffer);
 	std::pair<std::string, int> processCreateMsg(msg::Buffer& buffer);
 	std::pair<std::string, int> processLoadMsg(msg::Buffer& buffer);
 	std::pair<std::string, int> processJoinMsg(msg::Buffer& buffer);
+	// Load and Join responses have the same fields
+	void openDoc(msg::ServerResponse<3>& msg);
 	std::pair<std::string, int> processErrorMsg(msg::Buffer& buffer);
+	std::pair<std::string, int> processStatsMsg(msg::Buffer& buffer);
+	std::pair<std::string, int> processSpansMsg(msg::Buffer& buffer);
+	void processChunkMsg(msg::Buffer& buffer);
+	std::string takeBody(std::string& inlineText);
 
 	std::string response;
 	int errCode;
 	bool responseReady = false;
+	std::string body;
+
+	// Document being edited and the last revision of it applied here
+	std::string accessCode;
+	uint32_t revision = 0;
+	// Edits which came while waiting for ResyncReply, applied after it
+	std::atomic<bool> resyncing = false;
+	std::vector<std::string> deferred;
+	// In microseconds, written by the receiving thread only
+	metrics::Histogram roundTrip;
 
 	std::string& userId;
+	uint32_t& sessionId;
 	Document& doc;
 	TerminalManager& terminal;
 	logs::Logger& logger;
@@ -12,11 +12,11 @@ Client::Client(std::string srvIp, const int srvPort, std::string logFile,
     doc(doc),
     terminal(terminal),
     logger(logFile),
-    msgProcessor(doc, terminal, logger, userId) {
+    msgProcessor(doc, terminal, logger, userId, sessionId) {
 
     client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (client == INVALID_SOCKET) {
-        logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error on creating client socket");
+        LOG_ERROR(logger, WSAGetLastError(), ": Error on creating client socket");
         closesocket(client);
     }
 }
@@ -25,6 +25,10 @@ std::string Client::getUserId() {
     return userId;
 }
 
+uint32_t Client::getSessionId() {
+    return sessionId;
+}
+
 int Client::connectToServer() {
     srvAddress.sin_family = AF_INET;
     srvAddress.sin_port = htons(srvPort);
@@ -32,32 +36,82 @@ int Client::connectToServer() {
     InetPton(AF_INET, ipStr.c_str(), &srvAddress.sin_addr.s_addr);
     if (connect(client, reinterpret_cast<SOCKADDR*>(&srvAddress), sizeof(srvAddress))) {
         closesocket(client);
-        logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error on connecting to server");
+        LOG_ERROR(logger, WSAGetLastError(), ": Error on connecting to server");
         return -1;
     }
+    connected = true;
     recvThread = std::thread{ &Client::recvMsg, this };
     return 0;
 }
 
+/*
+    Reconnects if the connection has been lost and asks for the edits of the current document
+    made since the last revision applied here.
+*/
+int Client::resync() {
+    msgProcessor.beginResync();
+    if (!connected) {
+        if (recvThread.joinable()) {
+            recvThread.join();
+        }
+        client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (client == INVALID_SOCKET || connectToServer()) {
+            msgProcessor.abortResync();
+            return -1;
+        }
+    }
+    if (!sendMsg<msg::Resync>(clientVer, 0, userId, msgProcessor.getAccessCode(), msgProcessor.getRevision())) {
+        msgProcessor.abortResync();
+        return -1;
+    }
+    return 0;
+}
+
 void Client::disconnect() {
-    logger.log(logs::Level::INFO, "Disconnected from the server");
+    connected = false;
+    LOG_INFO(logger, "Disconnected from the server");
     shutdown(client, SD_SEND);
     closesocket(client);
 }
 
+bool Client::sendFrame(msg::Buffer& frame) {
+    std::scoped_lock lock{sendLock};
+    int sent = 0;
+    while (sent < frame.size) {
+        int sendBytes = send(client, frame.get() + sent, frame.size - sent, 0);
+        if (sendBytes < 0) {
+            LOG_ERROR(logger, WSAGetLastError(), ": Error when sending data to server");
+            disconnect();
+            return false;
+        }
+        sent += sendBytes;
+    }
+    return true;
+}
+
 void Client::recvMsg() {
+    msg::FrameReader frameReader;
+    auto recvBuff = msg::BufferPool::local().acquire(4096);
+    auto msgBuff = msg::BufferPool::local().acquire(4096);
     while (true) {
-        msg::Buffer recvBuff{128};
         recvBuff.size = recv(client, recvBuff.get(), recvBuff.capacity, 0);
         if (recvBuff.size > 0) {
-            msgProcessor.process(recvBuff);
+            frameReader.append(recvBuff.get(), recvBuff.size);
+            while (frameReader.next(msgBuff)) {
+                msgProcessor.process(msgBuff);
+            }
+            if (frameReader.corrupted()) {
+                LOG_ERROR(logger, "Malformed frame from server");
+                disconnect();
+                break;
+            }
         }
         else if (recvBuff.size == 0) {
             disconnect();
             break;
         }
         else if (recvBuff.size < 0) {
-            logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error when receiving data from server");
+            LOG_ERROR(logger, WSAGetLastError(), ": Error when receiving data from server");
             disconnect();
             break;
         }
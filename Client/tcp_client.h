@@ -1,6 +1,8 @@
 #include <string>
 #include <winsock2.h>
 #include <future>
+#include <atomic>
+#include <mutex>
 
 #include "terminal.h"
 #include "document.h"
@@ -12,41 +14,50 @@
 #pragma push_macro("ERROR")
 #undef ERROR
 
+// Protocol version of every msg sent by this client, the server answers in the same one
+constexpr int clientVer = msg::timedVersion;
+
 class Client {
 public:
 	Client(std::string srvIp, const int srvPort, std::string logFile,
 		Document& doc, TerminalManager& terminal);
 
 	int connectToServer();
+	int resync();
 	template<typename MESSAGE, typename... Args>
 	bool sendMsg(Args&&... args) {
-		msg::Buffer buffer{128};
+		auto buffer = msg::BufferPool::local().acquire(128);
 		MESSAGE msg{ args... };
 		msg.serializeTo(buffer);
-		int sendBytes = send(client, buffer.get(), buffer.size, 0);
-		if (sendBytes < 0) {
-			logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error when sending data to server");
-			disconnect();
-			return false;
-		}
-		return true;
+		auto frame = msg::BufferPool::local().acquire(msg::frameHeaderSize + buffer.size);
+		msg::serializeFrame(frame, buffer);
+		return sendFrame(frame);
 	}
 	std::pair<std::string, int> waitForResponse() {
 		return msgProcessor.waitForResponse();
 	}
 	std::string getUserId();
+	uint32_t getSessionId();
+	std::string latencyReport(std::string_view prefix) const {
+		return msgProcessor.latencyReport(prefix);
+	}
 
 
 private:
+	bool sendFrame(msg::Buffer& frame);
 	void disconnect();
 	void recvMsg();
 	
 	std::string userId;
+	uint32_t sessionId = 0;
 	std::string srvIp;
 	int srvPort;
 	sockaddr_in srvAddress = {0};
 
 	SOCKET client;
+	// The edit batcher flushes on its own thread, frames of the two must not interleave
+	std::mutex sendLock;
+	std::atomic<bool> connected = false;
 	std::thread recvThread;
 
 	Document& doc;
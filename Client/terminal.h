@@ -11,6 +11,8 @@
 #define CTRL_C 3
 #define CTRL_V 22
 #define CTRL_Q 17
+#define CTRL_Y 25
+#define CTRL_Z 26
 
 #define BACKSPACE 8
 #define TABULAR 9
@@ -0,0 +1,327 @@
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <iomanip>
+#include <cmath>
+
+#include <WS2tcpip.h>
+
+#include "load_generator.h"
+
+namespace {
+	// Echoes of the last keystrokes are still waited for this long after typing stops
+	constexpr std::chrono::seconds drainTime{ 2 };
+	// Users which did not get their document open by then give up
+	constexpr std::chrono::seconds setupTimeout{ 30 };
+	constexpr std::chrono::milliseconds maxPollWait{ 50 };
+
+	uint64_t microsecondsSince(const std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void printPercentiles(std::ostream& out, const metrics::HistogramSnapshot& histogram, const double scale) {
+		out << "p50 " << histogram.quantile(0.5) / scale << ", p90 " << histogram.quantile(0.9) / scale
+			<< ", p99 " << histogram.quantile(0.99) / scale << ", p999 " << histogram.quantile(0.999) / scale
+			<< ", max " << histogram.max / scale << " (" << histogram.count << " samples)\n";
+	}
+}
+
+struct LoadGenerator::Worker {
+	LoadReport& report;
+	std::mt19937 random;
+	metrics::Histogram roundTrip;
+	metrics::Histogram setup;
+};
+
+void LoadReport::merge(const LoadReport& other) {
+	typingUsers += other.typingUsers;
+	failedUsers += other.failedUsers;
+	keystrokes += other.keystrokes;
+	echoes += other.echoes;
+	receivedMsgs += other.receivedMsgs;
+	errors += other.errors;
+	typingStart = (std::min)(typingStart, other.typingStart);
+	typingEnd = (std::max)(typingEnd, other.typingEnd);
+	roundTrip.add(other.roundTrip);
+	setup.add(other.setup);
+}
+
+void LoadReport::print(std::ostream& out) const {
+	const double seconds = typingEnd > typingStart ? std::chrono::duration<double>(typingEnd - typingStart).count() : 0;
+	out << std::fixed << std::setprecision(1);
+	out << "Users typing: " << typingUsers << ", failed: " << failedUsers << "\n";
+	out << "Typing phase: " << seconds << " s\n";
+	if (seconds > 0) {
+		out << "Keystrokes sent: " << keystrokes << " (" << keystrokes / seconds << "/s)\n";
+		out << "Msgs received: " << receivedMsgs << " (" << receivedMsgs / seconds << "/s)\n";
+	}
+	out << "Own echoes: " << echoes << ", errors: " << errors << "\n";
+	out << "Setup in ms: ";
+	printPercentiles(out, setup, 1000);
+	out << "Round trip in ms: ";
+	printPercentiles(out, roundTrip, 1000);
+}
+
+LoadGenerator::LoadGenerator(LoadConfig config) :
+	config(std::move(config)),
+	accessCodes(this->config.documents) {}
+
+LoadReport LoadGenerator::run() {
+	const int threadCount = (std::max)(1, (std::min)(config.threads, config.users));
+	std::vector<LoadReport> reports(threadCount);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < threadCount; i++) {
+		const int first = config.users * i / threadCount;
+		const int last = config.users * (i + 1) / threadCount;
+		threads.emplace_back(&LoadGenerator::drive, this, first, last, std::ref(reports[i]));
+	}
+	LoadReport total;
+	for (int i = 0; i < threadCount; i++) {
+		threads[i].join();
+		total.merge(reports[i]);
+	}
+	return total;
+}
+
+void LoadGenerator::drive(const int first, const int last, LoadReport& report) {
+	Worker worker{ report, std::mt19937{ static_cast<unsigned>(first) } };
+	std::vector<double> weights;
+	for (int i = 0; i < config.documents; i++) {
+		weights.push_back(1 / std::pow(i + 1, config.documentSkew));
+	}
+	std::discrete_distribution<int> pickDocument{ weights.begin(), weights.end() };
+
+	std::vector<VirtualUser> users(last - first);
+	for (int i = 0; i < static_cast<int>(users.size()); i++) {
+		auto& user = users[i];
+		user.index = first + i;
+		user.document = user.index < config.documents ? user.index : pickDocument(worker.random);
+		if (!connectUser(user)) {
+			finish(worker, user, State::failed);
+			continue;
+		}
+		send<msg::Register>(user, msg::timedVersion, 0, username(user), config.runId);
+	}
+
+	std::vector<WSAPOLLFD> pollFds;
+	std::vector<VirtualUser*> polled;
+	auto buffer = msg::BufferPool::local().acquire(4096);
+	auto message = msg::BufferPool::local().acquire(4096);
+	while (true) {
+		pollFds.clear();
+		polled.clear();
+		auto wakeAt = std::chrono::steady_clock::now() + maxPollWait;
+		for (auto& user : users) {
+			if (user.state == State::done || user.state == State::failed) {
+				continue;
+			}
+			pollFds.push_back(WSAPOLLFD{ user.socket, static_cast<SHORT>(POLLRDNORM | (user.outgoing.empty() ? 0 : POLLWRNORM)), 0 });
+			polled.push_back(&user);
+			if (user.state == State::typing) {
+				wakeAt = (std::min)(wakeAt, (std::min)(user.nextKeystroke, user.stopAt));
+			}
+		}
+		if (pollFds.empty()) {
+			break;
+		}
+		const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - std::chrono::steady_clock::now());
+		if (WSAPoll(pollFds.data(), static_cast<ULONG>(pollFds.size()), static_cast<INT>((std::max)(static_cast<long long>(wait.count()), 0LL))) < 0) {
+			break;
+		}
+		for (size_t i = 0; i < pollFds.size(); i++) {
+			auto& user = *polled[i];
+			if (pollFds[i].revents & POLLWRNORM) {
+				flush(user);
+			}
+			if (!(pollFds[i].revents & (POLLRDNORM | POLLHUP | POLLERR))) {
+				continue;
+			}
+			buffer.size = recv(user.socket, buffer.get(), buffer.capacity, 0);
+			if (buffer.size <= 0) {
+				finish(worker, user, user.state == State::draining ? State::done : State::failed);
+				continue;
+			}
+			user.frameReader.append(buffer.get(), buffer.size);
+			while (user.state != State::failed && user.frameReader.next(message)) {
+				handleMsg(worker, user, message);
+			}
+			if (user.frameReader.corrupted()) {
+				finish(worker, user, State::failed);
+			}
+		}
+		const auto now = std::chrono::steady_clock::now();
+		for (auto& user : users) {
+			tick(worker, user, now);
+		}
+	}
+	worker.roundTrip.addTo(report.roundTrip);
+	worker.setup.addTo(report.setup);
+}
+
+bool LoadGenerator::connectUser(VirtualUser& user) {
+	user.socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (user.socket == INVALID_SOCKET) {
+		return false;
+	}
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(config.port);
+	std::wstring ipStr{ config.ip.begin(), config.ip.end() };
+	InetPton(AF_INET, ipStr.c_str(), &address.sin_addr.s_addr);
+	if (connect(user.socket, reinterpret_cast<SOCKADDR*>(&address), sizeof(address))) {
+		return false;
+	}
+	// Connecting blocks, everything after it must not hold up the other users of the thread
+	u_long nonBlocking = 1;
+	if (ioctlsocket(user.socket, FIONBIO, &nonBlocking)) {
+		return false;
+	}
+	user.connectedAt = std::chrono::steady_clock::now();
+	return true;
+}
+
+void LoadGenerator::handleMsg(Worker& worker, VirtualUser& user, msg::Buffer& buffer) {
+	auto header = msg::Header::parse(buffer);
+	worker.report.receivedMsgs++;
+	switch (header.type) {
+	case msg::MessageType::write: {
+		auto [write, valid] = msg::WriteView::parse(buffer);
+		if (valid && write.sessionId == user.sessionId && write.sentAt != 0) {
+			worker.roundTrip.record(msg::opTimestamp(std::chrono::steady_clock::now()) - write.sentAt);
+			worker.report.echoes++;
+		}
+		break;
+	}
+	case msg::MessageType::registration:
+		send<msg::Login>(user, msg::timedVersion, 0, username(user), config.runId);
+		user.state = State::loggingIn;
+		break;
+	case msg::MessageType::login: {
+		auto response = msg::ServerResponse<2>::parse(buffer);
+		user.userId = response.messages[0];
+		user.sessionId = static_cast<uint32_t>(std::stoul(response.messages[1]));
+		if (user.index < config.documents) {
+			send<msg::Create>(user, msg::timedVersion, 0, user.userId, config.runId + "-doc" + std::to_string(user.document));
+			user.state = State::opening;
+		}
+		else {
+			user.state = State::waitingForDoc;
+		}
+		break;
+	}
+	case msg::MessageType::create: {
+		auto response = msg::ServerResponse<1>::parse(buffer);
+		{
+			std::scoped_lock lock{ accessCodesLock };
+			accessCodes[user.document] = response.messages[0];
+		}
+		startTyping(worker, user);
+		break;
+	}
+	case msg::MessageType::join:
+		startTyping(worker, user);
+		break;
+	case msg::MessageType::error:
+		if (user.state == State::registering) {
+			// Most likely the user is left from an earlier run with the same id
+			send<msg::Login>(user, msg::timedVersion, 0, username(user), config.runId);
+			user.state = State::loggingIn;
+			break;
+		}
+		worker.report.errors++;
+		if (user.state == State::loggingIn || user.state == State::opening) {
+			finish(worker, user, State::failed);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void LoadGenerator::startTyping(Worker& worker, VirtualUser& user) {
+	const auto now = std::chrono::steady_clock::now();
+	worker.setup.record(microsecondsSince(user.connectedAt));
+	worker.report.typingUsers++;
+	worker.report.typingStart = (std::min)(worker.report.typingStart, now);
+	user.state = State::typing;
+	user.nextKeystroke = now;
+	user.stopAt = now + config.duration;
+}
+
+void LoadGenerator::tick(Worker& worker, VirtualUser& user, const std::chrono::steady_clock::time_point now) {
+	const bool settingUp = user.state != State::typing && user.state != State::draining && user.state != State::done && user.state != State::failed;
+	if (settingUp && now - user.connectedAt > setupTimeout) {
+		finish(worker, user, State::failed);
+		return;
+	}
+	switch (user.state) {
+	case State::waitingForDoc: {
+		std::string accessCode;
+		{
+			std::scoped_lock lock{ accessCodesLock };
+			accessCode = accessCodes[user.document];
+		}
+		if (!accessCode.empty()) {
+			send<msg::Join>(user, msg::timedVersion, 0, user.userId, accessCode);
+			user.state = State::opening;
+		}
+		break;
+	}
+	case State::typing: {
+		std::exponential_distribution<double> interval{ config.keystrokesPerSecond };
+		while (user.nextKeystroke <= now && user.nextKeystroke < user.stopAt) {
+			const std::string letter(1, static_cast<char>('a' + worker.report.keystrokes % 26));
+			// Stamped with the planned time, a generator falling behind must not hide the server's delay
+			send<msg::Write>(user, msg::timedVersion, 0, user.sessionId, COORD{ 0, 0 }, letter, 0u, msg::opTimestamp(user.nextKeystroke));
+			worker.report.keystrokes++;
+			user.nextKeystroke += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(interval(worker.random)));
+		}
+		if (now >= user.stopAt) {
+			worker.report.typingEnd = (std::max)(worker.report.typingEnd, now);
+			user.state = State::draining;
+			user.stopAt = now + drainTime;
+		}
+		break;
+	}
+	case State::draining:
+		if (now >= user.stopAt) {
+			finish(worker, user, State::done);
+		}
+		break;
+	case State::done:
+	case State::failed:
+		return;
+	default:
+		break;
+	}
+	if (!user.outgoing.empty() && !flush(user)) {
+		finish(worker, user, State::failed);
+	}
+}
+
+void LoadGenerator::finish(Worker& worker, VirtualUser& user, const State state) {
+	if (user.socket != INVALID_SOCKET) {
+		closesocket(user.socket);
+		user.socket = INVALID_SOCKET;
+	}
+	if (state == State::failed && user.state != State::failed) {
+		worker.report.failedUsers++;
+	}
+	user.state = state;
+}
+
+bool LoadGenerator::flush(VirtualUser& user) {
+	while (!user.outgoing.empty()) {
+		int sendBytes = ::send(user.socket, user.outgoing.data(), static_cast<int>(user.outgoing.size()), 0);
+		if (sendBytes < 0) {
+			return WSAGetLastError() == WSAEWOULDBLOCK;
+		}
+		user.outgoing.erase(0, sendBytes);
+	}
+	return true;
+}
+
+std::string LoadGenerator::username(const VirtualUser& user) const {
+	return config.runId + "-user" + std::to_string(user.index);
+}
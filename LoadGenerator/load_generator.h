@@ -0,0 +1,105 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+#include <winsock2.h>
+
+#include "messages.h"
+#include "histogram.h"
+
+#pragma comment(lib, "Ws2_32.lib")
+
+struct LoadConfig {
+	std::string ip = "127.0.0.1";
+	int port = 8081;
+	int users = 100;
+	// The first documents users create them, the others join one of them
+	int documents = 10;
+	int threads = 4;
+	// Per user, keystrokes come at random intervals with this mean rate
+	double keystrokesPerSecond = 5;
+	// Typing time of every user, counted from the moment its document is open
+	std::chrono::seconds duration{ 30 };
+	// 0 spreads joining users evenly over the documents, higher values crowd them into the first ones (Zipf exponent)
+	double documentSkew = 0;
+	// Usernames and filenames are prefixed with it, so runs against the same server do not collide
+	std::string runId;
+};
+
+struct LoadReport {
+	int typingUsers = 0;
+	int failedUsers = 0;
+	uint64_t keystrokes = 0;
+	uint64_t echoes = 0;
+	uint64_t receivedMsgs = 0;
+	uint64_t errors = 0;
+	std::chrono::steady_clock::time_point typingStart = std::chrono::steady_clock::time_point::max();
+	std::chrono::steady_clock::time_point typingEnd = std::chrono::steady_clock::time_point::min();
+	// Keystroke until its own echo came back, in microseconds
+	metrics::HistogramSnapshot roundTrip;
+	// Connect until the document was open, in microseconds
+	metrics::HistogramSnapshot setup;
+
+	void merge(const LoadReport& other);
+	void print(std::ostream& out) const;
+};
+
+/*
+	Headless virtual users which talk to the server like the console client: register, log in,
+	create or join a document and type into it at the start of its first line. Every keystroke
+	is a msg::timedVersion Write stamped with sentAt, so its round trip is known when the
+	server broadcasts it back. Each thread drives its share of users over non-blocking sockets
+	with WSAPoll, thousands of users need only a few threads.
+*/
+class LoadGenerator {
+public:
+	explicit LoadGenerator(LoadConfig config);
+	LoadReport run();
+
+private:
+	enum class State { registering, loggingIn, opening, waitingForDoc, typing, draining, done, failed };
+
+	struct VirtualUser {
+		int index = 0;
+		int document = 0;
+		SOCKET socket = INVALID_SOCKET;
+		State state = State::registering;
+		msg::FrameReader frameReader;
+		std::string outgoing;
+		std::string userId;
+		uint32_t sessionId = 0;
+		std::chrono::steady_clock::time_point connectedAt;
+		std::chrono::steady_clock::time_point nextKeystroke;
+		std::chrono::steady_clock::time_point stopAt;
+	};
+
+	struct Worker;
+
+	void drive(const int first, const int last, LoadReport& report);
+	bool connectUser(VirtualUser& user);
+	void handleMsg(Worker& worker, VirtualUser& user, msg::Buffer& buffer);
+	void startTyping(Worker& worker, VirtualUser& user);
+	void tick(Worker& worker, VirtualUser& user, const std::chrono::steady_clock::time_point now);
+	void finish(Worker& worker, VirtualUser& user, const State state);
+	bool flush(VirtualUser& user);
+	std::string username(const VirtualUser& user) const;
+
+	template<typename MESSAGE, typename... Args>
+	void send(VirtualUser& user, Args&&... args) {
+		auto buffer = msg::BufferPool::local().acquire(128);
+		MESSAGE message{ args... };
+		message.serializeTo(buffer);
+		auto frame = msg::BufferPool::local().acquire(msg::frameHeaderSize + buffer.size);
+		msg::serializeFrame(frame, buffer);
+		user.outgoing.append(frame.get(), frame.size);
+	}
+
+	const LoadConfig config;
+	// Access codes of the created documents, joining users wait for theirs
+	std::mutex accessCodesLock;
+	std::vector<std::string> accessCodes;
+};
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+
+#include "winsock2.h"
+#include "load_generator.h"
+
+#pragma comment(lib, "Ws2_32.lib")
+
+void printUsage() {
+    std::cout << "Usage: LoadGenerator [--ip 127.0.0.1] [--port 8081] [--users 100] [--documents 10] [--threads 4]\n"
+        "                     [--rate keystrokes per second per user] [--duration seconds] [--skew Zipf exponent]\n"
+        "                     [--run-id prefix of usernames and documents]\n"
+        "Every worker of the server selects on at most FD_SETSIZE sockets, start it with enough threads for the users.\n";
+}
+
+bool parseArgs(int argc, char* argv[], LoadConfig& config) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string name = argv[i];
+        const std::string value = argv[i + 1];
+        if (name == "--ip") {
+            config.ip = value;
+        }
+        else if (name == "--port") {
+            config.port = std::stoi(value);
+        }
+        else if (name == "--users") {
+            config.users = std::stoi(value);
+        }
+        else if (name == "--documents") {
+            config.documents = std::stoi(value);
+        }
+        else if (name == "--threads") {
+            config.threads = std::stoi(value);
+        }
+        else if (name == "--rate") {
+            config.keystrokesPerSecond = std::stod(value);
+        }
+        else if (name == "--duration") {
+            config.duration = std::chrono::seconds{ std::stoi(value) };
+        }
+        else if (name == "--skew") {
+            config.documentSkew = std::stod(value);
+        }
+        else if (name == "--run-id") {
+            config.runId = value;
+        }
+        else {
+            return false;
+        }
+    }
+    return argc % 2 == 1 && config.users > 0 && config.documents > 0 && config.documents <= config.users &&
+        config.threads > 0 && config.keystrokesPerSecond > 0;
+}
+
+int main(int argc, char* argv[]) {
+    LoadConfig config;
+    config.runId = "load" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count() % 1000000000);
+    try {
+        if (!parseArgs(argc, argv, config)) {
+            printUsage();
+            return -1;
+        }
+    }
+    catch (const std::exception&) {
+        printUsage();
+        return -1;
+    }
+
+    WSADATA wsaData;
+    int wsaError = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (wsaError) {
+        std::cout << wsaError << " Error on WSA startup\n";
+        WSACleanup();
+        return -1;
+    }
+    std::cout << "Run " << config.runId << ": " << config.users << " users on " << config.documents << " documents, "
+        << config.keystrokesPerSecond << " keystrokes/s each for " << config.duration.count() << " s\n";
+    LoadGenerator generator{ config };
+    generator.run().print(std::cout);
+    WSACleanup();
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include "logger.h"
+
+bool startsWith(const std::string& content, const char (&magic)[8]) {
+    return content.compare(0, sizeof(magic), magic, sizeof(magic)) == 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: LogDecoder <log or rotated segment> [output file]\n";
+        return -1;
+    }
+    std::ifstream in(argv[1], std::ifstream::binary);
+    if (!in) {
+        std::cout << "Cannot open " << argv[1] << "\n";
+        return -1;
+    }
+    std::string content{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+    if (startsWith(content, logs::segmentMagic)) {
+        std::istringstream segment{ content };
+        std::string inflated;
+        if (!logs::inflate(segment, inflated)) {
+            std::cout << argv[1] << " is a damaged compressed segment\n";
+            return -1;
+        }
+        content = std::move(inflated);
+    }
+    std::ofstream file;
+    if (argc > 2) {
+        file.open(argv[2], std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+        if (!file) {
+            std::cout << "Cannot open " << argv[2] << "\n";
+            return -1;
+        }
+    }
+    std::ostream& out = argc > 2 ? file : std::cout;
+    if (!startsWith(content, logs::binary::magic)) {
+        out << content;
+        return 0;
+    }
+    std::istringstream log{ content };
+    if (!logs::decode(log, out)) {
+        std::cout << argv[1] << " is a damaged binary log\n";
+        return -1;
+    }
+    return 0;
+}
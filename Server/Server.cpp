@@ -1,23 +1,41 @@
 #include "server.h"
 #include "messages.h"
 #include "load_balancer.h"
+#include "compression.h"
+#include "spans.h"
+#include "scratch.h"
 
 #include <WS2tcpip.h>
 #pragma push_macro("ERROR")
 #undef ERROR
 
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <array>
 
-Server::Server(std::string ip, const int port, const int threadPoolSize, std::string logFile) :
+Server::Server(std::string ip, const int port, const int threadPoolSize, std::string logFile,
+    const std::chrono::microseconds broadcastWindow, const int compressionAcceleration, const logs::Encoding logEncoding, const std::string& traceFile,
+    const size_t maxQueuedBytes) :
     ip(ip),
     port(port),
     threadPoolSize(threadPoolSize),
-	logger(logFile),
-    repo("users.csv", "docs.csv", logger),
-    loadBalancer(threadInfos) {
+    compressionAcceleration(compressionAcceleration),
+	logger(logFile, logs::Level::DEBUG, logEncoding),
+    repo("users.csv", "docs.csv", logger, defaultHistoryBudget, &metrics),
+    pendingSends(maxQueuedBytes),
+    loadBalancer(threadInfos),
+    outbox(broadcastWindow) {
+		if (!traceFile.empty()) {
+			recorder = std::make_unique<trace::Recorder>(traceFile);
+			if (!recorder->valid()) {
+				LOG_ERROR(logger, "Cannot open trace file ", traceFile, ", capture is off");
+				recorder.reset();
+			}
+		}
 		listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 		if (listenSocket == INVALID_SOCKET) {
-			logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error when creating listening socket");
+			LOG_ERROR(logger, WSAGetLastError(), ": Error when creating listening socket");
 			return;
 		}
         
@@ -26,48 +44,57 @@ Server::Server(std::string ip, const int port, const int threadPoolSize, std::st
 		std::wstring ipStr{ip.begin(), ip.end()};
 		InetPton(AF_INET, ipStr.c_str(), &listenSocketAddress.sin_addr.s_addr);
 		if (bind(listenSocket, reinterpret_cast<SOCKADDR*>(&listenSocketAddress), sizeof(listenSocketAddress)) == SOCKET_ERROR) {
-			logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error when binding listening socket");
+			LOG_ERROR(logger, WSAGetLastError(), ": Error when binding listening socket");
 		}
 	}
 
 void Server::open() {
     if (listen(listenSocket, SOMAXCONN)) {
-        logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error when starting listening");
+        LOG_ERROR(logger, WSAGetLastError(), ": Error when starting listening");
         return;
     }
     initThreadPool();
+    reporter = std::thread{ &Server::reportLatencies, this };
 
     while (true) {
         SOCKET newConnection = accept(listenSocket, nullptr, nullptr);
         if (newConnection == INVALID_SOCKET) {
-            logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error when accepting new connection");
+            LOG_ERROR(logger, WSAGetLastError(), ": Error when accepting new connection");
+            closesocket(newConnection);
+            continue;
+        }
+        // Workers must never wait on a slow client, sends that would block are queued instead
+        u_long nonBlocking = 1;
+        if (ioctlsocket(newConnection, FIONBIO, &nonBlocking)) {
+            LOG_ERROR(logger, WSAGetLastError(), ": Error when making connection ", newConnection, " non-blocking");
             closesocket(newConnection);
             continue;
         }
         ThreadMapIterator threadInfo;
         {
-            std::scoped_lock lock{threadInfosLock};
+            metrics::SiteLock lock{ "Server::open", threadInfosLock };
             threadInfo = loadBalancer.select();
             FD_SET(newConnection, &threadInfo->second.clients);
         }
         int sendBytes= send(threadInfo->second.notifier, "", 1, 0);
         if (sendBytes < 0) {
-            logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error when notifying thread ", threadInfo->first, " about new connection");
+            LOG_ERROR(logger, WSAGetLastError(), ": Error when notifying thread ", threadInfo->first, " about new connection");
             continue;
         }
-        logger.log(logs::Level::DEBUG, "Connection ", newConnection, " has been forwarded to thread ", threadInfo->first);
+        metrics.add(metrics::Counter::connectionsAccepted, 1);
+        LOG_DEBUG(logger, "Connection ", newConnection, " has been forwarded to thread ", threadInfo->first);
     }
     return;
 }
 
 void Server::initThreadPool() {
-    std::scoped_lock lock{threadInfosLock};
+    metrics::SiteLock lock{ "Server::initThreadPool", threadInfosLock };
     for (int i = 0; i < threadPoolSize; i++) {
         std::thread worker{&Server::handleConnection, this};
         auto notifySocket = accept(listenSocket, nullptr, nullptr);
         if (notifySocket == INVALID_SOCKET) {
             closesocket(notifySocket);
-            logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error on opening notify socket to thread ", worker.get_id());
+            LOG_ERROR(logger, WSAGetLastError(), ": Error on opening notify socket to thread ", worker.get_id());
             continue;
         }
         FD_SET workerClients;
@@ -76,11 +103,11 @@ void Server::initThreadPool() {
         it->second.notifier = notifySocket;
         threads.emplace_back(std::move(worker));
     }
-    logger.log(logs::Level::DEBUG, "Created ", threads.size(), " threads");
+    LOG_DEBUG(logger, "Created ", threads.size(), " threads");
 }
 
 void Server::removeThread() {
-    std::scoped_lock lock{threadInfosLock};
+    metrics::SiteLock lock{ "Server::removeThread", threadInfosLock };
     threadInfos.erase(std::this_thread::get_id());
 }
 
@@ -88,7 +115,7 @@ void Server::handleConnection() {
     // Create a communication pipe to master
     SOCKET notifyListenerSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (notifyListenerSocket == INVALID_SOCKET) {
-        logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error on creating notify listener socket in thread ", std::this_thread::get_id());
+        LOG_ERROR(logger, WSAGetLastError(), ": Error on creating notify listener socket in thread ", std::this_thread::get_id());
         closesocket(notifyListenerSocket);
         return removeThread();
     }
@@ -100,58 +127,106 @@ void Server::handleConnection() {
     std::wstring ipStr{ip.begin(), ip.end()};
     InetPton(AF_INET, ipStr.c_str(), &address.sin_addr.s_addr);
     if (connect(notifyListenerSocket, reinterpret_cast<SOCKADDR*>(&address), sizeof(address))) {
-        logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error when connecting thread ", std::this_thread::get_id(), " to master");
+        LOG_ERROR(logger, WSAGetLastError(), ": Error when connecting thread ", std::this_thread::get_id(), " to master");
         return removeThread();
     }
     {
-        std::scoped_lock lock{threadInfosLock};
+        metrics::SiteLock lock{ "Server::handleConnection setup", threadInfosLock };
         auto& threadInfo = threadInfos[std::this_thread::get_id()];
         FD_SET(notifyListenerSocket, &threadInfo.clients);
         threadInfo.notifyListener = notifyListenerSocket;
     }
+    std::unordered_map<SOCKET, msg::FrameReader> frameReaders;
     while (true) {
         // Copy FD_SET and then select
         FD_SET threadClients;
         {
-            std::scoped_lock lock{threadInfosLock};
+            SPAN_BEGIN(lockWait, "wait threadInfosLock");
+            metrics::SiteLock lock{ "Server::handleConnection", threadInfosLock };
+            SPAN_END(lockWait);
             auto& threadInfo = threadInfos[std::this_thread::get_id()];
             threadClients = threadInfo.clients;
         }
         if (threadClients.fd_count == 0) {
             continue;
         }
-        int socketCount = select(0, &threadClients, nullptr, nullptr, nullptr);
-        process(socketCount, threadClients);
+        FD_SET writableClients = withPendingSends(threadClients);
+        // Broadcasts held back for the window must leave even when no socket wakes the thread up
+        auto untilDue = outbox.untilDue();
+        timeval timeout{ static_cast<long>(untilDue.count() / 1000000), static_cast<long>(untilDue.count() % 1000000) };
+        bool waitForever = untilDue == std::chrono::microseconds::max();
+        int socketCount = select(0, &threadClients, &writableClients, nullptr, waitForever ? nullptr : &timeout);
+        if (socketCount < 0) {
+            LOG_ERROR(logger, WSAGetLastError(), ": Error when selecting client");
+            continue;
+        }
+        for (int i = 0; i < writableClients.fd_count; i++) {
+            std::scoped_lock lock{pendingSendsLock};
+            flushPendingSends(writableClients.fd_array[i]);
+        }
+        process(threadClients, notifyListenerSocket, frameReaders);
+        flushBroadcasts(false);
+        // Nothing handled in this pass needs its scratch memory anymore
+        scratch::Arena::local().reset();
     }
 }
 
-void Server::process(int socketCount, FD_SET& connections) {
-    if (socketCount < 0) {
-        logger.log(logs::Level::ERROR, WSAGetLastError(), ": Error when selecting client");
-        return;
-    }
-    for (int i = 0; i < socketCount; i++) {
+void Server::process(FD_SET& connections, SOCKET notifyListener, std::unordered_map<SOCKET, msg::FrameReader>& frameReaders) {
+    SPAN("Server::process");
+    for (int i = 0; i < connections.fd_count; i++) {
         SOCKET client = connections.fd_array[i];
-        msg::Buffer recvBuff{ 4096 };
+        auto recvBuff = msg::BufferPool::local().acquire(4096);
         recvBuff.size = recv(client, recvBuff.get(), recvBuff.capacity, 0);
+        if (recvBuff.size > 0 && client == notifyListener) {
+            // Master wakes the thread up on a new connection, another thread when a send got queued
+            continue;
+        }
         if (recvBuff.size > 0) {
-            makeResponse(recvBuff, client);
+            metrics.add(metrics::Counter::bytesIn, recvBuff.size);
+            auto& frameReader = frameReaders[client];
+            frameReader.append(recvBuff.get(), recvBuff.size);
+            while (frameReader.next(recvBuff)) {
+                makeResponse(recvBuff, client);
+            }
+            if (frameReader.corrupted()) {
+                LOG_ERROR(logger, "Malformed frame from ", client, "! Closing connection");
+                frameReaders.erase(client);
+                shutdownConnection(client);
+            }
         }
         else if (recvBuff.size == 0) {
-            logger.log(logs::Level::DEBUG, "Connection with ", client, " has been closed");
+            LOG_DEBUG(logger, "Connection with ", client, " has been closed");
+            frameReaders.erase(client);
             shutdownConnection(client);
         }
         else {
-            logger.log(logs::Level::ERROR, "Error on receiving data from", client, "! Closing connection");
+            LOG_ERROR(logger, "Error on receiving data from", client, "! Closing connection");
+            frameReaders.erase(client);
             shutdownConnection(client);
         }
     }
 }
 
 void Server::makeResponse(msg::Buffer& buffer, SOCKET& src) {
-    auto [outBuffer, responseType] = repo.process(buffer);
+    // A 1 byte msg only wakes the thread up, it has no header
+    const auto type = buffer.size > 1 ? msg::Header::parse(buffer).type : msg::MessageType::error;
+    if (buffer.size > 1) {
+        metrics.countMessage(type);
+    }
+    if (recorder && type != msg::MessageType::stats && type != msg::MessageType::spans) {
+        recorder->request(src, buffer);
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto [outBuffer, responseType] = type == msg::MessageType::stats ? respondStats(buffer) :
+        type == msg::MessageType::spans ? respondSpans(buffer) : repo.process(buffer, src);
+    metrics.recordSince(metrics::Distribution::processLatencyNs, start);
+    if (recorder && responseType == ResponseType::unicast) {
+        recorder->response(src, outBuffer);
+    }
     switch (responseType) {
     case ResponseType::unicast:
+        // A Load/Join snapshot already contains the held back edits, they must not come after it
+        flushBroadcasts(true);
         return unicast(outBuffer, src);
     case ResponseType::broadcast:
         return broadcast(outBuffer);
@@ -160,41 +235,285 @@ void Server::makeResponse(msg::Buffer& buffer, SOCKET& src) {
     }
 }
 
+Response Server::respondStats(msg::Buffer& buffer) {
+    auto [request, valid] = msg::Stats::parse(buffer);
+    buffer.clear();
+    if (!valid) {
+        return Repository::respondError(buffer, request.header.version, "Malformed stats msg");
+    }
+    // Gauges are read now, the counters were summed up by the workers as they went
+    auto snapshot = metrics.snapshot();
+    std::string text;
+    metrics::render(snapshot, request.prefix, text);
+    metrics::appendMetric(text, request.prefix, "active_documents", repo.activeDocCount());
+    metrics::appendMetric(text, request.prefix, "broadcast_pending_bytes", outbox.pendingBytes());
+    {
+        std::scoped_lock lock{pendingSendsLock};
+        metrics::appendMetric(text, request.prefix, "pending_sends", pendingSends.sendCount());
+    }
+    {
+        metrics::SiteLock lock{ "Server::respondStats", threadInfosLock };
+        int worker = 0;
+        for (const auto& [id, threadInfo] : threadInfos) {
+            // The notify listener sits in the same set, it is not a client
+            const size_t clients = threadInfo.clients.fd_count - (threadInfo.notifyListener != INVALID_SOCKET ? 1 : 0);
+            metrics::appendMetric(text, request.prefix, "worker_connections{worker=\"" + std::to_string(worker++) + "\"}", clients);
+        }
+    }
+    repo.renderLocks(request.prefix, text);
+    threadInfosLock.render(request.prefix, text);
+    auto response = msg::ServerResponse<1>(msg::MessageType::stats, request.header.version, 0, { std::move(text) });
+    response.serializeTo(buffer);
+    return { buffer, ResponseType::unicast };
+}
+
+Response Server::respondSpans(msg::Buffer& buffer) {
+    auto [request, valid] = msg::Spans::parse(buffer);
+    buffer.clear();
+    if (!valid) {
+        return Repository::respondError(buffer, request.header.version, "Malformed spans msg");
+    }
+    if (!spans::compiledIn) {
+        auto response = msg::ServerResponse<1>(msg::MessageType::spans, request.header.version, 0, { "Spans are compiled out, build with SPANS_ENABLED=1" });
+        response.serializeTo(buffer);
+        return { buffer, ResponseType::unicast };
+    }
+    // Every dump takes disk space on the server, anonymous connections get none
+    if (!repo.knownUser(request.token)) {
+        return Repository::respondError(buffer, request.header.version, "Log in to dump spans");
+    }
+    if (dumpingSpans.exchange(true)) {
+        return Repository::respondError(buffer, request.header.version, "Another spans dump is being written");
+    }
+    // Written on the server, a dump of busy workers is many MB
+    const std::string path = "spans-" + std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count()) + ".json";
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out) {
+        dumpingSpans = false;
+        return Repository::respondError(buffer, request.header.version, "Cannot open " + path);
+    }
+    const size_t count = spans::dump(out);
+    out.close();
+    dumpingSpans = false;
+    std::string text = std::to_string(count) + " spans written to " + path;
+    auto response = msg::ServerResponse<1>(msg::MessageType::spans, request.header.version, 0, { std::move(text) });
+    response.serializeTo(buffer);
+    return { buffer, ResponseType::unicast };
+}
+
 void Server::unicast(msg::Buffer& buffer, SOCKET& src) {
-    int sendBytes = send(src, buffer.get(), buffer.size, 0);
-    if (sendBytes < 0) {
-        logger.log(logs::Level::ERROR, "Error on responding to ", src);
+    auto frame = msg::BufferPool::local().acquire(msg::frameHeaderSize + buffer.size);
+    msg::serializeFrame(frame, buffer);
+    std::scoped_lock lock{pendingSendsLock};
+    if (buffer.body) {
+        // Chunks go first, so the response finds the whole body already received
+        if (!pendingSends.push(src, PendingSend{ "", 0, buffer.body, 0, msg::Header::parse(buffer).version })) {
+            return dropSlowClient(src);
+        }
     }
+    sendFrame(src, frame);
 }
 
 void Server::broadcast(msg::Buffer& buffer) {
-    std::scoped_lock lock{threadInfosLock};
+    SPAN("Server::broadcast");
+    outbox.add(buffer);
+}
+
+void Server::flushBroadcasts(const bool force) {
+    thread_local BroadcastOutbox::Frames frames;
+    thread_local std::unordered_map<uint64_t, uint32_t> docs;
+    if (outbox.empty()) {
+        return;
+    }
+    SPAN("Server::flushBroadcasts");
+    // Taken under the send locks, so ticks flushed by different threads cannot overtake each other
+    SPAN_BEGIN(lockWait, "wait threadInfosLock");
+    metrics::SiteLock lock{ "Server::flushBroadcasts", threadInfosLock, pendingSendsLock };
+    SPAN_END(lockWait);
+    if (!outbox.take(frames, force)) {
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    // Revisions are counted per document, edits of other documents would break the order of a client
+    docs.clear();
+    repo.docsOfConnections(docs);
+    size_t fanOut = 0;
     for (const auto& threadInfo : threadInfos) {
+        bool queued = false;
         for (int i = 0; i < threadInfo.second.clients.fd_count; i++) {
             SOCKET client = threadInfo.second.clients.fd_array[i];
-            if (client == threadInfo.second.notifyListener) {
+            auto doc = docs.find(client);
+            if (client == threadInfo.second.notifyListener || doc == docs.end()) {
                 continue;
             }
-            int sendBytes = send(client, buffer.get(), buffer.size, 0);
-            if (sendBytes < 0) {
-                logger.log(logs::Level::ERROR, "Error on broadcasting msg to ", client);
+            auto docFrames = frames.find(doc->second);
+            if (docFrames == frames.end() || docFrames->second.size == 0) {
+                continue;
             }
+            queued |= !sendFrame(client, docFrames->second);
+            fanOut++;
+        }
+        if (queued && threadInfo.first != std::this_thread::get_id()) {
+            // The owner has to select on the socket for writing to flush the rest
+            send(threadInfo.second.notifier, "", 1, 0);
         }
     }
+    metrics.recordSince(metrics::Distribution::fanOutNs, start);
+    metrics.record(metrics::Distribution::broadcastFanOut, fanOut);
+}
+
+void Server::reportLatencies() {
+    constexpr std::array reported{ metrics::Distribution::parseNs, metrics::Distribution::applyNs, metrics::Distribution::fanOutNs };
+    constexpr std::array names{ "parse", "apply", "fan-out" };
+    auto previous = std::make_unique<metrics::Snapshot>(metrics.snapshot());
+    std::unique_lock lock{reportLock};
+    while (!reportWake.wait_for(lock, latencyReportInterval, [this]() { return closing; })) {
+        auto current = std::make_unique<metrics::Snapshot>(metrics.snapshot());
+        for (size_t i = 0; i < reported.size(); i++) {
+            const auto index = static_cast<size_t>(reported[i]);
+            auto interval = current->distributions[index].since(previous->distributions[index]);
+            if (interval.count > 0) {
+                LOG_INFO(logger, "Latency of ", names[i], " over the last ", latencyReportInterval.count(), "s in ns: p50 ", interval.quantile(0.5),
+                    " p99 ", interval.quantile(0.99), " p999 ", interval.quantile(0.999), " max ", interval.max, " of ", interval.count);
+            }
+        }
+        previous = std::move(current);
+    }
+}
+
+bool Server::sendFrame(SOCKET client, msg::Buffer& frame) {
+    if (!pendingSends.contains(client)) {
+        int sendBytes = send(client, frame.get(), frame.size, 0);
+        if (sendBytes > 0) {
+            metrics.add(metrics::Counter::bytesOut, sendBytes);
+        }
+        if (sendBytes == frame.size) {
+            return true;
+        }
+        if (sendBytes < 0 && WSAGetLastError() != WSAEWOULDBLOCK) {
+            LOG_ERROR(logger, "Error on sending msg to ", client);
+            return true;
+        }
+        const size_t sent = (std::max)(sendBytes, 0);
+        if (!pendingSends.push(client, PendingSend{ std::string{ frame.get(), static_cast<size_t>(frame.size) }, sent })) {
+            dropSlowClient(client);
+            return true;
+        }
+        return false;
+    }
+    if (!pendingSends.push(client, PendingSend{ std::string{ frame.get(), static_cast<size_t>(frame.size) }, 0 })) {
+        dropSlowClient(client);
+        return true;
+    }
+    return flushPendingSends(client);
+}
+
+/*
+    The client may belong to another worker, which is selecting on it right now, so the socket is
+    only shut down here. Its owner then sees it readable, receives nothing and closes it.
+*/
+void Server::dropSlowClient(SOCKET client) {
+    LOG_ERROR(logger, "Connection ", client, " has more than its limit of bytes queued! Closing connection");
+    metrics.add(metrics::Counter::slowConnectionsDropped, 1);
+    pendingSends.erase(client);
+    shutdown(client, SD_BOTH);
+}
+
+bool Server::flushPendingSends(SOCKET client) {
+    if (!pendingSends.contains(client)) {
+        return true;
+    }
+    auto chunkBuffer = msg::BufferPool::local().acquire(msg::chunkSize + 64);
+    auto chunkFrame = msg::BufferPool::local().acquire(msg::chunkSize + 64);
+    auto compressed = msg::BufferPool::local().acquire(lz4::compressBound(msg::chunkSize));
+    while (auto* front = pendingSends.front(client)) {
+        auto& pending = *front;
+        if (pending.sent == pending.frame.size()) {
+            if (!pending.body || pending.bodyOffset == pending.body->size()) {
+                pendingSends.pop(client);
+                continue;
+            }
+            // Next part of the body is cut out only when the previous one has left
+            std::string_view text{ pending.body->data() + pending.bodyOffset, (std::min)(pending.body->size() - pending.bodyOffset, static_cast<size_t>(msg::chunkSize)) };
+            chunkBuffer.clear();
+            int compressedSize = 0;
+            if (compressionAcceleration > 0 && pending.version >= msg::compressedVersion) {
+                compressedSize = lz4::compress(pending.body->data(), pending.bodyOffset, text.size(),
+                    compressed.get(), compressed.capacity, compressionAcceleration);
+            }
+            if (compressedSize > 0 && compressedSize < static_cast<int>(text.size())) {
+                std::string_view compressedText{ compressed.get(), static_cast<size_t>(compressedSize) };
+                msg::Chunk{ pending.version, 0, pending.body->size(), compressedText, text.size() }.serializeTo(chunkBuffer);
+            }
+            else {
+                msg::Chunk{ pending.version, 0, pending.body->size(), text }.serializeTo(chunkBuffer);
+            }
+            msg::serializeFrame(chunkFrame, chunkBuffer);
+            pending.frame.assign(chunkFrame.get(), chunkFrame.size);
+            pending.sent = 0;
+            pending.bodyOffset += text.size();
+        }
+        int sendBytes = send(client, pending.frame.data() + pending.sent, static_cast<int>(pending.frame.size() - pending.sent), 0);
+        if (sendBytes < 0) {
+            if (WSAGetLastError() == WSAEWOULDBLOCK) {
+                return false;
+            }
+            LOG_ERROR(logger, "Error on sending queued msgs to ", client);
+            break;
+        }
+        pending.sent += sendBytes;
+        metrics.add(metrics::Counter::bytesOut, sendBytes);
+    }
+    pendingSends.erase(client);
+    return true;
+}
+
+FD_SET Server::withPendingSends(FD_SET& connections) {
+    FD_SET writable;
+    FD_ZERO(&writable);
+    std::scoped_lock lock{pendingSendsLock};
+    for (int i = 0; i < connections.fd_count; i++) {
+        if (pendingSends.contains(connections.fd_array[i])) {
+            FD_SET(connections.fd_array[i], &writable);
+        }
+    }
+    return writable;
 }
 
 void Server::shutdownConnection(SOCKET connection) {
+    metrics.add(metrics::Counter::connectionsClosed, 1);
+    if (recorder) {
+        recorder->closed(connection);
+    }
+    // Handles of closed sockets are reused, the next owner must not inherit the sessions
+    repo.closeConnection(connection);
     closesocket(connection);
     shutdown(connection, SD_SEND);
-    std::scoped_lock lock{threadInfosLock};
+    {
+        std::scoped_lock lock{pendingSendsLock};
+        pendingSends.erase(connection);
+    }
+    metrics::SiteLock lock{ "Server::shutdownConnection", threadInfosLock };
     auto& threadInfo = threadInfos[std::this_thread::get_id()];
     FD_CLR(connection, &threadInfo.clients);
 }
 
 void Server::close() {
-    logger.log(logs::Level::INFO, "Closing server...");
+    LOG_INFO(logger, "Closing server...");
+    {
+        std::scoped_lock lock{reportLock};
+        closing = true;
+    }
+    reportWake.notify_one();
+    if (reporter.joinable()) {
+        reporter.join();
+    }
     closesocket(listenSocket);
-    logger.log(logs::Level::INFO, "Server closed");
+    if (recorder) {
+        recorder->flush();
+    }
+    LOG_INFO(logger, "Server closed");
 }
 
 #pragma pop_macro("ERROR")
\ No newline at end of file
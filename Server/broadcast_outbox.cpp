@@ -0,0 +1,54 @@
+#include <algorithm>
+#include <cstring>
+
+#include "broadcast_outbox.h"
+
+BroadcastOutbox::BroadcastOutbox(const std::chrono::microseconds window) :
+	window(window) {}
+
+void BroadcastOutbox::add(msg::Buffer& message) {
+	std::scoped_lock guard{lock};
+	if (pendingSize == 0) {
+		firstAdded = std::chrono::steady_clock::now();
+	}
+	auto& frames = pending.try_emplace(message.docId, msg::BufferPool::sizeClasses[1]).first->second;
+	frames.reserve(frames.size + msg::frameHeaderSize + message.size);
+	u_long frameSize = htonl(static_cast<u_long>(message.size));
+	frames.add(&frameSize);
+	memcpy(frames.get() + frames.size, message.get(), message.size);
+	frames.size += message.size;
+	pendingSize += msg::frameHeaderSize + message.size;
+}
+
+bool BroadcastOutbox::take(Frames& frames, const bool force) {
+	std::scoped_lock guard{lock};
+	if (pendingSize == 0 || (!force && std::chrono::steady_clock::now() < firstAdded + window)) {
+		return false;
+	}
+	// Maps are swapped, so the buffers of both keep their memory for the next ticks
+	for (auto& [docId, taken] : frames) {
+		taken.clear();
+	}
+	std::swap(frames, pending);
+	pendingSize = 0;
+	return true;
+}
+
+std::chrono::microseconds BroadcastOutbox::untilDue() {
+	std::scoped_lock guard{lock};
+	if (pendingSize == 0) {
+		return std::chrono::microseconds::max();
+	}
+	auto left = std::chrono::duration_cast<std::chrono::microseconds>(firstAdded + window - std::chrono::steady_clock::now());
+	return (std::max)(left, std::chrono::microseconds{ 0 });
+}
+
+bool BroadcastOutbox::empty() {
+	std::scoped_lock guard{lock};
+	return pendingSize == 0;
+}
+
+size_t BroadcastOutbox::pendingBytes() {
+	std::scoped_lock guard{lock};
+	return pendingSize;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+
+#include "messages.h"
+
+/*
+	Broadcast msgs collected by all workers during one tick of their select loops (or during
+	window, if set). Msgs are grouped by the document they edit, each group leaves as one compound
+	frame - framed msgs back to back - to every connection on that document. So with many
+	collaborators typing, sends grow with ticks x connections instead of msgs x connections.
+*/
+class BroadcastOutbox {
+public:
+	// Compound frame of every document edited during the tick, keyed by msg::Buffer::docId
+	using Frames = std::unordered_map<uint32_t, msg::Buffer>;
+
+	BroadcastOutbox(const std::chrono::microseconds window);
+	void add(msg::Buffer& message);
+	bool take(Frames& frames, const bool force = false);
+	std::chrono::microseconds untilDue();
+	bool empty();
+	size_t pendingBytes();
+
+private:
+	const std::chrono::microseconds window;
+	Frames pending;
+	size_t pendingSize = 0;
+	std::chrono::steady_clock::time_point firstAdded;
+	std::mutex lock;
+};
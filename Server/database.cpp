@@ -13,44 +13,28 @@ namespace db {
 
 	static auto randomEngine = getRandomEngine();
 
-	std::string generateUUID() {
+	// Random hex digits in place of the x's of pattern, y becomes one of 8, 9, a, b
+	static std::string randomHex(std::string pattern) {
+		constexpr char digits[] = "0123456789abcdef";
 		std::uniform_int_distribution<> dist1(0, 15);
 		std::uniform_int_distribution<> dist2(8, 11);
-
-		std::stringstream ss;
-		ss << std::hex;
-		for (int i = 0; i < 8; i++) {
-			ss << dist1(randomEngine);
-		}
-		ss << "-";
-		for (int i = 0; i < 4; i++) {
-			ss << dist1(randomEngine);
-		}
-		ss << "-4";
-		for (int i = 0; i < 3; i++) {
-			ss << dist1(randomEngine);
-		}
-		ss << "-";
-		ss << dist2(randomEngine);
-		for (int i = 0; i < 3; i++) {
-			ss << dist1(randomEngine);
-		}
-		ss << "-";
-		for (int i = 0; i < 12; i++) {
-			ss << dist1(randomEngine);
+		for (auto& letter : pattern) {
+			if (letter == 'x') {
+				letter = digits[dist1(randomEngine)];
+			}
+			else if (letter == 'y') {
+				letter = digits[dist2(randomEngine)];
+			}
 		}
-		return ss.str();
+		return pattern;
 	}
 
-	std::string generateAccessCode() {
-		std::uniform_int_distribution<> dist1(0, 15);
+	std::string generateUUID() {
+		return randomHex("xxxxxxxx-xxxx-4xxx-yxxx-xxxxxxxxxxxx");
+	}
 
-		std::stringstream ss;
-		ss << std::hex;
-		for (int i = 0; i < 6; i++) {
-			ss << dist1(randomEngine);
-		}
-		return ss.str();
+	std::string generateAccessCode() {
+		return randomHex("xxxxxx");
 	}
 
 	bool validateStrField(const std::string& str, const std::string& notAllowedLetters) {
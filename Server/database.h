@@ -4,8 +4,12 @@
 #include <fstream>
 #include <array>
 #include <sstream>
+#include <string_view>
+#include <memory_resource>
 
 #include "logger.h"
+#include "spans.h"
+#include "scratch.h"
 
 #pragma push_macro("ERROR")
 #undef ERROR
@@ -110,14 +114,15 @@ namespace db {
 			logger(logger) {};
 
 		const std::string create(OBJ& obj) {
+			SPAN("Database::create");
 			if (!obj.valid()) {
-				logger.log(logs::Level::ERROR, obj.name + "is not valid: " + obj.str());
+				LOG_ERROR(logger, obj.name + "is not valid: " + obj.str());
 				return "";
 			}
 
 			std::ofstream db(dbPath, std::ostream::out | std::ostream::app);
 			if (!db) {
-				logger.log(logs::Level::ERROR, "Cannot open: " + dbPath);
+				LOG_ERROR(logger, "Cannot open: " + dbPath);
 				return "";
 			}
 
@@ -125,13 +130,14 @@ namespace db {
 			OBJ objToDb{ uuid, obj };
 			if (checkUniqueness(objToDb)) {
 				db << objToDb.str() << "\n" << std::flush;
-				logger.log(logs::Level::INFO, obj.name + "added: " + obj.str());
+				LOG_INFO(logger, obj.name + "added: " + obj.str());
 				return uuid;
 			}
 			return "";
 		}
 
 		OBJ read(const std::string& uuid) {
+			SPAN("Database::read");
 			auto rowDb = getRowWithUuid(uuid);
 			if (rowDb.empty()) {
 				return OBJ{};
@@ -140,6 +146,7 @@ namespace db {
 		}
 
 		OBJ readWithAttribute(const std::string& attr, const int pos) {
+			SPAN("Database::readWithAttribute");
 			auto rowDb = getRowWithAttr(attr, pos);
 			if (rowDb.empty()) {
 				return OBJ{};
@@ -148,24 +155,26 @@ namespace db {
 		}
 		
 		bool update(const OBJ& newObj) {
+			SPAN("Database::update");
 			if (!newObj.valid()) {
-				logger.log(logs::Level::ERROR, newObj.name + "is not valid: " + newObj.str());
+				LOG_ERROR(logger, newObj.name + "is not valid: " + newObj.str());
 				return false;
 			}				
 			if (editRowWithUuid(newObj.uuid, newObj.str() + "\n")) {
-				logger.log(logs::Level::INFO, newObj.name + " updated: " + newObj.str());
+				LOG_INFO(logger, newObj.name + " updated: " + newObj.str());
 				return true;
 			}
-			logger.log(logs::Level::INFO, newObj.name + " not found: " + newObj.str());
+			LOG_INFO(logger, newObj.name + " not found: " + newObj.str());
 			return false;
 		}
 
 		bool erase(const std::string& uuid) {
+			SPAN("Database::erase");
 			if (editRowWithUuid(uuid, "")) {
-				logger.log(logs::Level::INFO, uuid + " deleted from " + dbPath);
+				LOG_INFO(logger, uuid + " deleted from " + dbPath);
 				return true;
 			}
-			logger.log(logs::Level::INFO, "Obj not found: " + uuid + " in " + dbPath);
+			LOG_INFO(logger, "Obj not found: " + uuid + " in " + dbPath);
 			return false;
 		}
 
@@ -173,7 +182,7 @@ namespace db {
 		bool editRowWithUuid(const std::string& uuid, const std::string& newRow) const {
 			std::ifstream dbIn(dbPath, std::ios::in);
 			if (!dbIn) {
-				logger.log(logs::Level::ERROR, "Cannot open: " + dbPath);
+				LOG_ERROR(logger, "Cannot open: " + dbPath);
 				return false;
 			}
 
@@ -197,7 +206,7 @@ namespace db {
 
 			std::ofstream dbOut(dbPath, std::ios::out);
 			if (!dbOut) {
-				logger.log(logs::Level::ERROR, "Cannot open: " + dbPath);
+				LOG_ERROR(logger, "Cannot open: " + dbPath);
 				return false;
 			}
 			dbOut << fileContent;
@@ -207,57 +216,61 @@ namespace db {
 		std::vector<std::string> getRowWithUuid(const std::string& uuid) {
 			std::ifstream db(dbPath, std::istream::in);
 			if (!db) {
-				logger.log(logs::Level::ERROR, "Cannot open: " + dbPath + " for read");
+				LOG_ERROR(logger, "Cannot open: " + dbPath + " for read");
 				return {};
 			}
 
 			std::string rowStr;
 			while (std::getline(db, rowStr)) {
-				std::string rowUuid = rowStr.substr(0, rowStr.find(","));
-				if (rowUuid == uuid) {
-					return parseRow(rowStr, ',');
+				if (std::string_view{ rowStr }.substr(0, rowStr.find(',')) == uuid) {
+					std::pmr::vector<std::string_view> fields{ &scratch::Arena::local() };
+					parseRow(rowStr, ',', fields);
+					return std::vector<std::string>(fields.begin(), fields.end());
 				}
 			}
-			logger.log(logs::Level::DEBUG, "Not found obj with uuid: " + uuid + " from db", dbPath);
+			LOG_DEBUG(logger, "Not found obj with uuid: " + uuid + " from db", dbPath);
 			return {};
 		}
 
 		std::vector<std::string> getRowWithAttr(const std::string& attr, const int pos) {
 			std::ifstream db(dbPath, std::istream::in);
 			if (!db) {
-				logger.log(logs::Level::ERROR, "Cannot open: " + dbPath + " for read");
+				LOG_ERROR(logger, "Cannot open: " + dbPath + " for read");
 				return {};
 			}
 
+			// Fields of each scanned row point into rowStr, only the matching row is copied out
 			std::string rowStr;
+			std::pmr::vector<std::string_view> fields{ &scratch::Arena::local() };
 			while (std::getline(db, rowStr)) {
-				auto parsedRow = parseRow(rowStr, ',');
-				if (parsedRow[pos] == attr) {
-					return parsedRow;
+				parseRow(rowStr, ',', fields);
+				if (pos < fields.size() && fields[pos] == attr) {
+					return std::vector<std::string>(fields.begin(), fields.end());
 				}
 			}
-			logger.log(logs::Level::DEBUG, "Not found obj with attr: " + attr + " from db", dbPath);
+			LOG_DEBUG(logger, "Not found obj with attr: " + attr + " from db", dbPath);
 			return {};
 		}
 
 		bool checkUniqueness(const OBJ& obj) const {
 			std::ifstream db(dbPath, std::istream::in);
 			if (!db) {
-				logger.log(logs::Level::ERROR, "Cannot open: " + dbPath + " for read");
+				LOG_ERROR(logger, "Cannot open: " + dbPath + " for read");
 				return "";
 			}
 
 			auto rowObj = obj.row();
 			auto uniqueMask = obj.uniqueMask();
 			std::string rowStr;
+			std::pmr::vector<std::string_view> rowDb{ &scratch::Arena::local() };
 			while (std::getline(db, rowStr)) {
-				auto rowDb = parseRow(rowStr, ',');
-				for (int i = 0; i < rowObj.size(); i++) {
+				parseRow(rowStr, ',', rowDb);
+				for (int i = 0; i < rowObj.size() && i < rowDb.size(); i++) {
 					if (!uniqueMask[i]) {
 						continue;
 					}
 					if (rowDb[i] == rowObj[i]) {
-						logger.log(logs::Level::ERROR, "Such object already exists in db " + dbPath + ": " + obj.str());
+						LOG_ERROR(logger, "Such object already exists in db " + dbPath + ": " + obj.str());
 						return false;
 					}
 				}
@@ -265,16 +278,16 @@ namespace db {
 			return true;
 		}
 
-		std::vector<std::string> parseRow(std::string& row, char delimiter) const {
-			std::vector<std::string> parsedRow;
-			int offset = 0;
-			int delimiterPos = 0;
-			while ((delimiterPos = row.find(delimiter, offset)) != std::string::npos) {
-				parsedRow.emplace_back(row.substr(offset, delimiterPos - offset));
+		// Replaces fields with views into row, the vector is reused from row to row of a scan
+		void parseRow(std::string_view row, char delimiter, std::pmr::vector<std::string_view>& fields) const {
+			fields.clear();
+			size_t offset = 0;
+			size_t delimiterPos = 0;
+			while ((delimiterPos = row.find(delimiter, offset)) != std::string_view::npos) {
+				fields.push_back(row.substr(offset, delimiterPos - offset));
 				offset = delimiterPos + 1;
 			}
-			parsedRow.emplace_back(row.substr(offset, row.size() - offset));
-			return parsedRow;
+			fields.push_back(row.substr(offset));
 		}
 
 		std::string dbPath;
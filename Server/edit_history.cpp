@@ -0,0 +1,110 @@
+#include <cstring>
+
+#include "edit_history.h"
+
+EditHistory::EditHistory(const size_t budget) :
+	arena(budget) {}
+
+void EditHistory::record(const uint16_t user, const EditKind kind, const COORD pos, const COORD endPos, std::string_view text) {
+	discardRedo(user);
+	const size_t alignment = alignof(RecordHeader);
+	const uint32_t size = static_cast<uint32_t>((sizeof(RecordHeader) + text.size() + alignment - 1) / alignment * alignment);
+	if (!reserve(size)) {
+		// Edit bigger than the whole budget, older edits of this user cannot be undone in order anymore
+		for (const auto offset : records) {
+			if (header(offset)->user == user) {
+				header(offset)->state = State::discarded;
+			}
+		}
+		return;
+	}
+	RecordHeader recordHeader{ size, user, kind, State::done, pos, endPos, static_cast<uint32_t>(text.size()) };
+	memcpy(arena.data() + head, &recordHeader, sizeof(RecordHeader));
+	memcpy(arena.data() + head + sizeof(RecordHeader), text.data(), text.size());
+	records.push_back(head);
+	head += size;
+	used += size;
+}
+
+std::pair<Edit, bool> EditHistory::undo(const uint16_t user) {
+	for (auto it = records.rbegin(); it != records.rend(); it++) {
+		RecordHeader* recordHeader = header(*it);
+		if (recordHeader->user == user && recordHeader->state == State::done) {
+			recordHeader->state = State::undone;
+			return { decode(*it), true };
+		}
+	}
+	return { Edit{}, false };
+}
+
+std::pair<Edit, bool> EditHistory::redo(const uint16_t user) {
+	// Undone records of a user are always the newest ones, the oldest of them was undone last
+	RecordHeader* toRedo = nullptr;
+	uint32_t toRedoOffset = 0;
+	for (auto it = records.rbegin(); it != records.rend(); it++) {
+		RecordHeader* recordHeader = header(*it);
+		if (recordHeader->user != user || recordHeader->state == State::discarded) {
+			continue;
+		}
+		if (recordHeader->state == State::done) {
+			break;
+		}
+		toRedo = recordHeader;
+		toRedoOffset = *it;
+	}
+	if (toRedo == nullptr) {
+		return { Edit{}, false };
+	}
+	toRedo->state = State::done;
+	return { decode(toRedoOffset), true };
+}
+
+size_t EditHistory::usedBytes() const {
+	return used;
+}
+
+size_t EditHistory::recordCount() const {
+	return records.size();
+}
+
+EditHistory::RecordHeader* EditHistory::header(const uint32_t offset) {
+	return reinterpret_cast<RecordHeader*>(arena.data() + offset);
+}
+
+Edit EditHistory::decode(const uint32_t offset) {
+	const RecordHeader* recordHeader = header(offset);
+	const char* text = arena.data() + offset + sizeof(RecordHeader);
+	return Edit{ recordHeader->kind, recordHeader->pos, recordHeader->endPos, std::string{ text, recordHeader->textSize } };
+}
+
+void EditHistory::discardRedo(const uint16_t user) {
+	for (auto it = records.rbegin(); it != records.rend(); it++) {
+		RecordHeader* recordHeader = header(*it);
+		if (recordHeader->user != user || recordHeader->state == State::discarded) {
+			continue;
+		}
+		if (recordHeader->state == State::done) {
+			break;
+		}
+		recordHeader->state = State::discarded;
+	}
+}
+
+bool EditHistory::reserve(const uint32_t size) {
+	if (size > arena.size()) {
+		return false;
+	}
+	if (head + size > arena.size()) {
+		// Wrap around - everything placed after head is older than what lies at the arena start
+		while (!records.empty() && records.front() >= head) {
+			used -= header(records.front())->size;
+			records.pop_front();
+		}
+		head = 0;
+	}
+	while (!records.empty() && records.front() >= head && records.front() < head + size) {
+		used -= header(records.front())->size;
+		records.pop_front();
+	}
+	return true;
+}
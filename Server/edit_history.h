@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include <winsock2.h>
+
+enum class EditKind : uint8_t { write, erase };
+
+struct Edit {
+	EditKind kind;
+	COORD pos;
+	COORD endPos;
+	std::string text;
+};
+
+/*
+	Per document undo/redo history. Every edit is stored as one compact record in a fixed size
+	ring-buffer arena:
+		RecordHeader | text (written or erased letters)
+	When the arena is full, the oldest records are evicted, so history never takes more than
+	budget bytes per document. Each user has its own undo/redo stack threaded through the arena.
+	Positions are not transformed against edits of other users. Replaying an erase is rejected
+	when the letters before the stored position are not the recorded ones anymore, but replayed
+	letters are written at the stored position even if edits above it have shifted the text.
+*/
+class EditHistory {
+public:
+	EditHistory(const size_t budget);
+	void record(const uint16_t user, const EditKind kind, const COORD pos, const COORD endPos, std::string_view text);
+	std::pair<Edit, bool> undo(const uint16_t user);
+	std::pair<Edit, bool> redo(const uint16_t user);
+	size_t usedBytes() const;
+	size_t recordCount() const;
+
+private:
+	enum class State : uint8_t { done, undone, discarded };
+	struct RecordHeader {
+		uint32_t size;
+		uint16_t user;
+		EditKind kind;
+		State state;
+		COORD pos;
+		COORD endPos;
+		uint32_t textSize;
+	};
+
+	RecordHeader* header(const uint32_t offset);
+	Edit decode(const uint32_t offset);
+	void discardRedo(const uint16_t user);
+	bool reserve(const uint32_t size);
+
+	std::vector<char> arena;
+	std::deque<uint32_t> records;
+	uint32_t head = 0;
+	size_t used = 0;
+};
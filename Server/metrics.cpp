@@ -0,0 +1,67 @@
+#include <algorithm>
+
+#include "metrics.h"
+
+namespace metrics {
+
+	namespace {
+		constexpr std::array<std::string_view, messageTypeCount> messageNames{
+			"registration", "login", "create", "load", "join", "write", "erase", "error", "undo", "redo",
+			"chunk", "batch", "resync", "stats", "spans", "unknown"
+		};
+		constexpr std::array<std::string_view, counterCount> counterNames{
+			"bytes_in_total", "bytes_out_total", "connections_accepted_total", "connections_closed_total",
+			"slow_connections_dropped_total"
+		};
+		constexpr std::array<std::string_view, distributionCount> distributionNames{
+			"process_latency_ns", "broadcast_fanout", "parse_ns", "apply_ns", "fanout_ns"
+		};
+	}
+
+	void Registry::countMessage(const msg::MessageType type) {
+		const size_t index = static_cast<size_t>(type);
+		increment(shards.local().messages[index < messageTypeCount - 1 ? index : messageTypeCount - 1], 1);
+	}
+
+	void Registry::add(const Counter counter, const uint64_t value) {
+		increment(shards.local().counters[static_cast<size_t>(counter)], value);
+	}
+
+	void Registry::record(const Distribution distribution, const uint64_t value) {
+		shards.local().distributions[static_cast<size_t>(distribution)].record(value);
+	}
+
+	std::chrono::steady_clock::time_point Registry::recordSince(const Distribution distribution, const std::chrono::steady_clock::time_point start) {
+		const auto now = std::chrono::steady_clock::now();
+		record(distribution, std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+		return now;
+	}
+
+	Snapshot Registry::snapshot() const {
+		Snapshot snapshot;
+		shards.forEach([&](const Shard& shard) {
+			for (size_t i = 0; i < messageTypeCount; i++) {
+				snapshot.messages[i] += shard.messages[i].load(std::memory_order_relaxed);
+			}
+			for (size_t i = 0; i < counterCount; i++) {
+				snapshot.counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+			}
+			for (size_t i = 0; i < distributionCount; i++) {
+				shard.distributions[i].addTo(snapshot.distributions[i]);
+			}
+		});
+		return snapshot;
+	}
+
+	void render(const Snapshot& snapshot, std::string_view prefix, std::string& out) {
+		for (size_t i = 0; i < messageTypeCount; i++) {
+			appendMetric(out, prefix, "messages_total{type=\"" + std::string{ messageNames[i] } + "\"}", snapshot.messages[i]);
+		}
+		for (size_t i = 0; i < counterCount; i++) {
+			appendMetric(out, prefix, counterNames[i], snapshot.counters[i]);
+		}
+		for (size_t i = 0; i < distributionCount; i++) {
+			appendHistogram(out, prefix, distributionNames[i], snapshot.distributions[i]);
+		}
+	}
+}
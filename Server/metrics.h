@@ -0,0 +1,67 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+#include "messages.h"
+#include "histogram.h"
+#include "per_thread.h"
+
+namespace metrics {
+	// The last slot counts msgs of a type this server does not know
+	constexpr size_t messageTypeCount = static_cast<size_t>(msg::MessageType::spans) + 2;
+
+	enum class Counter { bytesIn, bytesOut, connectionsAccepted, connectionsClosed, slowConnectionsDropped, last };
+	/*
+		parse and apply are measured for Write, Erase and Batch, fan-out is the time one flush of
+		the outbox takes to reach every connection.
+	*/
+	enum class Distribution { processLatencyNs, broadcastFanOut, parseNs, applyNs, fanOutNs, last };
+	constexpr size_t counterCount = static_cast<size_t>(Counter::last);
+	constexpr size_t distributionCount = static_cast<size_t>(Distribution::last);
+
+	struct Snapshot {
+		std::array<uint64_t, messageTypeCount> messages{};
+		std::array<uint64_t, counterCount> counters{};
+		std::array<HistogramSnapshot, distributionCount> distributions{};
+	};
+
+	// Written only by its own thread, read by anyone taking a snapshot
+	struct Shard {
+		explicit Shard(const std::thread::id owner) :
+			owner(owner) {}
+
+		const std::thread::id owner;
+		std::array<std::atomic<uint64_t>, messageTypeCount> messages{};
+		std::array<std::atomic<uint64_t>, counterCount> counters{};
+		std::array<Histogram, distributionCount> distributions{};
+	};
+
+	/*
+		Server metrics sharded per thread. Every thread updates only its own shard with relaxed
+		atomic adds, so recording costs a few nanoseconds and workers never contend on a counter.
+		snapshot() sums all shards, it may miss updates made while it runs.
+	*/
+	class Registry {
+	public:
+		void countMessage(const msg::MessageType type);
+		void add(const Counter counter, const uint64_t value);
+		void record(const Distribution distribution, const uint64_t value);
+		// Records the time passed since start and returns now
+		std::chrono::steady_clock::time_point recordSince(const Distribution distribution, const std::chrono::steady_clock::time_point start);
+		Snapshot snapshot() const;
+
+	private:
+		threads::PerThread<Shard> shards;
+	};
+
+	// Metrics whose names start with prefix as "name value" lines, see appendMetric
+	void render(const Snapshot& snapshot, std::string_view prefix, std::string& out);
+}
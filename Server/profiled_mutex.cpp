@@ -0,0 +1,87 @@
+#include "profiled_mutex.h"
+
+namespace metrics {
+
+	namespace {
+		thread_local const char* currentSite = "unknown";
+
+		uint64_t nanosecondsBetween(const std::chrono::steady_clock::time_point start, const std::chrono::steady_clock::time_point end) {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		}
+	}
+
+	ProfiledMutex::ProfiledMutex(const char* name) :
+		name(name) {}
+
+	void ProfiledMutex::lock() {
+		const auto start = std::chrono::steady_clock::now();
+		mutex.lock();
+		acquiredAt = std::chrono::steady_clock::now();
+		holder = &siteOf(SiteMarker::current());
+		holder->waitNs.record(nanosecondsBetween(start, acquiredAt));
+	}
+
+	bool ProfiledMutex::try_lock() {
+		if (!mutex.try_lock()) {
+			return false;
+		}
+		acquiredAt = std::chrono::steady_clock::now();
+		holder = &siteOf(SiteMarker::current());
+		holder->waitNs.record(0);
+		return true;
+	}
+
+	void ProfiledMutex::unlock() {
+		holder->holdNs.record(nanosecondsBetween(acquiredAt, std::chrono::steady_clock::now()));
+		mutex.unlock();
+	}
+
+	void ProfiledMutex::render(std::string_view prefix, std::string& out) {
+		std::vector<std::pair<std::string, std::pair<HistogramSnapshot, HistogramSnapshot>>> snapshots;
+		{
+			// The plain mutex, a stats request does not show up in the numbers it reports
+			std::scoped_lock guard{mutex};
+			for (const auto& site : sites) {
+				snapshots.emplace_back(site->name, std::pair<HistogramSnapshot, HistogramSnapshot>{});
+				site->waitNs.addTo(snapshots.back().second.first);
+				site->holdNs.addTo(snapshots.back().second.second);
+			}
+		}
+		for (const auto& [site, histograms] : snapshots) {
+			const std::string labels = "lock=\"" + std::string{ name } + "\",site=\"" + site + "\"";
+			appendHistogram(out, prefix, "lock_wait_ns", histograms.first, labels);
+			appendHistogram(out, prefix, "lock_hold_ns", histograms.second, labels);
+		}
+	}
+
+	ProfiledMutex::Site& ProfiledMutex::siteOf(const char* site) {
+		// A handful of sites per mutex. Literals of one module share an address, text is compared
+		// only when that fails.
+		for (const auto& known : sites) {
+			if (known->name == site) {
+				return *known;
+			}
+		}
+		for (const auto& known : sites) {
+			if (std::string_view{ known->name } == site) {
+				return *known;
+			}
+		}
+		sites.push_back(std::make_unique<Site>());
+		sites.back()->name = site;
+		return *sites.back();
+	}
+
+	SiteMarker::SiteMarker(const char* site) :
+		previous(currentSite) {
+		currentSite = site;
+	}
+
+	SiteMarker::~SiteMarker() {
+		currentSite = previous;
+	}
+
+	const char* SiteMarker::current() {
+		return currentSite;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "histogram.h"
+
+namespace metrics {
+	/*
+		Mutex which measures how long its users wait for it and hold it, per call site. A site is
+		named by the SiteLock taking the mutex, plain std::scoped_lock users count as "unknown".
+		Statistics are updated while the mutex is held, so they need no lock of their own.
+	*/
+	class ProfiledMutex {
+	public:
+		// name must outlive the mutex, a string literal in practice
+		explicit ProfiledMutex(const char* name);
+		ProfiledMutex(const ProfiledMutex&) = delete;
+		ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+		void lock();
+		bool try_lock();
+		void unlock();
+
+		// lock_wait_ns and lock_hold_ns histograms of every site, labeled with the lock and the site
+		void render(std::string_view prefix, std::string& out);
+
+	private:
+		struct Site {
+			const char* name;
+			Histogram waitNs;
+			Histogram holdNs;
+		};
+
+		Site& siteOf(const char* name);
+
+		const char* const name;
+		std::mutex mutex;
+		// Valid while the mutex is held
+		std::chrono::steady_clock::time_point acquiredAt;
+		Site* holder = nullptr;
+		std::vector<std::unique_ptr<Site>> sites;
+	};
+
+	// Names the call site of the locks taken by the next SiteLock of this thread
+	class SiteMarker {
+	public:
+		explicit SiteMarker(const char* site);
+		~SiteMarker();
+		static const char* current();
+
+	private:
+		const char* const previous;
+	};
+
+	/*
+		std::scoped_lock which tells the profiled mutexes where they are taken:
+			metrics::SiteLock lock{ "Repository::writeToDoc", userActiveDocLock };
+	*/
+	template<typename... MUTEXES>
+	class SiteLock {
+	public:
+		explicit SiteLock(const char* site, MUTEXES&... mutexes) :
+			marker(site),
+			lock(mutexes...) {}
+
+	private:
+		SiteMarker marker;
+		std::scoped_lock<MUTEXES...> lock;
+	};
+}
@@ -1,17 +1,24 @@
 #include <filesystem>
+#include <algorithm>
 #include <sstream>
 
 #include "repository.h"
+#include "spans.h"
+#include "scratch.h"
 #pragma push_macro("ERROR")
 #undef ERROR
 
-Repository::Repository(const std::string& userDbPath, const std::string& docDbPath, logs::Logger& logger):
+Repository::Repository(const std::string& userDbPath, const std::string& docDbPath, logs::Logger& logger, const size_t historyBudget,
+	metrics::Registry* metrics):
 	logger(logger),
+	historyBudget(historyBudget),
+	metrics(metrics),
 	userDb(userDbPath, logger),
 	docDb(docDbPath, logger) {}
 
 
-Response Repository::process(msg::Buffer& buffer) {
+Response Repository::process(msg::Buffer& buffer, const uint64_t connection) {
+	SPAN("Repository::process");
 	if (buffer.size == 1) {
 		return newConnection(buffer);
 	}
@@ -19,64 +26,301 @@ Response Repository::process(msg::Buffer& buffer) {
 	auto header = msg::Header::parse(buffer);
 	switch (header.type) {
 	case msg::MessageType::write:
-		return writeToDoc(buffer);
+		return writeToDoc(buffer, connection);
 	case msg::MessageType::erase:
-		return eraseFromDoc(buffer);
+		return eraseFromDoc(buffer, connection);
 	case msg::MessageType::load:
-		return loadDoc(buffer);
+		return loadDoc(buffer, connection);
 	case msg::MessageType::create:
-		return createDoc(buffer);
+		return createDoc(buffer, connection);
 	case msg::MessageType::join:
-		return joinToDoc(buffer);
+		return joinToDoc(buffer, connection);
 	case msg::MessageType::login:
-		return loginUser(buffer);
+		return loginUser(buffer, connection);
 	case msg::MessageType::registration:
 		return registerUser(buffer);
+	case msg::MessageType::undo:
+		return undoEdit(buffer);
+	case msg::MessageType::redo:
+		return redoEdit(buffer);
+	case msg::MessageType::batch:
+		return batchEdit(buffer, connection);
+	case msg::MessageType::resync:
+		return resyncDoc(buffer, connection);
 	}
-	logger.log(logs::Level::ERROR, "Unknown header type in incoming message");
+	LOG_ERROR(logger, "Unknown header type in incoming message");
+}
+
+void Repository::closeConnection(const uint64_t connection) {
+	metrics::SiteLock lock{ "Repository::closeConnection", userActiveDocLock };
+	for (auto& [userId, activeDoc] : userActiveDoc) {
+		if (activeDoc.connection == connection) {
+			activeDoc.connection = noConnection;
+		}
+	}
+}
+
+void Repository::docsOfConnections(std::unordered_map<uint64_t, uint32_t>& docs) {
+	metrics::SiteLock lock{ "Repository::docsOfConnections", userActiveDocLock };
+	for (const auto& [userId, activeDoc] : userActiveDoc) {
+		if (activeDoc.data != nullptr && activeDoc.connection != noConnection) {
+			docs[activeDoc.connection] = activeDoc.data->id;
+		}
+	}
+}
+
+size_t Repository::activeDocCount() {
+	metrics::SiteLock lock{ "Repository::activeDocCount", docMapLock };
+	return accessCodeToDoc.size();
+}
+
+bool Repository::knownUser(const std::string& token) {
+	return !token.empty() && userDb.read(token).uuid == token;
+}
+
+void Repository::renderLocks(std::string_view prefix, std::string& out) {
+	docMapLock.render(prefix, out);
+	userActiveDocLock.render(prefix, out);
 }
 
 Response Repository::newConnection(msg::Buffer& buffer) {
-	logger.log(logs::Level::DEBUG, "Thread ", std::this_thread::get_id(), " got new connection");
+	LOG_DEBUG(logger, "Thread ", std::this_thread::get_id(), " got new connection");
 	return { buffer, ResponseType::none };
 }
 
-Response Repository::writeToDoc(msg::Buffer& buffer) {
-	auto msg = msg::Write::parse(buffer);
-	std::scoped_lock loc{userActiveDocLock};
-	auto it = userActiveDoc.find(msg.token);
-	if (it == userActiveDoc.end()) {
+Response Repository::writeToDoc(msg::Buffer& buffer, const uint64_t connection) {
+	SPAN("Repository::writeToDoc");
+	auto start = std::chrono::steady_clock::now();
+	auto [msg, valid] = msg::WriteView::parse(buffer);
+	if (!valid) {
+		return respondError(buffer, msg.header.version, "Malformed write msg");
+	}
+	start = measure(metrics::Distribution::parseNs, start);
+	SPAN_BEGIN(lockWait, "wait userActiveDocLock");
+	metrics::SiteLock loc{ "Repository::writeToDoc", userActiveDocLock };
+	SPAN_END(lockWait);
+	ActiveDoc* activeDoc = findSession(msg.sessionId, connection);
+	if (activeDoc == nullptr) {
 		return respondError(buffer, msg.header.version, "Write error");
 	}
-	if (it->second->setCursorPos(msg.cursorPos)) {
-		it->second->write(msg.text);
-		logger.log(logs::Level::INFO, "[", msg.cursorPos.X, ",", msg.cursorPos.Y, "] wrote '", msg.text, "'");
+	// An edit which was not applied gets no revision, resyncing clients would replay it
+	if (!applyWrite(*activeDoc, msg.cursorPos, msg.text)) {
+		return respondError(buffer, msg.header.version, "Write error");
 	}
-	else {
-		logger.log(logs::Level::ERROR, "[", msg.cursorPos.X, ",", msg.cursorPos.Y, "] Cannot place cursor on write msg!");
+	recordRevision(*activeDoc->data, buffer, msg.revision);
+	measure(metrics::Distribution::applyNs, start);
+	return { buffer, ResponseType::broadcast };
+}
+
+Response Repository::eraseFromDoc(msg::Buffer& buffer, const uint64_t connection) {
+	SPAN("Repository::eraseFromDoc");
+	auto start = std::chrono::steady_clock::now();
+	auto [msg, valid] = msg::EraseView::parse(buffer);
+	if (!valid) {
+		return respondError(buffer, msg.header.version, "Malformed erase msg");
+	}
+	start = measure(metrics::Distribution::parseNs, start);
+	SPAN_BEGIN(lockWait, "wait userActiveDocLock");
+	metrics::SiteLock loc{ "Repository::eraseFromDoc", userActiveDocLock };
+	SPAN_END(lockWait);
+	ActiveDoc* activeDoc = findSession(msg.sessionId, connection);
+	if (activeDoc == nullptr) {
+		return respondError(buffer, msg.header.version, "Erase error");
+	}
+	if (!applyErase(*activeDoc, msg.cursorPos, msg.eraseSize)) {
+		return respondError(buffer, msg.header.version, "Erase error");
+	}
+	recordRevision(*activeDoc->data, buffer, msg.revision);
+	measure(metrics::Distribution::applyNs, start);
+	return { buffer, ResponseType::broadcast };
+}
+
+Response Repository::batchEdit(msg::Buffer& buffer, const uint64_t connection) {
+	SPAN("Repository::batchEdit");
+	auto start = std::chrono::steady_clock::now();
+	auto [msg, valid] = msg::Batch::parse(buffer, &scratch::Arena::local());
+	if (!valid || msg.ops.empty()) {
+		return respondError(buffer, msg.header.version, "Malformed batch msg");
+	}
+	start = measure(metrics::Distribution::parseNs, start);
+	SPAN_BEGIN(lockWait, "wait userActiveDocLock");
+	metrics::SiteLock loc{ "Repository::batchEdit", userActiveDocLock };
+	SPAN_END(lockWait);
+	ActiveDoc* activeDoc = findSession(msg.sessionId, connection);
+	if (activeDoc == nullptr) {
+		return respondError(buffer, msg.header.version, "Batch error");
+	}
+	// Later edits of a batch are placed relative to the earlier ones, so the first failure ends it
+	size_t applied = 0;
+	for (const auto& op : msg.ops) {
+		bool success = op.type == msg::MessageType::write ?
+			applyWrite(*activeDoc, op.cursorPos, op.text) :
+			applyErase(*activeDoc, op.cursorPos, op.eraseSize);
+		if (!success) {
+			break;
+		}
+		applied++;
+	}
+	if (applied == 0) {
+		return respondError(buffer, msg.header.version, "Batch error");
 	}
+	if (applied < msg.ops.size()) {
+		// Ops point into buffer, so the shortened batch is built aside and copied back
+		msg.ops.resize(applied);
+		auto appliedBatch = msg::BufferPool::local().acquire(buffer.size);
+		msg::Batch{ msg.header.version, msg.header.errCode, msg.sessionId, std::move(msg.ops), msg.revision }.serializeTo(appliedBatch);
+		memcpy(buffer.get(), appliedBatch.get(), appliedBatch.size);
+		buffer.size = appliedBatch.size;
+	}
+	recordRevision(*activeDoc->data, buffer, msg.revision);
+	measure(metrics::Distribution::applyNs, start);
 	return { buffer, ResponseType::broadcast };
 }
 
-Response Repository::eraseFromDoc(msg::Buffer& buffer) {
-	auto msg = msg::Erase::parse(buffer);
-	std::scoped_lock loc{userActiveDocLock};
+bool Repository::applyWrite(ActiveDoc& activeDoc, const COORD pos, std::string_view text) {
+	auto& doc = *activeDoc.data->doc;
+	if (!doc.setCursorPos(pos)) {
+		LOG_ERROR(logger, "[", pos.X, ",", pos.Y, "] Cannot place cursor on write msg!");
+		return false;
+	}
+	doc.write(text);
+	activeDoc.data->history.record(activeDoc.userSlot, EditKind::write, pos, doc.getCursorPos(), text);
+	LOG_INFO(logger, "[", pos.X, ",", pos.Y, "] wrote '", text, "'");
+	return true;
+}
+
+bool Repository::applyErase(ActiveDoc& activeDoc, const COORD pos, const int eraseSize) {
+	auto& doc = *activeDoc.data->doc;
+	if (!doc.setCursorPos(pos)) {
+		LOG_ERROR(logger, "[", pos.X, ",", pos.Y, "] Cannot place cursor on erase msg!");
+		return false;
+	}
+	auto erasedText = doc.getTextBefore(eraseSize, &scratch::Arena::local());
+	doc.erase(eraseSize);
+	activeDoc.data->history.record(activeDoc.userSlot, EditKind::erase, pos, doc.getCursorPos(), erasedText);
+	LOG_INFO(logger, "[", pos.X, ",", pos.Y, "] erased '", eraseSize, "'");
+	return true;
+}
+
+Response Repository::undoEdit(msg::Buffer& buffer) {
+	SPAN("Repository::undoEdit");
+	auto [msg, valid] = msg::Undo::parse(buffer);
+	if (!valid) {
+		return respondError(buffer, msg.header.version, "Malformed undo msg");
+	}
+	SPAN_BEGIN(lockWait, "wait userActiveDocLock");
+	metrics::SiteLock lock{ "Repository::undoEdit", userActiveDocLock };
+	SPAN_END(lockWait);
 	auto it = userActiveDoc.find(msg.token);
-	if (it == userActiveDoc.end()) {
-		return respondError(buffer, msg.header.version, "Erase error");
+	if (it == userActiveDoc.end() || it->second.data == nullptr) {
+		return respondError(buffer, msg.header.version, "Undo error");
+	}
+	auto [edit, success] = it->second.data->history.undo(it->second.userSlot);
+	if (!success) {
+		return respondError(buffer, msg.header.version, "Nothing to undo");
 	}
-	if (it->second->setCursorPos(msg.cursorPos)) {
-		it->second->erase(msg.eraseSize);
-		logger.log(logs::Level::INFO, "[", msg.cursorPos.X, ",", msg.cursorPos.Y, "] erased '", msg.eraseSize, "'");
+	EditKind inverseKind = edit.kind == EditKind::write ? EditKind::erase : EditKind::write;
+	return replayEdit(buffer, msg.header.version, it->second.sessionId, *it->second.data, inverseKind, edit.endPos, edit.text);
+}
+
+Response Repository::redoEdit(msg::Buffer& buffer) {
+	SPAN("Repository::redoEdit");
+	auto [msg, valid] = msg::Redo::parse(buffer);
+	if (!valid) {
+		return respondError(buffer, msg.header.version, "Malformed redo msg");
+	}
+	SPAN_BEGIN(lockWait, "wait userActiveDocLock");
+	metrics::SiteLock lock{ "Repository::redoEdit", userActiveDocLock };
+	SPAN_END(lockWait);
+	auto it = userActiveDoc.find(msg.token);
+	if (it == userActiveDoc.end() || it->second.data == nullptr) {
+		return respondError(buffer, msg.header.version, "Redo error");
+	}
+	auto [edit, success] = it->second.data->history.redo(it->second.userSlot);
+	if (!success) {
+		return respondError(buffer, msg.header.version, "Nothing to redo");
+	}
+	return replayEdit(buffer, msg.header.version, it->second.sessionId, *it->second.data, edit.kind, edit.pos, edit.text);
+}
+
+Response Repository::replayEdit(msg::Buffer& buffer, const int version, const uint32_t sessionId, DocData& data, const EditKind kind, const COORD pos, const std::string& text) {
+	auto& doc = *data.doc;
+	if (!doc.setCursorPos(pos)) {
+		LOG_ERROR(logger, "[", pos.X, ",", pos.Y, "] Cannot place cursor on undo/redo msg!");
+		return respondError(buffer, version, "Edit cannot be replayed anymore");
+	}
+	// Other users may have edited there since, their letters must not be erased instead
+	if (kind == EditKind::erase && doc.getTextBefore(static_cast<int>(text.size()), &scratch::Arena::local()) != std::string_view{ text }) {
+		LOG_ERROR(logger, "[", pos.X, ",", pos.Y, "] Text to erase on undo/redo msg has changed!");
+		return respondError(buffer, version, "Edit cannot be replayed anymore");
+	}
+	buffer.clear();
+	if (kind == EditKind::write) {
+		doc.write(text);
+		msg::Write{ version, 0, sessionId, pos, text }.serializeTo(buffer);
+		LOG_INFO(logger, "[", pos.X, ",", pos.Y, "] replayed write '", text, "'");
 	}
 	else {
-		logger.log(logs::Level::ERROR, "[", msg.cursorPos.X, ",", msg.cursorPos.Y, "] Cannot place cursor on erase msg!");
+		doc.erase(text.size());
+		msg::Erase{ version, 0, sessionId, pos, static_cast<int>(text.size()) }.serializeTo(buffer);
+		LOG_INFO(logger, "[", pos.X, ",", pos.Y, "] replayed erase '", text.size(), "'");
 	}
+	recordRevision(data, buffer, 0);
 	return { buffer, ResponseType::broadcast };
 }
 
-Response Repository::loadDoc(msg::Buffer& buffer) {
-	auto msg = msg::Load::parse(buffer);
+void Repository::recordRevision(DocData& data, msg::Buffer& message, const uint32_t sentRevision) {
+	const uint32_t revision = data.revisions.latest() + 1;
+	msg::stampRevision(message, sentRevision, revision);
+	message.docId = data.id;
+	data.revisions.append(revision, std::string_view{ message.get(), static_cast<size_t>(message.size) });
+}
+
+Response Repository::resyncDoc(msg::Buffer& buffer, const uint64_t connection) {
+	SPAN("Repository::resyncDoc");
+	auto [msg, valid] = msg::Resync::parse(buffer);
+	if (!valid) {
+		return respondError(buffer, msg.header.version, "Malformed resync msg");
+	}
+	buffer.clear();
+	if (userDb.read(msg.token).uuid != msg.token || msg.token.empty()) {
+		return respondError(buffer, msg.header.version, "User not found error");
+	}
+	auto missed = msg::BufferPool::local().acquire(msg::BufferPool::sizeClasses[2]);
+	std::string docTxt;
+	uint32_t revision;
+	bool snapshot;
+	{
+		metrics::SiteLock lock{ "Repository::resyncDoc", docMapLock, userActiveDocLock };
+		auto it = accessCodeToDoc.find(msg.accessCode);
+		if (it == accessCodeToDoc.end()) {
+			return respondError(buffer, msg.header.version, "Invalid access code!");
+		}
+		setActiveDoc(msg.token, it->second);
+		activeDocOf(msg.token).connection = connection;
+		revision = it->second.revisions.latest();
+		snapshot = !it->second.revisions.collect(msg.revision, missed) || missed.size > msg::maxFrameSize / 2;
+		if (snapshot) {
+			docTxt = it->second.doc->getText();
+		}
+	}
+	if (snapshot) {
+		LOG_INFO(logger, "Revision ", msg.revision, " of ", msg.accessCode, " is not kept anymore, resending the document");
+		std::string inlineTxt = attachBody(buffer, std::move(docTxt));
+		msg::ResyncReply{ msg.header.version, 0, revision, true, inlineTxt }.serializeTo(buffer);
+	}
+	else {
+		msg::ResyncReply{ msg.header.version, 0, revision, false, std::string_view{ missed.get(), static_cast<size_t>(missed.size) } }.serializeTo(buffer);
+	}
+	return { buffer, ResponseType::unicast };
+}
+
+Response Repository::loadDoc(msg::Buffer& buffer, const uint64_t connection) {
+	SPAN("Repository::loadDoc");
+	auto [msg, valid] = msg::Load::parse(buffer);
+	if (!valid) {
+		return respondError(buffer, msg.header.version, "Malformed load msg");
+	}
 	buffer.clear();
 	db::Doc readDoc = docDb.readWithAttribute(msg.token, 1);
 	if (readDoc.uuid.empty()) {
@@ -90,14 +334,18 @@ Response Repository::loadDoc(msg::Buffer& buffer) {
 	if (accessCode.empty()) {
 		return respondError(buffer, msg.header.version, "Server internal error when producing access code. Try again");
 	}
-	switchActiveDoc(msg.token, accessCode);
-	auto response = msg::ServerResponse<2>(msg::MessageType::load, msg.header.version, 0, { docTxt, accessCode });
+	switchActiveDoc(msg.token, accessCode, connection);
+	auto response = msg::ServerResponse<3>(msg::MessageType::load, msg.header.version, 0, { attachBody(buffer, std::move(docTxt)), accessCode, "0" });
 	response.serializeTo(buffer);
 	return { buffer, ResponseType::unicast };
 }
 
-Response Repository::createDoc(msg::Buffer& buffer) {
-	auto msg = msg::Create::parse(buffer);
+Response Repository::createDoc(msg::Buffer& buffer, const uint64_t connection) {
+	SPAN("Repository::createDoc");
+	auto [msg, valid] = msg::Create::parse(buffer);
+	if (!valid) {
+		return respondError(buffer, msg.header.version, "Malformed create msg");
+	}
 	buffer.clear();
 	if (userDb.read(msg.token).uuid != msg.token || msg.token.empty()) {
 		return respondError(buffer, msg.header.version, "User not found error");
@@ -113,42 +361,63 @@ Response Repository::createDoc(msg::Buffer& buffer) {
 	if (accessCode.empty()) {
 		return respondError(buffer, msg.header.version, "Server internal error when producing access code. Try again");
 	}
-	switchActiveDoc(msg.token, accessCode);
+	switchActiveDoc(msg.token, accessCode, connection);
 	auto response = msg::ServerResponse<1>(msg::MessageType::create, msg.header.version, 0, { accessCode });
 	response.serializeTo(buffer);
 	return { buffer, ResponseType::unicast };
 }
 
-Response Repository::joinToDoc(msg::Buffer& buffer) {
-	auto msg = msg::Join::parse(buffer);
+Response Repository::joinToDoc(msg::Buffer& buffer, const uint64_t connection) {
+	SPAN("Repository::joinToDoc");
+	auto [msg, valid] = msg::Join::parse(buffer);
+	if (!valid) {
+		return respondError(buffer, msg.header.version, "Malformed join msg");
+	}
 	buffer.clear();
 	if (userDb.read(msg.token).uuid != msg.token || msg.token.empty()) {
 		return respondError(buffer, msg.header.version, "User not found error");
 	}
 
-	auto [docTxt, success] = joinToTrackedDoc(msg.token, msg.accessCode);
-	if (!success || !switchActiveDoc(msg.token, msg.accessCode)) {
+	uint32_t revision = 0;
+	auto [docTxt, success] = joinToTrackedDoc(msg.token, msg.accessCode, revision);
+	if (!success || !switchActiveDoc(msg.token, msg.accessCode, connection)) {
 		return respondError(buffer, msg.header.version, "Invalid access code!");
 	}
-	auto response = msg::ServerResponse<1>(msg::MessageType::join, msg.header.version, 0, { docTxt });
+	auto response = msg::ServerResponse<3>(msg::MessageType::join, msg.header.version, 0,
+		{ attachBody(buffer, std::move(docTxt)), msg.accessCode, std::to_string(revision) });
 	response.serializeTo(buffer);
 	return { buffer, ResponseType::unicast };
 }
 
-Response Repository::loginUser(msg::Buffer& buffer) {
-	auto msg = msg::Login::parse(buffer);
+Response Repository::loginUser(msg::Buffer& buffer, const uint64_t connection) {
+	SPAN("Repository::loginUser");
+	auto [msg, valid] = msg::Login::parse(buffer);
+	if (!valid) {
+		return respondError(buffer, msg.header.version, "Malformed login msg");
+	}
 	buffer.clear();
 	db::User readUser = userDb.readWithAttribute(msg.username, 1);
 	if (readUser.uuid.empty() || readUser.password != msg.password) {
 		return respondError(buffer, msg.header.version, "Authorization error");
 	}
-	auto response = msg::ServerResponse<1>(msg::MessageType::login, msg.header.version, 0, { readUser.uuid });
+	uint32_t sessionId;
+	{
+		metrics::SiteLock lock{ "Repository::loginUser", userActiveDocLock };
+		ActiveDoc& activeDoc = activeDocOf(readUser.uuid);
+		activeDoc.connection = connection;
+		sessionId = activeDoc.sessionId;
+	}
+	auto response = msg::ServerResponse<2>(msg::MessageType::login, msg.header.version, 0, { readUser.uuid, std::to_string(sessionId) });
 	response.serializeTo(buffer);
 	return { buffer, ResponseType::unicast };
 }
 
 Response Repository::registerUser(msg::Buffer& buffer) {
-	auto msg = msg::Register::parse(buffer);
+	SPAN("Repository::registerUser");
+	auto [msg, valid] = msg::Register::parse(buffer);
+	if (!valid) {
+		return respondError(buffer, msg.header.version, "Malformed register msg");
+	}
 	db::User user{msg.username, msg.password};
 	buffer.clear();
 	if (userDb.create(user).empty()) {
@@ -159,6 +428,21 @@ Response Repository::registerUser(msg::Buffer& buffer) {
 	return { buffer, ResponseType::unicast };
 }
 
+std::string Repository::attachBody(msg::Buffer& buffer, std::string&& docTxt) {
+	if (docTxt.size() <= msg::chunkSize) {
+		return std::move(docTxt);
+	}
+	buffer.body = std::make_shared<const std::string>(std::move(docTxt));
+	return "";
+}
+
+std::chrono::steady_clock::time_point Repository::measure(const metrics::Distribution distribution, const std::chrono::steady_clock::time_point start) {
+	if (metrics == nullptr) {
+		return start;
+	}
+	return metrics->recordSince(distribution, start);
+}
+
 Response Repository::respondError(msg::Buffer& buffer, const int version, std::string&& errMsg) {
 	buffer.clear();
 	auto response = msg::ServerResponse<1>(msg::MessageType::error, 1, 1, { std::move(errMsg) });
@@ -166,27 +450,27 @@ Response Repository::respondError(msg::Buffer& buffer, const int version, std::s
 	return { buffer, ResponseType::unicast };
 }
 
-std::pair<std::string, bool> Repository::joinToTrackedDoc(const std::string& userId, const std::string& accessCode) {
-	std::scoped_lock lock{docMapLock};
+std::pair<std::string, bool> Repository::joinToTrackedDoc(const std::string& userId, const std::string& accessCode, uint32_t& revision) {
+	// Edits are applied under userActiveDocLock, so the text matches the revision
+	metrics::SiteLock lock{ "Repository::joinToTrackedDoc", docMapLock, userActiveDocLock };
 	auto it = accessCodeToDoc.find(accessCode);
 	if (it == accessCodeToDoc.end()) {
 		return { "", false };
 	}
 	it->second.userIds.push_back(userId);
+	revision = it->second.revisions.latest();
 	return { it->second.doc->getText(), true };
 }
 
 std::string Repository::startTrackingDoc(const std::string& userId, const std::string& txt) {
 	std::string accessToken = db::generateAccessCode();
-	std::scoped_lock lock{docMapLock, userActiveDocLock};
-	auto [it, newOne] = accessCodeToDoc.try_emplace(accessToken, DocData{ txt, userId });
+	metrics::SiteLock lock{ "Repository::startTrackingDoc", docMapLock, userActiveDocLock };
+	auto [it, newOne] = accessCodeToDoc.try_emplace(accessToken, DocData{ txt, userId, historyBudget });
 	if (!newOne) {
 		return "";
 	}
-	auto [it2, newOne2] = userActiveDoc.try_emplace(userId, it->second.doc);
-	if (!newOne2) {
-		userActiveDoc[userId] = it->second.doc;
-	}
+	it->second.id = static_cast<uint32_t>(accessCodeToDoc.size());
+	setActiveDoc(userId, it->second);
 	return accessToken;
 }
 
@@ -212,17 +496,43 @@ std::pair<std::string, bool> Repository::readDocFile(const std::string& filename
 	return { ss.str(), true };
 }
 
-bool Repository::switchActiveDoc(const std::string& userId, const std::string& accessCode) {
-	std::scoped_lock lock{docMapLock, userActiveDocLock};
+bool Repository::switchActiveDoc(const std::string& userId, const std::string& accessCode, const uint64_t connection) {
+	metrics::SiteLock lock{ "Repository::switchActiveDoc", docMapLock, userActiveDocLock };
 	auto it = accessCodeToDoc.find(accessCode);
 	if (it == accessCodeToDoc.end()) {
 		return false;
 	}
-	auto [it2, newOne] = userActiveDoc.try_emplace(userId, it->second.doc);
-	if (!newOne) {
-		userActiveDoc[userId] = it->second.doc;
-	}
+	setActiveDoc(userId, it->second);
+	activeDocOf(userId).connection = connection;
 	return true;
 }
 
+ActiveDoc& Repository::activeDocOf(const std::string& userId) {
+	auto [it, created] = userActiveDoc.try_emplace(userId, ActiveDoc{ nullptr, 0, 0, 0 });
+	if (created) {
+		sessions.push_back(&it->second);
+		it->second.sessionId = static_cast<uint32_t>(sessions.size());
+	}
+	return it->second;
+}
+
+ActiveDoc* Repository::findSession(const uint32_t sessionId, const uint64_t connection) {
+	if (sessionId == 0 || sessionId > sessions.size() || sessions[sessionId - 1]->data == nullptr ||
+		sessions[sessionId - 1]->connection != connection) {
+		return nullptr;
+	}
+	return sessions[sessionId - 1];
+}
+
+void Repository::setActiveDoc(const std::string& userId, DocData& docData) {
+	auto& userIds = docData.userIds;
+	auto userIt = std::find(userIds.begin(), userIds.end(), userId);
+	if (userIt == userIds.end()) {
+		userIt = userIds.insert(userIds.end(), userId);
+	}
+	ActiveDoc& activeDoc = activeDocOf(userId);
+	activeDoc.data = &docData;
+	activeDoc.userSlot = static_cast<uint16_t>(userIt - userIds.begin());
+}
+
 #pragma pop_macro("ERROR")
\ No newline at end of file
@@ -5,48 +5,109 @@
 #include "database.h"
 #include "messages.h"
 #include "document.h"
+#include "edit_history.h"
+#include "revision_log.h"
+#include "metrics.h"
+#include "profiled_mutex.h"
+
+constexpr size_t defaultHistoryBudget = 64 * 1024;
 
 struct DocData {
-	DocData(std::string txt, const std::string& userId) :
+	DocData(std::string txt, const std::string& userId, const size_t historyBudget) :
 		doc(std::make_shared<Document>(std::move(txt))),
-		userIds{ userId } {}
+		userIds{ userId },
+		history(historyBudget),
+		revisions(historyBudget) {}
+	// Numbered from 1 in the order the documents were opened
+	uint32_t id = 0;
 	std::shared_ptr<Document> doc;
 	std::vector<std::string> userIds;
+	EditHistory history;
+	RevisionLog revisions;
+};
+
+/*
+	Document the user edits now (nullptr until the first load/create/join). sessionId is handed
+	out at login and used instead of the user id in Write/Erase/Batch msgs. Session ids are
+	small and easy to guess, so they are accepted only from the connection which last proved
+	to be the user - by login, or by its token in Create/Load/Join/Resync after a reconnect.
+*/
+struct ActiveDoc {
+	DocData* data;
+	uint16_t userSlot;
+	uint32_t sessionId;
+	uint64_t connection;
 };
 
+// connection of sessions whose socket was closed, no sender can match it
+constexpr uint64_t noConnection = UINT64_MAX;
+
 enum class ResponseType { none, unicast, broadcast };
 using Response = std::pair<msg::Buffer&, ResponseType>;
 
 class Repository {
 public:
-	Repository(const std::string& userDbPath, const std::string& docDbPath, logs::Logger& logger);
-	Response process(msg::Buffer& buffer);
+	Repository(const std::string& userDbPath, const std::string& docDbPath, logs::Logger& logger, const size_t historyBudget = defaultHistoryBudget,
+		metrics::Registry* metrics = nullptr);
+	// connection tells the senders apart, the server passes the socket the msg came from
+	Response process(msg::Buffer& buffer, const uint64_t connection = 0);
+	// Sessions of the closed connection are accepted again only after the user proves itself anew
+	void closeConnection(const uint64_t connection);
+	// Fills docs with the document id of every connection which has one open
+	void docsOfConnections(std::unordered_map<uint64_t, uint32_t>& docs);
+	// Documents opened by at least one user since the server started
+	size_t activeDocCount();
+	// token is the id of a registered user, as handed out at login
+	bool knownUser(const std::string& token);
+	// Wait and hold times of docMapLock and userActiveDocLock
+	void renderLocks(std::string_view prefix, std::string& out);
+	// Replaces the request in buffer with an error msg carrying errMsg, the server answers its own requests with it too
+	static Response respondError(msg::Buffer& buffer, const int version, std::string&& errMsg);
 private:
 	Response registerUser(msg::Buffer& buffer);
-	Response loginUser(msg::Buffer& buffer);
+	Response loginUser(msg::Buffer& buffer, const uint64_t connection);
 
-	Response createDoc(msg::Buffer& buffer);
+	Response createDoc(msg::Buffer& buffer, const uint64_t connection);
 	bool initDocFile(const std::string& filename);
 
-	Response loadDoc(msg::Buffer& buffer);
-	Response joinToDoc(msg::Buffer& buffer);
+	Response loadDoc(msg::Buffer& buffer, const uint64_t connection);
+	Response joinToDoc(msg::Buffer& buffer, const uint64_t connection);
 	std::pair<std::string, bool> readDocFile(const std::string& filename);
 
-	Response writeToDoc(msg::Buffer& buffer);
-	Response eraseFromDoc(msg::Buffer& buffer);
+	Response writeToDoc(msg::Buffer& buffer, const uint64_t connection);
+	Response eraseFromDoc(msg::Buffer& buffer, const uint64_t connection);
+	Response batchEdit(msg::Buffer& buffer, const uint64_t connection);
+	bool applyWrite(ActiveDoc& activeDoc, const COORD pos, std::string_view text);
+	bool applyErase(ActiveDoc& activeDoc, const COORD pos, const int eraseSize);
 	Response newConnection(msg::Buffer& buffer);
+	Response undoEdit(msg::Buffer& buffer);
+	Response redoEdit(msg::Buffer& buffer);
+	Response replayEdit(msg::Buffer& buffer, const int version, const uint32_t sessionId, DocData& data, const EditKind kind, const COORD pos, const std::string& text);
+	void recordRevision(DocData& data, msg::Buffer& message, const uint32_t sentRevision);
+	Response resyncDoc(msg::Buffer& buffer, const uint64_t connection);
 
-	Response respondError(msg::Buffer& buffer, const int version, std::string&& errMsg);
+	std::string attachBody(msg::Buffer& buffer, std::string&& docTxt);
+	// Records the time since start when metrics are on, returns the start of the next step
+	std::chrono::steady_clock::time_point measure(const metrics::Distribution distribution, const std::chrono::steady_clock::time_point start);
 	
-	std::pair<std::string, bool> joinToTrackedDoc(const std::string& userId, const std::string& accessCode);
+	std::pair<std::string, bool> joinToTrackedDoc(const std::string& userId, const std::string& accessCode, uint32_t& revision);
 	std::string startTrackingDoc(const std::string& userId, const std::string& txt);
-	bool switchActiveDoc(const std::string& userId, const std::string& accessCode);
+	bool switchActiveDoc(const std::string& userId, const std::string& accessCode, const uint64_t connection);
+	ActiveDoc& activeDocOf(const std::string& userId);
+	// nullptr when the session has no document or belongs to another connection
+	ActiveDoc* findSession(const uint32_t sessionId, const uint64_t connection);
+	void setActiveDoc(const std::string& userId, DocData& docData);
 
 
 	logs::Logger& logger;
+	const size_t historyBudget;
+	metrics::Registry* metrics;
 	db::Database<db::User> userDb;
 	db::Database<db::Doc> docDb;
-	std::unordered_map<std::string, std::shared_ptr<Document>> userActiveDoc;
+	std::unordered_map<std::string, ActiveDoc> userActiveDoc;
+	// sessions[sessionId - 1] points into userActiveDoc, whose nodes are never removed
+	std::vector<ActiveDoc*> sessions;
 	std::unordered_map<std::string, DocData> accessCodeToDoc;
-	std::mutex docMapLock, userActiveDocLock;
+	metrics::ProfiledMutex docMapLock{ "docMapLock" };
+	metrics::ProfiledMutex userActiveDocLock{ "userActiveDocLock" };
 };
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "revision_log.h"
+
+RevisionLog::RevisionLog(const size_t budget) :
+	budget(budget) {}
+
+void RevisionLog::append(const uint32_t revision, std::string_view message) {
+	newest = revision;
+	records.push_back(Record{ revision, std::string{ message } });
+	used += message.size();
+	while (used > budget) {
+		used -= records.front().message.size();
+		records.pop_front();
+	}
+}
+
+/*
+	Appends framed msgs of the revisions after since to frames. Fails when some of them have
+	been evicted already or since is not a revision of this document.
+*/
+bool RevisionLog::collect(const uint32_t since, msg::Buffer& frames) const {
+	if (since > newest) {
+		return false;
+	}
+	if (since == newest) {
+		return true;
+	}
+	if (records.empty() || records.front().revision > since + 1) {
+		return false;
+	}
+	// Revisions are appended one by one, so a record is found by its distance from the oldest one
+	for (auto it = records.begin() + (since + 1 - records.front().revision); it != records.end(); it++) {
+		u_long frameSize = htonl(static_cast<u_long>(it->message.size()));
+		frames.add(&frameSize);
+		frames.reserve(frames.size + static_cast<int>(it->message.size()));
+		memcpy(frames.get() + frames.size, it->message.data(), it->message.size());
+		frames.size += static_cast<int>(it->message.size());
+	}
+	return true;
+}
+
+uint32_t RevisionLog::latest() const {
+	return newest;
+}
+
+size_t RevisionLog::usedBytes() const {
+	return used;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <deque>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include "messages.h"
+
+/*
+	Edit msgs broadcast for one document, keyed by the revision they made. Only the newest
+	ones fitting into budget bytes are kept, so a client which reconnects after a short break
+	gets the edits it missed, and one which was away for longer gets the whole document.
+*/
+class RevisionLog {
+public:
+	RevisionLog(const size_t budget);
+	void append(const uint32_t revision, std::string_view message);
+	bool collect(const uint32_t since, msg::Buffer& frames) const;
+	uint32_t latest() const;
+	size_t usedBytes() const;
+
+private:
+	struct Record {
+		uint32_t revision;
+		std::string message;
+	};
+
+	const size_t budget;
+	std::deque<Record> records;
+	uint32_t newest = 0;
+	size_t used = 0;
+};
@@ -0,0 +1,55 @@
+#include <new>
+
+#include "scratch.h"
+
+namespace scratch {
+
+	Arena::Arena(const size_t capacity) :
+		block(std::make_unique<std::byte[]>(capacity)),
+		capacity(capacity) {}
+
+	Arena::~Arena() {
+		reset();
+	}
+
+	Arena& Arena::local() {
+		thread_local Arena arena;
+		return arena;
+	}
+
+	void Arena::reset() {
+		for (const auto& overflow : overflows) {
+			::operator delete(overflow.data, overflow.size, std::align_val_t{ overflow.alignment });
+		}
+		overflows.clear();
+		offset = 0;
+		overflowSize = 0;
+	}
+
+	size_t Arena::used() const {
+		return offset;
+	}
+
+	size_t Arena::overflowed() const {
+		return overflowSize;
+	}
+
+	void* Arena::do_allocate(const size_t bytes, const size_t alignment) {
+		const size_t start = (offset + alignment - 1) & ~(alignment - 1);
+		if (start <= capacity && bytes <= capacity - start) {
+			offset = start + bytes;
+			return block.get() + start;
+		}
+		// A request bigger than usual, the block stays as it is for the small ones after it
+		void* data = ::operator new(bytes, std::align_val_t{ alignment });
+		overflows.push_back({ data, bytes, alignment });
+		overflowSize += bytes;
+		return data;
+	}
+
+	void Arena::do_deallocate(void*, size_t, size_t) {}
+
+	bool Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+		return this == &other;
+	}
+}
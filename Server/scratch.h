@@ -0,0 +1,49 @@
+#pragma once
+#include <memory>
+#include <memory_resource>
+#include <vector>
+#include <cstddef>
+
+namespace scratch {
+	/*
+		Per thread bump allocator for memory needed only while one request is handled - parsed
+		batch ops, erased text, database rows being scanned. Allocations take the next bytes of
+		a fixed block and deallocation does nothing; the worker rewinds the whole arena with
+		reset() after each pass over its sockets. What does not fit the block comes from the heap
+		and is freed on the reset, so nothing allocated here may outlive the request.
+	*/
+	class Arena : public std::pmr::memory_resource {
+	public:
+		static constexpr size_t defaultCapacity = 256 * 1024;
+
+		explicit Arena(const size_t capacity = defaultCapacity);
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+		~Arena();
+
+		static Arena& local();
+		void reset();
+		// Bytes taken from the block since the last reset
+		size_t used() const;
+		// Bytes which did not fit the block since the last reset
+		size_t overflowed() const;
+
+	protected:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+	private:
+		struct Overflow {
+			void* data;
+			size_t size;
+			size_t alignment;
+		};
+
+		std::unique_ptr<std::byte[]> block;
+		const size_t capacity;
+		size_t offset = 0;
+		size_t overflowSize = 0;
+		std::vector<Overflow> overflows;
+	};
+}
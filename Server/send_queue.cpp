@@ -0,0 +1,54 @@
+#include "send_queue.h"
+
+SendQueue::SendQueue(const size_t maxBytes) :
+	maxBytes(maxBytes) {}
+
+bool SendQueue::push(const SOCKET socket, PendingSend send) {
+	const size_t bytes = send.frame.size() - send.sent + (send.body ? send.body->size() - send.bodyOffset : 0);
+	auto it = queues.find(socket);
+	if (it != queues.end() && it->second.bytes + bytes > maxBytes) {
+		return false;
+	}
+	auto& queue = it != queues.end() ? it->second : queues[socket];
+	queue.sends.push_back(Queued{ std::move(send), bytes });
+	queue.bytes += bytes;
+	return true;
+}
+
+PendingSend* SendQueue::front(const SOCKET socket) {
+	auto it = queues.find(socket);
+	return it == queues.end() ? nullptr : &it->second.sends.front().send;
+}
+
+void SendQueue::pop(const SOCKET socket) {
+	auto it = queues.find(socket);
+	if (it == queues.end()) {
+		return;
+	}
+	it->second.bytes -= it->second.sends.front().bytes;
+	it->second.sends.pop_front();
+	if (it->second.sends.empty()) {
+		queues.erase(it);
+	}
+}
+
+void SendQueue::erase(const SOCKET socket) {
+	queues.erase(socket);
+}
+
+bool SendQueue::contains(const SOCKET socket) const {
+	return queues.count(socket) > 0;
+}
+
+size_t SendQueue::bytesOf(const SOCKET socket) const {
+	auto it = queues.find(socket);
+	return it == queues.end() ? 0 : it->second.bytes;
+}
+
+size_t SendQueue::sendCount() const {
+	size_t count = 0;
+	for (const auto& [socket, queue] : queues) {
+		count += queue.sends.size();
+	}
+	return count;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <deque>
+#include <unordered_map>
+
+#include <winsock2.h>
+
+// Bytes one socket may have queued before the server gives up on it
+constexpr size_t defaultMaxQueuedBytes = 4 * 1024 * 1024;
+
+/*
+	Bytes of a socket which could not take them yet. A body is cut into Chunk frames lazily,
+	so a big document is not copied as a whole for every client loading it. For clients of
+	msg::compressedVersion the chunks are compressed as one stream - the part of the body sent
+	before is the dictionary of the next chunk.
+*/
+struct PendingSend {
+	std::string frame;
+	size_t sent = 0;
+	std::shared_ptr<const std::string> body;
+	size_t bodyOffset = 0;
+	int version = 0;
+};
+
+/*
+	Sends of every socket in the order they have to leave. A client which stops reading would
+	keep every broadcast queued, so a socket gets at most maxBytes - unsent frame bytes and the
+	rest of its bodies. A send bigger than that is still taken when nothing else waits, so
+	loading a big document does not need a bigger limit.
+*/
+class SendQueue {
+public:
+	SendQueue(const size_t maxBytes);
+	// False when the send does not fit under the limit, nothing is queued then
+	bool push(const SOCKET socket, PendingSend send);
+	// First send of socket, nullptr when it has none
+	PendingSend* front(const SOCKET socket);
+	void pop(const SOCKET socket);
+	void erase(const SOCKET socket);
+	bool contains(const SOCKET socket) const;
+	size_t bytesOf(const SOCKET socket) const;
+	size_t sendCount() const;
+
+private:
+	struct Queued {
+		PendingSend send;
+		size_t bytes;
+	};
+	struct Queue {
+		std::deque<Queued> sends;
+		size_t bytes = 0;
+	};
+
+	const size_t maxBytes;
+	std::unordered_map<SOCKET, Queue> queues;
+};
@@ -1,8 +1,10 @@
 #pragma once
 #include <string>
+#include <atomic>
 #include <thread>
 #include <mutex>
 #include <unordered_map>
+#include <condition_variable>
 
 #include <winsock2.h>
 
@@ -10,21 +12,41 @@
 #include "messages.h"
 #include "load_balancer.h"
 #include "repository.h"
+#include "broadcast_outbox.h"
+#include "metrics.h"
+#include "trace.h"
+#include "profiled_mutex.h"
+#include "send_queue.h"
 
 #pragma comment(lib, "Ws2_32.lib")
 
+// Percentiles of the last interval are logged this often, so their course shows in the log
+constexpr std::chrono::seconds latencyReportInterval{ 60 };
+
 class Server {
 public:
-	Server(std::string ip, const int port, const int threadPoolSize, std::string logFile);
+	Server(std::string ip, const int port, const int threadPoolSize, std::string logFile,
+		const std::chrono::microseconds broadcastWindow = std::chrono::microseconds{ 0 },
+		const int compressionAcceleration = 1, const logs::Encoding logEncoding = logs::Encoding::text, const std::string& traceFile = "",
+		const size_t maxQueuedBytes = defaultMaxQueuedBytes);
 	void open();
 	void close();
 
 private:
 	void sync(SOCKET dst);
-	void process(int socketCount, FD_SET& connections);
+	void process(FD_SET& connections, SOCKET notifyListener, std::unordered_map<SOCKET, msg::FrameReader>& frameReaders);
 	void broadcast(msg::Buffer& buffer);
+	void flushBroadcasts(const bool force);
 	void unicast(msg::Buffer& buffer, SOCKET& src);
 	void makeResponse(msg::Buffer& buffer, SOCKET& src);
+	Response respondStats(msg::Buffer& buffer);
+	// Dumps the spans of all threads into a Chrome trace file next to the server
+	Response respondSpans(msg::Buffer& buffer);
+	void reportLatencies();
+	bool sendFrame(SOCKET client, msg::Buffer& frame);
+	void dropSlowClient(SOCKET client);
+	bool flushPendingSends(SOCKET client);
+	FD_SET withPendingSends(FD_SET& connections);
 
 	void initThreadPool();
 	void removeThread();
@@ -39,13 +61,29 @@ private:
 	sockaddr_in listenSocketAddress = {0};
 
 	const int threadPoolSize;
+	// 0 sends bodies uncompressed, 1 gives the best ratio, higher values compress faster
+	const int compressionAcceleration;
 	std::vector<std::thread> threads;
 	std::unordered_map<std::thread::id, ThreadInfo> threadInfos;
-	std::mutex threadInfosLock;
+	// Taken on every select loop and held by flushBroadcasts across the sends
+	metrics::ProfiledMutex threadInfosLock{ "threadInfosLock" };
+	SendQueue pendingSends;
+	std::mutex pendingSendsLock;
 
 	logs::Logger logger;
+	metrics::Registry metrics;
 	Document doc;
 	Repository repo;
 	LoadBalancer loadBalancer;
+	BroadcastOutbox outbox;
+	// Capture mode, every request goes into the trace for replaying it later
+	std::unique_ptr<trace::Recorder> recorder;
+	// A spans dump is many MB, only one is written at a time
+	std::atomic<bool> dumpingSpans{ false };
+
+	std::mutex reportLock;
+	std::condition_variable reportWake;
+	bool closing = false;
+	std::thread reporter;
 
 };
@@ -0,0 +1,346 @@
+#include <thread>
+
+#include "trace.h"
+#include "scratch.h"
+
+namespace trace {
+
+	namespace {
+		// Buffers swap memory, so both keep theirs for the next msgs
+		void swapBuffers(msg::Buffer& first, msg::Buffer& second) {
+			std::swap(first.data, second.data);
+			std::swap(first.capacity, second.capacity);
+			std::swap(first.size, second.size);
+		}
+	}
+
+	bool handsOutIdentifiers(const msg::MessageType type) {
+		return type == msg::MessageType::login || type == msg::MessageType::create || type == msg::MessageType::load;
+	}
+
+	Recorder::Recorder(const std::string& path) :
+		out(path, std::ios::out | std::ios::binary | std::ios::trunc) {
+		out.write(magic.data(), magic.size());
+	}
+
+	bool Recorder::valid() const {
+		return out.good();
+	}
+
+	void Recorder::request(const SOCKET client, msg::Buffer& message) {
+		std::scoped_lock guard{lock};
+		const auto type = message.size > 1 ? msg::Header::parse(message).type : msg::MessageType::error;
+		if (type == msg::MessageType::registration) {
+			// What parses of a malformed one is recorded redacted as well, its password must not leak
+			auto registration = msg::Register::parse(message).first;
+			redacted.clear();
+			msg::Register{ registration.header.version, registration.header.errCode, std::move(registration.username), redactedPassword }.serializeTo(redacted);
+			return write(EventKind::request, connectionOf(client), &redacted);
+		}
+		if (type == msg::MessageType::login) {
+			auto login = msg::Login::parse(message).first;
+			redacted.clear();
+			msg::Login{ login.header.version, login.header.errCode, std::move(login.username), redactedPassword }.serializeTo(redacted);
+			return write(EventKind::request, connectionOf(client), &redacted);
+		}
+		write(EventKind::request, connectionOf(client), &message);
+	}
+
+	void Recorder::response(const SOCKET client, msg::Buffer& message) {
+		if (message.size <= 1 || !handsOutIdentifiers(msg::Header::parse(message).type)) {
+			return;
+		}
+		std::scoped_lock guard{lock};
+		write(EventKind::response, connectionOf(client), &message);
+	}
+
+	void Recorder::closed(const SOCKET client) {
+		std::scoped_lock guard{lock};
+		auto it = connections.find(client);
+		if (it == connections.end()) {
+			return;
+		}
+		write(EventKind::closed, it->second, nullptr);
+		freeConnections.push_back(it->second);
+		connections.erase(it);
+	}
+
+	void Recorder::flush() {
+		std::scoped_lock guard{lock};
+		out.flush();
+	}
+
+	uint32_t Recorder::connectionOf(const SOCKET client) {
+		auto it = connections.find(client);
+		if (it != connections.end()) {
+			return it->second;
+		}
+		uint32_t connection = nextConnection;
+		if (freeConnections.empty()) {
+			nextConnection++;
+		}
+		else {
+			connection = freeConnections.back();
+			freeConnections.pop_back();
+		}
+		connections.emplace(client, connection);
+		return connection;
+	}
+
+	void Recorder::write(const EventKind kind, const uint32_t connection, msg::Buffer* message) {
+		const auto now = std::chrono::steady_clock::now();
+		const auto sincePrevious = started ? std::chrono::duration_cast<std::chrono::microseconds>(now - last).count() : 0;
+		started = true;
+		last = now;
+		record.clear();
+		record.addVarint(static_cast<uint32_t>(kind));
+		record.addVarint(static_cast<uint32_t>(sincePrevious));
+		record.addVarint(connection);
+		if (message != nullptr) {
+			record.addPrefixed(std::string_view{ message->get(), static_cast<size_t>(message->size) });
+		}
+		out.write(record.get(), record.size);
+	}
+
+	Reader::Reader(const std::string& path) :
+		in(path, std::ios::in | std::ios::binary) {
+		std::string header(magic.size(), '\0');
+		in.read(header.data(), header.size());
+		invalid = !in || header != magic;
+	}
+
+	bool Reader::valid() const {
+		return !invalid;
+	}
+
+	bool Reader::next(Event& event) {
+		uint32_t kind, sincePrevious, connection, size = 0;
+		if (invalid || in.peek() == std::ifstream::traits_type::eof()) {
+			return false;
+		}
+		if (!readVarint(kind) || kind > static_cast<uint32_t>(EventKind::closed) || !readVarint(sincePrevious) || !readVarint(connection)) {
+			invalid = true;
+			return false;
+		}
+		event.kind = static_cast<EventKind>(kind);
+		if (event.kind != EventKind::closed && (!readVarint(size) || size > msg::maxFrameSize)) {
+			invalid = true;
+			return false;
+		}
+		event.message.clear();
+		event.message.reserve(static_cast<int>(size));
+		if (!in.read(event.message.get(), size)) {
+			invalid = true;
+			return false;
+		}
+		event.message.size = static_cast<int>(size);
+		at += std::chrono::microseconds{ sincePrevious };
+		event.at = at;
+		event.connection = connection;
+		return true;
+	}
+
+	bool Reader::corrupted() const {
+		return invalid;
+	}
+
+	bool Reader::readVarint(uint32_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 7 * msg::maxVarintSize; shift += 7) {
+			const auto byte = in.get();
+			if (byte == std::ifstream::traits_type::eof()) {
+				return false;
+			}
+			value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Replayer::Replayer(Repository& repo) :
+		repo(repo) {}
+
+	ReplayReport Replayer::run(Reader& reader, const Pace pace) {
+		ReplayReport report;
+		metrics::Histogram processNs;
+		Event event;
+		const auto start = std::chrono::steady_clock::now();
+		while (reader.next(event)) {
+			switch (event.kind) {
+			case EventKind::closed:
+				replayedResponses.erase(event.connection);
+				repo.closeConnection(event.connection);
+				continue;
+			case EventKind::response:
+				mapIdentifiers(event.connection, event.message);
+				continue;
+			case EventKind::request:
+				break;
+			}
+			if (pace == Pace::original) {
+				std::this_thread::sleep_until(start + event.at);
+			}
+			rewrite(event.message);
+			const auto processStart = std::chrono::steady_clock::now();
+			auto [response, responseType] = repo.process(event.message, event.connection);
+			processNs.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - processStart).count());
+			report.requests++;
+			if (responseType != ResponseType::none && response.size > 1) {
+				const auto type = msg::Header::parse(response).type;
+				report.errors += type == msg::MessageType::error ? 1 : 0;
+				if (handsOutIdentifiers(type)) {
+					replayedResponses[event.connection] = handedOut(response);
+				}
+			}
+			scratch::Arena::local().reset();
+		}
+		report.elapsed = std::chrono::steady_clock::now() - start;
+		processNs.addTo(report.processNs);
+		return report;
+	}
+
+	Replayer::HandedOut Replayer::handedOut(msg::Buffer& response) {
+		const auto type = msg::Header::parse(response).type;
+		switch (type) {
+		case msg::MessageType::login: {
+			auto login = msg::ServerResponse<2>::parse(response);
+			return { type, login.messages[0], login.messages[1] };
+		}
+		case msg::MessageType::create:
+			return { type, msg::ServerResponse<1>::parse(response).messages[0], "" };
+		case msg::MessageType::load:
+			return { type, msg::ServerResponse<3>::parse(response).messages[1], "" };
+		default:
+			return { type, "", "" };
+		}
+	}
+
+	void Replayer::mapIdentifiers(const uint32_t connection, msg::Buffer& recorded) {
+		auto it = replayedResponses.find(connection);
+		if (it == replayedResponses.end()) {
+			// The replay failed where the recorded request succeeded, later requests fail alike
+			return;
+		}
+		const HandedOut replayed = std::move(it->second);
+		replayedResponses.erase(it);
+		const HandedOut original = handedOut(recorded);
+		if (original.type != replayed.type) {
+			return;
+		}
+		// Only differing ones are kept, a replay with the recorded ids rewrites nothing
+		if (original.id != replayed.id) {
+			identifiers[original.id] = replayed.id;
+		}
+		if (original.session != replayed.session) {
+			sessions[static_cast<uint32_t>(std::stoul(original.session))] = static_cast<uint32_t>(std::stoul(replayed.session));
+		}
+	}
+
+	void Replayer::rewrite(msg::Buffer& message) {
+		if ((identifiers.empty() && sessions.empty()) || message.size <= 1) {
+			return;
+		}
+		thread_local msg::Buffer rewritten{ 128 };
+		rewritten.clear();
+		switch (msg::Header::parse(message).type) {
+		case msg::MessageType::create: {
+			auto [create, valid] = msg::Create::parse(message);
+			if (!valid) {
+				return;
+			}
+			create.token = mapped(create.token);
+			create.serializeTo(rewritten);
+			break;
+		}
+		case msg::MessageType::load: {
+			auto [load, valid] = msg::Load::parse(message);
+			if (!valid) {
+				return;
+			}
+			load.token = mapped(load.token);
+			load.serializeTo(rewritten);
+			break;
+		}
+		case msg::MessageType::join: {
+			auto [join, valid] = msg::Join::parse(message);
+			if (!valid) {
+				return;
+			}
+			join.token = mapped(join.token);
+			join.accessCode = mapped(join.accessCode);
+			join.serializeTo(rewritten);
+			break;
+		}
+		case msg::MessageType::undo: {
+			auto [undo, valid] = msg::Undo::parse(message);
+			if (!valid) {
+				return;
+			}
+			undo.token = mapped(undo.token);
+			undo.serializeTo(rewritten);
+			break;
+		}
+		case msg::MessageType::redo: {
+			auto [redo, valid] = msg::Redo::parse(message);
+			if (!valid) {
+				return;
+			}
+			redo.token = mapped(redo.token);
+			redo.serializeTo(rewritten);
+			break;
+		}
+		case msg::MessageType::resync: {
+			auto [resync, valid] = msg::Resync::parse(message);
+			if (!valid) {
+				return;
+			}
+			resync.token = mapped(resync.token);
+			resync.accessCode = mapped(resync.accessCode);
+			resync.serializeTo(rewritten);
+			break;
+		}
+		case msg::MessageType::write: {
+			auto [write, valid] = msg::WriteView::parse(message);
+			if (!valid) {
+				return;
+			}
+			msg::Write{ write.header.version, write.header.errCode, mappedSession(write.sessionId), write.cursorPos, std::string{ write.text },
+				write.revision, write.sentAt }.serializeTo(rewritten);
+			break;
+		}
+		case msg::MessageType::erase: {
+			auto [erase, valid] = msg::EraseView::parse(message);
+			if (!valid) {
+				return;
+			}
+			msg::Erase{ erase.header.version, erase.header.errCode, mappedSession(erase.sessionId), erase.cursorPos, erase.eraseSize,
+				erase.revision, erase.sentAt }.serializeTo(rewritten);
+			break;
+		}
+		case msg::MessageType::batch: {
+			auto [batch, valid] = msg::Batch::parse(message);
+			if (!valid) {
+				return;
+			}
+			batch.sessionId = mappedSession(batch.sessionId);
+			batch.serializeTo(rewritten);
+			break;
+		}
+		default:
+			return;
+		}
+		swapBuffers(message, rewritten);
+	}
+
+	const std::string& Replayer::mapped(const std::string& recorded) const {
+		auto it = identifiers.find(recorded);
+		return it == identifiers.end() ? recorded : it->second;
+	}
+
+	uint32_t Replayer::mappedSession(const uint32_t recorded) const {
+		auto it = sessions.find(recorded);
+		return it == sessions.end() ? recorded : it->second;
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <string>
+#include <fstream>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+#include <winsock2.h>
+
+#include "messages.h"
+#include "histogram.h"
+#include "repository.h"
+
+/*
+	Binary trace of what the server received, for replaying real editing sessions without sockets.
+	After the magic every record is
+		varint kind, varint microseconds since the previous record, varint connection
+	and a request or response record goes on with varint size and the msg itself. Connection
+	ids are handed out densely and reused after close, so they stay 1 byte for most traces.
+	Besides the requests, responses which hand out identifiers (Login, Create, Load) are kept -
+	a replay gets other tokens, access codes and session ids and maps the recorded ones to them.
+	Passwords of Register and Login are replaced by redactedPassword, a replay registers its users
+	from scratch and only needs them to match.
+*/
+namespace trace {
+	constexpr std::string_view magic{ "TXTRACE1" };
+	const std::string redactedPassword = "redacted";
+
+	enum class EventKind { request, response, closed };
+
+	struct Event {
+		EventKind kind = EventKind::request;
+		// Since the first record of the trace
+		std::chrono::microseconds at{ 0 };
+		uint32_t connection = 0;
+		msg::Buffer message{ 128 };
+	};
+
+	// Shared by all workers, records are written in the order they are taken
+	class Recorder {
+	public:
+		explicit Recorder(const std::string& path);
+		bool valid() const;
+		void request(const SOCKET client, msg::Buffer& message);
+		// Kept only for msgs which hand out identifiers
+		void response(const SOCKET client, msg::Buffer& message);
+		void closed(const SOCKET client);
+		void flush();
+
+	private:
+		uint32_t connectionOf(const SOCKET client);
+		void write(const EventKind kind, const uint32_t connection, msg::Buffer* message);
+
+		std::ofstream out;
+		std::chrono::steady_clock::time_point last;
+		bool started = false;
+		std::unordered_map<SOCKET, uint32_t> connections;
+		std::vector<uint32_t> freeConnections;
+		uint32_t nextConnection = 0;
+		msg::Buffer record{ 128 };
+		msg::Buffer redacted{ 128 };
+		std::mutex lock;
+	};
+
+	class Reader {
+	public:
+		explicit Reader(const std::string& path);
+		bool valid() const;
+		// False at the end of the trace or on a malformed record
+		bool next(Event& event);
+		bool corrupted() const;
+
+	private:
+		bool readVarint(uint32_t& value);
+
+		std::ifstream in;
+		std::chrono::microseconds at{ 0 };
+		bool invalid = false;
+	};
+
+	enum class Pace { original, flatOut };
+
+	struct ReplayReport {
+		uint64_t requests = 0;
+		uint64_t errors = 0;
+		std::chrono::nanoseconds elapsed{ 0 };
+		// Repository::process of each request, in nanoseconds
+		metrics::HistogramSnapshot processNs;
+	};
+
+	/*
+		Feeds the requests of a trace into Repository::process in the recorded order, either
+		keeping the recorded gaps between them or back to back. Tokens, access codes and session
+		ids in the requests are rewritten to the ones this repository handed out, so a trace
+		replays against fresh databases as long as it starts before its users logged in.
+	*/
+	class Replayer {
+	public:
+		explicit Replayer(Repository& repo);
+		ReplayReport run(Reader& reader, const Pace pace);
+
+	private:
+		// Token or access code and the session id of a Login
+		struct HandedOut {
+			msg::MessageType type;
+			std::string id;
+			std::string session;
+		};
+
+		static HandedOut handedOut(msg::Buffer& response);
+		void mapIdentifiers(const uint32_t connection, msg::Buffer& recorded);
+		void rewrite(msg::Buffer& message);
+		const std::string& mapped(const std::string& recorded) const;
+		uint32_t mappedSession(const uint32_t recorded) const;
+
+		Repository& repo;
+		// Responses of this replay waiting for their recorded counterparts
+		std::unordered_map<uint32_t, HandedOut> replayedResponses;
+		std::unordered_map<std::string, std::string> identifiers;
+		std::unordered_map<uint32_t, uint32_t> sessions;
+	};
+
+	// Login, Create and Load responses carry what later requests refer to
+	bool handsOutIdentifiers(const msg::MessageType type);
+}
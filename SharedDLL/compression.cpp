@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "compression.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace lz4 {
+
+	constexpr size_t minMatch = 4;
+	// Last match has to start at least 12 bytes and end at least 5 bytes before the end of the block
+	constexpr size_t matchStartLimit = 12;
+	constexpr size_t lastLiterals = 5;
+	constexpr int hashBits = 12;
+	constexpr uint32_t noPosition = UINT32_MAX;
+
+	uint32_t read32(const char* data) {
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint32_t hash(const uint32_t sequence) {
+		return (sequence * 2654435761u) >> (32 - hashBits);
+	}
+
+	int compressBound(const int size) {
+		return size + size / 255 + 16;
+	}
+
+	int compress(const char* data, const size_t offset, const size_t size, char* out, const int capacity, const int acceleration) {
+		const size_t end = offset + size;
+		const size_t windowStart = offset > windowSize ? offset - windowSize : 0;
+		std::array<uint32_t, 1 << hashBits> table;
+		table.fill(noPosition);
+		for (size_t pos = windowStart; pos + minMatch <= offset; pos += acceleration) {
+			table[hash(read32(data + pos))] = static_cast<uint32_t>(pos);
+		}
+
+		int written = 0;
+		auto fits = [&](const size_t bytes) {
+			return written + bytes <= static_cast<size_t>(capacity);
+		};
+		auto writeLength = [&](size_t length) {
+			for (; length >= 255; length -= 255) {
+				out[written++] = static_cast<char>(255);
+			}
+			out[written++] = static_cast<char>(length);
+		};
+		auto writeSequence = [&](const size_t literalsBegin, const size_t literalCount, const size_t matchOffset, const size_t matchLength) {
+			if (!fits(1 + literalCount / 255 + 1 + literalCount + 2 + matchLength / 255 + 1)) {
+				return false;
+			}
+			char& token = out[written++];
+			token = static_cast<char>((literalCount >= 15 ? 15 : literalCount) << 4);
+			if (literalCount >= 15) {
+				writeLength(literalCount - 15);
+			}
+			memcpy(out + written, data + literalsBegin, literalCount);
+			written += static_cast<int>(literalCount);
+			if (matchLength == 0) {
+				return true;
+			}
+			out[written++] = static_cast<char>(matchOffset & 0xff);
+			out[written++] = static_cast<char>(matchOffset >> 8);
+			const size_t extraLength = matchLength - minMatch;
+			token |= static_cast<char>(extraLength >= 15 ? 15 : extraLength);
+			if (extraLength >= 15) {
+				writeLength(extraLength - 15);
+			}
+			return true;
+		};
+
+		size_t anchor = offset;
+		size_t pos = offset;
+		size_t misses = 0;
+		while (size > matchStartLimit && pos < end - matchStartLimit) {
+			const uint32_t sequence = read32(data + pos);
+			const uint32_t candidate = table[hash(sequence)];
+			table[hash(sequence)] = static_cast<uint32_t>(pos);
+			// The table outlives the window as pos moves on, an older candidate cannot be encoded in 16 bits
+			if (candidate == noPosition || pos - candidate > windowSize || read32(data + candidate) != sequence) {
+				pos += acceleration + (misses++ >> 5);
+				continue;
+			}
+			size_t length = minMatch;
+			while (pos + length < end - lastLiterals && data[candidate + length] == data[pos + length]) {
+				length++;
+			}
+			if (!writeSequence(anchor, pos - anchor, pos - candidate, length)) {
+				return 0;
+			}
+			pos += length;
+			anchor = pos;
+			misses = 0;
+		}
+		if (!writeSequence(anchor, end - anchor, 0, 0)) {
+			return 0;
+		}
+		return written;
+	}
+
+	bool decompress(std::string_view compressed, std::string& out, const size_t rawSize) {
+		const size_t begin = out.size();
+		const size_t target = begin + rawSize;
+		out.resize(target);
+		const auto* in = reinterpret_cast<const unsigned char*>(compressed.data());
+		size_t i = 0;
+		size_t written = begin;
+		auto readLength = [&](size_t& length) {
+			unsigned char extra = 255;
+			while (extra == 255) {
+				if (i >= compressed.size()) {
+					return false;
+				}
+				extra = in[i++];
+				length += extra;
+			}
+			return true;
+		};
+
+		while (i < compressed.size()) {
+			const unsigned char token = in[i++];
+			size_t literalCount = token >> 4;
+			if (literalCount == 15 && !readLength(literalCount)) {
+				break;
+			}
+			if (literalCount > compressed.size() - i || literalCount > target - written) {
+				break;
+			}
+			memcpy(out.data() + written, in + i, literalCount);
+			i += literalCount;
+			written += literalCount;
+			if (i == compressed.size()) {
+				// Last sequence has literals only
+				if (written == target) {
+					return true;
+				}
+				break;
+			}
+			if (compressed.size() - i < 2) {
+				break;
+			}
+			const size_t matchOffset = in[i] | (in[i + 1] << 8);
+			i += 2;
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !readLength(matchLength)) {
+				break;
+			}
+			matchLength += minMatch;
+			if (matchOffset == 0 || matchOffset > written || matchLength > target - written) {
+				break;
+			}
+			// Byte by byte, a match may overlap the bytes it produces
+			for (size_t k = 0; k < matchLength; k++, written++) {
+				out[written] = out[written - matchOffset];
+			}
+		}
+		out.resize(begin);
+		return false;
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+#ifdef SHAREDDLL_EXPORTS
+#define COMPRESSION_API __declspec(dllexport)
+#else
+#define COMPRESSION_API __declspec(dllimport)
+#endif
+
+namespace lz4 {
+	/*
+		LZ4 block format: sequences of
+			token (literal length << 4 | match length - 4) | literals | 2 byte LE match offset
+		with lengths of 15 and more continued in extra bytes. Matches may reach up to windowSize
+		bytes back, also into text compressed before - consecutive parts of one document form
+		a stream and each part can refer to the previous ones.
+		acceleration trades ratio for speed - 1 checks every position, higher values skip faster
+		over data which does not compress.
+	*/
+	constexpr size_t windowSize = 64 * 1024 - 1;
+
+	COMPRESSION_API int compressBound(const int size);
+	// Compresses data[offset, offset + size), returns 0 when the output would not fit into capacity
+	COMPRESSION_API int compress(const char* data, const size_t offset, const size_t size, char* out, const int capacity, const int acceleration);
+	// Appends rawSize decompressed bytes to out, matches may refer to what out already holds
+	COMPRESSION_API bool decompress(std::string_view compressed, std::string& out, const size_t rawSize);
+}
@@ -0,0 +1,444 @@
+#include "pch.h"
+#include "crdt_document.h"
+#include <algorithm>
+
+namespace crdt {
+
+	// Both MSVC and libstdc++ keep up to 15 letters inside std::string itself
+	constexpr size_t inlineStringCapacity = 15;
+	// A full block is cut in half, so splicing a run in moves at most this many runs
+	constexpr size_t maxBlockRuns = 64;
+
+	namespace {
+		// Snapshot letters of the reserved agent are loaded by every replica before any op
+		bool delivered(const Id& id, const VersionVector& stable) {
+			if (id.agent == 0) {
+				return true;
+			}
+			auto it = stable.find(id.agent);
+			return it != stable.end() && id.clock <= it->second;
+		}
+	}
+
+	bool Id::operator==(const Id& other) const {
+		return agent == other.agent && clock == other.clock;
+	}
+
+	bool Id::operator!=(const Id& other) const {
+		return !(*this == other);
+	}
+
+	bool Id::operator>(const Id& other) const {
+		return clock > other.clock || (clock == other.clock && agent > other.agent);
+	}
+
+	Run* CrdtDocument::RunPos::operator->() const {
+		return &(*block)[index];
+	}
+
+	bool CrdtDocument::RunPos::operator==(const RunPos& other) const {
+		return block == other.block && index == other.index;
+	}
+
+	bool CrdtDocument::RunPos::operator!=(const RunPos& other) const {
+		return !(*this == other);
+	}
+
+	CrdtDocument::CrdtDocument(const uint32_t agent) :
+		agent(agent) {}
+
+	Op CrdtDocument::insert(const size_t pos, const std::string& text) {
+		Op op{ OpType::insert, Id{ agent, clock + 1 }, visibleIdBefore(pos), Id{}, static_cast<uint32_t>(text.size()), text };
+		if (!text.empty()) {
+			integrate(op);
+		}
+		return op;
+	}
+
+	std::vector<Op> CrdtDocument::erase(size_t pos, size_t eraseSize) {
+		std::vector<Op> ops;
+		size_t visible = 0;
+		for (const auto& block : blocks) {
+			for (const auto& run : block) {
+				if (eraseSize == 0) {
+					break;
+				}
+				if (run.erasedBy != Id{}) {
+					continue;
+				}
+				if (visible + run.length <= pos) {
+					visible += run.length;
+					continue;
+				}
+				uint32_t from = static_cast<uint32_t>(pos - visible);
+				uint32_t count = static_cast<uint32_t>((std::min)(run.length - from, static_cast<uint32_t>(eraseSize)));
+				ops.push_back(Op{ OpType::erase, Id{ agent, clock + 1 + static_cast<uint32_t>(ops.size()) }, Id{},
+					Id{ run.id.agent, run.id.clock + from }, count, "" });
+				eraseSize -= count;
+				visible += run.length;
+				pos = visible;
+			}
+		}
+		for (const auto& op : ops) {
+			integrate(op);
+		}
+		return ops;
+	}
+
+	bool CrdtDocument::apply(const Op& op) {
+		// Every replica had it before the last collection, so this is a duplicate
+		if (delivered(op.id, collected)) {
+			return true;
+		}
+		if (!integrate(op)) {
+			pending.push_back(op);
+			return false;
+		}
+		applyPending();
+		return true;
+	}
+
+	/*
+		stable[agent] is the highest clock of agent's ops which every replica has delivered, known
+		from what each replica reported after its own earlier ops arrived here. An op generated
+		before its replica delivered an erase is thus already integrated, and later ones do not
+		pick erased letters as origin or target. Tombstones whose erase is stable are dropped when
+		the run following them is stable too, so a future insert scanning past the gap stops at the
+		same place it would have stopped at the tombstone.
+	*/
+	size_t CrdtDocument::collectGarbage(const VersionVector& stable) {
+		size_t removed = 0;
+		bool nextStable = true;
+		for (auto block = blocks.rbegin(); block != blocks.rend(); block++) {
+			for (size_t i = block->size(); i-- > 0;) {
+				const Run& run = (*block)[i];
+				if (run.erasedBy != Id{} && delivered(run.erasedBy, stable) && nextStable) {
+					runIndex[run.id.agent].erase(run.id.clock);
+					block->erase(block->begin() + i);
+					removed++;
+					continue;
+				}
+				nextStable = delivered(run.id, stable);
+			}
+		}
+		blocks.remove_if([](const Block& block) { return block.empty(); });
+		for (auto run = begin(); run != end(); run = next(run)) {
+			run = tryMerge(run);
+		}
+		for (const auto& [stableAgent, stableClock] : stable) {
+			collected[stableAgent] = (std::max)(collected[stableAgent], stableClock);
+		}
+		return removed;
+	}
+
+	std::string CrdtDocument::getText() const {
+		std::string text;
+		text.reserve(size());
+		for (const auto& block : blocks) {
+			for (const auto& run : block) {
+				if (run.erasedBy == Id{}) {
+					text += run.text;
+				}
+			}
+		}
+		return text;
+	}
+
+	void CrdtDocument::setText(const std::string& txt) {
+		blocks.clear();
+		runIndex.clear();
+		pending.clear();
+		if (txt.empty()) {
+			return;
+		}
+		// Snapshot letters belong to the reserved agent so every replica loading it agrees on the ids
+		insertRun(end(), Run{ Id{ 0, 1 }, Id{}, static_cast<uint32_t>(txt.size()), Id{}, txt });
+		clock = (std::max)(clock, static_cast<uint32_t>(txt.size()));
+	}
+
+	size_t CrdtDocument::size() const {
+		size_t visible = 0;
+		for (const auto& block : blocks) {
+			for (const auto& run : block) {
+				if (run.erasedBy == Id{}) {
+					visible += run.length;
+				}
+			}
+		}
+		return visible;
+	}
+
+	size_t CrdtDocument::runCount() const {
+		size_t count = 0;
+		for (const auto& block : blocks) {
+			count += block.size();
+		}
+		return count;
+	}
+
+	size_t CrdtDocument::pendingCount() const {
+		return pending.size();
+	}
+
+	size_t CrdtDocument::memoryUsage() const {
+		// List and map nodes carry their links besides the value
+		size_t bytes = sizeof(*this) + pending.capacity() * sizeof(Op) +
+			runCount() * (sizeof(std::map<uint32_t, BlockIt>::value_type) + 4 * sizeof(void*));
+		for (const auto& block : blocks) {
+			bytes += sizeof(Block) + 2 * sizeof(void*) + block.capacity() * sizeof(Run);
+			for (const auto& run : block) {
+				if (run.text.capacity() > inlineStringCapacity) {
+					bytes += run.text.capacity() + 1;
+				}
+			}
+		}
+		return bytes;
+	}
+
+	uint32_t CrdtDocument::getClock() const {
+		return clock;
+	}
+
+	bool CrdtDocument::integrate(const Op& op) {
+		switch (op.type) {
+		case OpType::insert:
+			return integrateInsert(op);
+		case OpType::erase:
+			return integrateErase(op);
+		}
+		return false;
+	}
+
+	bool CrdtDocument::integrateInsert(const Op& op) {
+		// An op newer than every letter seen so far cannot be a duplicate, which spares typing the lookup
+		if (op.text.empty() || (op.id.clock <= clock && findRun(op.id) != end())) {
+			return true;
+		}
+		auto position = begin();
+		if (op.origin != Id{}) {
+			auto originRun = findRun(op.origin);
+			if (originRun == end()) {
+				return false;
+			}
+			uint32_t offset = op.origin.clock - originRun->id.clock;
+			position = offset + 1 < originRun->length ? splitRun(originRun, offset + 1) : next(originRun);
+		}
+		// Concurrent inserts at the same origin are ordered by descending id, and so are their subtrees
+		while (position != end() && position->id > op.id) {
+			position = next(position);
+		}
+		const auto length = static_cast<uint32_t>(op.text.size());
+		auto previous = position == begin() ? end() : prev(position);
+		if (previous != end() && previous->erasedBy == Id{} && previous->id.agent == op.id.agent &&
+			previous->id.clock + previous->length == op.id.clock && op.origin == Id{ op.id.agent, op.id.clock - 1 }) {
+			// Typing goes on where the run ends, so it grows in place as tryMerge would have done
+			previous->length += length;
+			previous->text += op.text;
+		}
+		else {
+			insertRun(position, Run{ op.id, op.origin, length, Id{}, op.text });
+		}
+		clock = (std::max)(clock, op.id.clock + length - 1);
+		return true;
+	}
+
+	bool CrdtDocument::integrateErase(const Op& op) {
+		if (!contains(op.target, op.length)) {
+			return false;
+		}
+		uint32_t erased = 0;
+		while (erased < op.length) {
+			Id letter{ op.target.agent, op.target.clock + erased };
+			auto run = findRun(letter);
+			uint32_t offset = letter.clock - run->id.clock;
+			if (offset > 0) {
+				run = splitRun(run, offset);
+			}
+			if (run->length > op.length - erased) {
+				run = prev(splitRun(run, op.length - erased));
+			}
+			if (run->erasedBy == Id{}) {
+				run->erasedBy = op.id;
+				std::string{}.swap(run->text);
+			}
+			erased += run->length;
+		}
+		clock = (std::max)(clock, op.id.clock);
+		return true;
+	}
+
+	void CrdtDocument::applyPending() {
+		bool progress = true;
+		while (progress) {
+			progress = false;
+			for (auto it = pending.begin(); it != pending.end();) {
+				if (integrate(*it)) {
+					it = pending.erase(it);
+					progress = true;
+				}
+				else {
+					it++;
+				}
+			}
+		}
+	}
+
+	CrdtDocument::RunPos CrdtDocument::begin() {
+		return RunPos{ blocks.begin(), 0 };
+	}
+
+	CrdtDocument::RunPos CrdtDocument::end() {
+		return RunPos{ blocks.end(), 0 };
+	}
+
+	CrdtDocument::RunPos CrdtDocument::next(RunPos pos) {
+		if (++pos.index == pos.block->size()) {
+			pos.block++;
+			pos.index = 0;
+		}
+		return pos;
+	}
+
+	CrdtDocument::RunPos CrdtDocument::prev(RunPos pos) {
+		if (pos.index == 0) {
+			pos.block--;
+			pos.index = pos.block->size();
+		}
+		pos.index--;
+		return pos;
+	}
+
+	CrdtDocument::RunPos CrdtDocument::findRun(const Id& id) {
+		auto agentRuns = runIndex.find(id.agent);
+		if (agentRuns == runIndex.end()) {
+			return end();
+		}
+		auto it = agentRuns->second.upper_bound(id.clock);
+		if (it == agentRuns->second.begin()) {
+			return end();
+		}
+		it--;
+		Block& block = *it->second;
+		for (size_t i = 0; i < block.size(); i++) {
+			if (block[i].id.agent == id.agent && block[i].id.clock == it->first) {
+				return id.clock < block[i].id.clock + block[i].length ? RunPos{ it->second, i } : end();
+			}
+		}
+		return end();
+	}
+
+	CrdtDocument::RunPos CrdtDocument::insertRun(RunPos pos, Run run) {
+		if (pos.block == blocks.end()) {
+			// Appended to the last block, an empty document gets its first one
+			if (blocks.empty()) {
+				blocks.emplace_back().reserve(maxBlockRuns);
+			}
+			pos = RunPos{ std::prev(blocks.end()), blocks.back().size() };
+		}
+		auto& index = runIndex[run.id.agent];
+		index[run.id.clock] = pos.block;
+		pos.block->insert(pos.block->begin() + pos.index, std::move(run));
+		if (pos.block->size() < maxBlockRuns) {
+			return pos;
+		}
+		auto upper = blocks.emplace(std::next(pos.block));
+		upper->reserve(maxBlockRuns);
+		const size_t half = maxBlockRuns / 2;
+		std::move(pos.block->begin() + half, pos.block->end(), std::back_inserter(*upper));
+		pos.block->erase(pos.block->begin() + half, pos.block->end());
+		for (const auto& moved : *upper) {
+			runIndex[moved.id.agent][moved.id.clock] = upper;
+		}
+		return pos.index < half ? pos : RunPos{ upper, pos.index - half };
+	}
+
+	void CrdtDocument::eraseRun(const RunPos pos) {
+		runIndex[pos->id.agent].erase(pos->id.clock);
+		pos.block->erase(pos.block->begin() + pos.index);
+		if (pos.block->empty()) {
+			blocks.erase(pos.block);
+		}
+	}
+
+	CrdtDocument::RunPos CrdtDocument::splitRun(const RunPos run, const uint32_t offset) {
+		Run right{
+			Id{ run->id.agent, run->id.clock + offset },
+			Id{ run->id.agent, run->id.clock + offset - 1 },
+			run->length - offset,
+			run->erasedBy,
+			run->text.empty() ? "" : run->text.substr(offset)
+		};
+		run->length = offset;
+		if (!run->text.empty()) {
+			run->text.resize(offset);
+		}
+		return insertRun(RunPos{ run.block, run.index + 1 }, std::move(right));
+	}
+
+	CrdtDocument::RunPos CrdtDocument::tryMerge(const RunPos run) {
+		if (run == begin() || run == end()) {
+			return run;
+		}
+		auto left = prev(run);
+		bool continues = left->id.agent == run->id.agent &&
+			left->id.clock + left->length == run->id.clock &&
+			run->origin == Id{ left->id.agent, run->id.clock - 1 };
+		bool bothVisible = left->erasedBy == Id{} && run->erasedBy == Id{};
+		// Erases of one agent are delivered in order, so the later one tells when both are stable
+		bool erasedByOneAgent = left->erasedBy != Id{} && run->erasedBy != Id{} && left->erasedBy.agent == run->erasedBy.agent;
+		if (!continues || (!bothVisible && !erasedByOneAgent)) {
+			return run;
+		}
+		left->length += run->length;
+		left->text += run->text;
+		if (run->erasedBy > left->erasedBy) {
+			left->erasedBy = run->erasedBy;
+		}
+		eraseRun(run);
+		return left;
+	}
+
+	bool CrdtDocument::contains(const Id& first, const uint32_t length) const {
+		auto agentRuns = runIndex.find(first.agent);
+		if (agentRuns == runIndex.end()) {
+			return false;
+		}
+		auto it = agentRuns->second.upper_bound(first.clock);
+		if (it != agentRuns->second.begin()) {
+			it--;
+		}
+		uint32_t found = 0;
+		for (; it != agentRuns->second.end() && it->first < first.clock + length; it++) {
+			auto run = std::find_if(it->second->begin(), it->second->end(), [&](const Run& candidate) {
+				return candidate.id == Id{ first.agent, it->first };
+			});
+			uint32_t from = (std::max)(it->first, first.clock);
+			uint32_t to = (std::min)(it->first + run->length, first.clock + length);
+			if (from < to) {
+				found += to - from;
+			}
+		}
+		return found == length;
+	}
+
+	Id CrdtDocument::visibleIdBefore(const size_t pos) const {
+		Id last{};
+		if (pos == 0) {
+			return last;
+		}
+		size_t visible = 0;
+		for (const auto& block : blocks) {
+			for (const auto& run : block) {
+				if (run.erasedBy != Id{}) {
+					continue;
+				}
+				if (visible + run.length >= pos) {
+					return Id{ run.id.agent, run.id.clock + static_cast<uint32_t>(pos - visible) - 1 };
+				}
+				visible += run.length;
+				last = Id{ run.id.agent, run.id.clock + run.length - 1 };
+			}
+		}
+		return last;
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <cstdint>
+
+#ifdef SHAREDDLL_EXPORTS
+#define CRDT_API __declspec(dllexport)
+#else
+#define CRDT_API __declspec(dllimport)
+#endif
+
+namespace crdt {
+	/*
+		Sequence CRDT (RGA) with run-length encoded ids. Every character is identified by
+		{agent, clock}, where clock is a Lamport clock. Characters typed one after another by
+		the same agent get consecutive clocks and are stored as one Run, so a typing burst
+		costs one entry instead of one per letter.
+		Agent 0 is reserved - Id{0, 0} means "beginning of the document".
+	*/
+	struct CRDT_API Id {
+		uint32_t agent = 0;
+		uint32_t clock = 0;
+		bool operator==(const Id& other) const;
+		bool operator!=(const Id& other) const;
+		bool operator>(const Id& other) const;
+	};
+
+	// Highest clock of every agent whose ops are known to be delivered, missing agents have 0
+	using VersionVector = std::unordered_map<uint32_t, uint32_t>;
+
+	enum class OpType { insert, erase };
+
+	/*
+		insert: id of the first letter, origin is the letter on the left (Id{} for the start), text
+		erase: id of the erasing op, target is the first erased letter, length erased letters
+		       (target.clock .. target.clock + length - 1 of target.agent)
+	*/
+	struct CRDT_API Op {
+		OpType type;
+		Id id;
+		Id origin;
+		Id target;
+		uint32_t length = 0;
+		std::string text;
+	};
+
+	struct Run {
+		Id id;
+		Id origin;
+		uint32_t length;
+		// Id of the erase op for tombstones, Id{} while the letters are visible
+		Id erasedBy;
+		std::string text;
+	};
+
+	class CRDT_API CrdtDocument {
+	public:
+		CrdtDocument(const uint32_t agent);
+		Op insert(const size_t pos, const std::string& text);
+		std::vector<Op> erase(const size_t pos, const size_t eraseSize);
+		bool apply(const Op& op);
+		size_t collectGarbage(const VersionVector& stable);
+
+		std::string getText() const;
+		void setText(const std::string& txt);
+		size_t size() const;
+		size_t runCount() const;
+		size_t pendingCount() const;
+		size_t memoryUsage() const;
+		uint32_t getClock() const;
+
+	private:
+		using Block = std::vector<Run>;
+		using BlockIt = std::list<Block>::iterator;
+		// Run at index of block, block is blocks.end() past the last run
+		struct RunPos {
+			BlockIt block;
+			size_t index;
+			Run* operator->() const;
+			bool operator==(const RunPos& other) const;
+			bool operator!=(const RunPos& other) const;
+		};
+
+		bool integrate(const Op& op);
+		bool integrateInsert(const Op& op);
+		bool integrateErase(const Op& op);
+		void applyPending();
+
+		RunPos begin();
+		RunPos end();
+		RunPos next(RunPos pos);
+		RunPos prev(RunPos pos);
+		RunPos findRun(const Id& id);
+		RunPos insertRun(RunPos pos, Run run);
+		void eraseRun(const RunPos pos);
+		// Returns the right part, which starts offset letters into run
+		RunPos splitRun(const RunPos run, const uint32_t offset);
+		// Returns where the letters of run are afterwards
+		RunPos tryMerge(const RunPos run);
+		bool contains(const Id& first, const uint32_t length) const;
+		Id visibleIdBefore(const size_t pos) const;
+
+		uint32_t agent;
+		uint32_t clock = 0;
+		VersionVector collected;
+		/*
+			Runs in document order, cut into blocks of at most maxBlockRuns. Splicing a run in moves
+			only the runs of its block and scans stay as fast as over one vector, while runIndex
+			points to blocks, which do not move.
+		*/
+		std::list<Block> blocks;
+		// Block of every run by the agent and clock of its first letter, so ops find it without a scan
+		std::unordered_map<uint32_t, std::map<uint32_t, BlockIt>> runIndex;
+		std::vector<Op> pending;
+	};
+}
@@ -2,6 +2,7 @@
 
 #include "pch.h"
 #include "document.h"
+#include "spans.h"
 #include <algorithm>
 
 Document::Document() {
@@ -32,6 +33,39 @@ std::string Document::getLine(const int lineIndex) const {
 	return data[lineIndex];
 }
 
+namespace {
+	template<typename STRING>
+	void takeTextBefore(const std::vector<std::string>& data, const COORD cursorPos, const int size, STRING& text) {
+		if (size <= 0) {
+			return;
+		}
+		int lineIndex = cursorPos.Y;
+		int letterIndex = cursorPos.X;
+		while (text.size() < static_cast<size_t>(size) && (lineIndex > 0 || letterIndex > 0)) {
+			if (letterIndex == 0) {
+				lineIndex--;
+				letterIndex = data[lineIndex].size();
+				continue;
+			}
+			int toTake = (std::min)(letterIndex, size - (int)text.size());
+			text.insert(0, data[lineIndex], letterIndex - toTake, toTake);
+			letterIndex -= toTake;
+		}
+	}
+}
+
+std::string Document::getTextBefore(const int size) const {
+	std::string text;
+	takeTextBefore(data, cursorPos, size, text);
+	return text;
+}
+
+std::pmr::string Document::getTextBefore(const int size, std::pmr::memory_resource* resource) const {
+	std::pmr::string text{ resource };
+	takeTextBefore(data, cursorPos, size, text);
+	return text;
+}
+
 std::string Document::getText() const {
 	std::string text;
 	for (const auto& line : data) {
@@ -41,6 +75,7 @@ std::string Document::getText() const {
 }
 
 void Document::setText(const std::string& txt) {
+	SPAN("Document::setText");
 	std::vector<std::string> textData;
 	int offset = 0;
 	int endLinePos = 0;
@@ -87,7 +122,8 @@ COORD Document::write(const char letter) {
 	return cursorPos;
 }
 
-COORD Document::write(const std::string& text) {
+COORD Document::write(std::string_view text) {
+	SPAN("Document::write");
 	for (const auto letter : text) {
 		write(letter);
 	}
@@ -119,7 +155,9 @@ COORD Document::erase() {
 }
 
 COORD Document::erase(const int eraseSize) {
-	for (int i = 0; i < eraseSize; i++) {
+	SPAN("Document::erase");
+	// Nothing is left to erase once the cursor reached the start
+	for (int i = 0; i < eraseSize && (cursorPos.X > 0 || cursorPos.Y > 0); i++) {
 		erase();
 	}
 	return cursorPos;
@@ -3,7 +3,9 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <memory_resource>
 #include "windows.h"
 
 #ifdef SHAREDDLL_EXPORTS
@@ -17,7 +19,7 @@ public:
 	Document();
 	Document(const std::string& text);
 	COORD write(const char letter);
-	COORD write(const std::string& text);
+	COORD write(std::string_view text);
 	COORD erase();
 	COORD erase(const int eraseSize);
 	std::string submit();
@@ -29,6 +31,8 @@ public:
 	bool setCursorPos(COORD newPos);
 	COORD getCursorPos() const;
 	std::string getLine(const int lineIndex) const;
+	std::string getTextBefore(const int size) const;
+	std::pmr::string getTextBefore(const int size, std::pmr::memory_resource* resource) const;
 	std::string getText() const;
 	void setText(const std::string& txt);
 	const std::vector<std::string>& get();
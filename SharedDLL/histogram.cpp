@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "histogram.h"
+#include <algorithm>
+
+namespace metrics {
+
+	namespace {
+		int bitWidth(uint64_t value) {
+			int width = 0;
+			for (int step = 32; step > 0; step /= 2) {
+				if (value >> step) {
+					value >>= step;
+					width += step;
+				}
+			}
+			return width + static_cast<int>(value);
+		}
+	}
+
+	size_t bucketOf(const uint64_t value) {
+		if (value < 2 * subBuckets) {
+			return static_cast<size_t>(value);
+		}
+		const int shift = bitWidth(value) - subBucketBits - 1;
+		const uint64_t top = value >> shift;
+		return static_cast<size_t>(2 * subBuckets + (shift - 1) * subBuckets + (top - subBuckets));
+	}
+
+	uint64_t bucketUpperBound(const size_t bucket) {
+		if (bucket < 2 * subBuckets) {
+			return bucket;
+		}
+		const int shift = static_cast<int>((bucket - 2 * subBuckets) / subBuckets) + 1;
+		const uint64_t top = subBuckets + (bucket - 2 * subBuckets) % subBuckets;
+		// Wraps around to UINT64_MAX for the very last bucket
+		return ((top + 1) << shift) - 1;
+	}
+
+	uint64_t HistogramSnapshot::quantile(const double q) const {
+		if (count == 0) {
+			return 0;
+		}
+		const uint64_t rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+		uint64_t seen = 0;
+		for (size_t i = 0; i < bucketCount; i++) {
+			seen += buckets[i];
+			if (seen >= rank) {
+				return (std::min)(bucketUpperBound(i), max);
+			}
+		}
+		return max;
+	}
+
+	HistogramSnapshot HistogramSnapshot::since(const HistogramSnapshot& earlier) const {
+		HistogramSnapshot interval;
+		for (size_t i = 0; i < bucketCount; i++) {
+			interval.buckets[i] = buckets[i] - earlier.buckets[i];
+			if (interval.buckets[i] > 0) {
+				interval.max = (std::min)(bucketUpperBound(i), max);
+			}
+		}
+		interval.count = count - earlier.count;
+		interval.sum = sum - earlier.sum;
+		return interval;
+	}
+
+	void HistogramSnapshot::add(const HistogramSnapshot& other) {
+		for (size_t i = 0; i < bucketCount; i++) {
+			buckets[i] += other.buckets[i];
+		}
+		count += other.count;
+		sum += other.sum;
+		max = (std::max)(max, other.max);
+	}
+
+	void Histogram::record(const uint64_t value) {
+		increment(buckets[bucketOf(value)], 1);
+		increment(count, 1);
+		increment(sum, value);
+		if (value > max.load(std::memory_order_relaxed)) {
+			max.store(value, std::memory_order_relaxed);
+		}
+	}
+
+	void Histogram::addTo(HistogramSnapshot& snapshot) const {
+		for (size_t i = 0; i < bucketCount; i++) {
+			snapshot.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+		}
+		snapshot.count += count.load(std::memory_order_relaxed);
+		snapshot.sum += sum.load(std::memory_order_relaxed);
+		snapshot.max = (std::max)(snapshot.max, max.load(std::memory_order_relaxed));
+	}
+
+	void appendMetric(std::string& out, std::string_view prefix, std::string_view name, const uint64_t value) {
+		if (name.substr(0, prefix.size()) != prefix) {
+			return;
+		}
+		out.append(name).append(" ").append(std::to_string(value)).append("\n");
+	}
+
+	void appendHistogram(std::string& out, std::string_view prefix, std::string_view name, const HistogramSnapshot& histogram,
+		std::string_view labels) {
+		const std::string base{ name };
+		const std::string labelSet = labels.empty() ? "" : "{" + std::string{ labels } + "}";
+		appendMetric(out, prefix, base + "_count" + labelSet, histogram.count);
+		appendMetric(out, prefix, base + "_sum" + labelSet, histogram.sum);
+		appendMetric(out, prefix, base + "_max" + labelSet, histogram.max);
+		const std::string quantileLabels = labels.empty() ? "{quantile=\"" : "{" + std::string{ labels } + ",quantile=\"";
+		for (const auto& [label, q] : { std::pair{ "0.5", 0.5 }, std::pair{ "0.9", 0.9 }, std::pair{ "0.99", 0.99 }, std::pair{ "0.999", 0.999 } }) {
+			appendMetric(out, prefix, base + quantileLabels + label + "\"}", histogram.quantile(q));
+		}
+	}
+}
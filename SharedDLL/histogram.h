@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#ifdef SHAREDDLL_EXPORTS
+#define HISTOGRAM_API __declspec(dllexport)
+#else
+#define HISTOGRAM_API __declspec(dllimport)
+#endif
+
+namespace metrics {
+	/*
+		HDR-style buckets: values below 2 * subBuckets have a bucket each, every further power of
+		two is split into subBuckets equal parts. Any uint64 value fits and a quantile is known
+		within 1 / subBuckets (about 3%) of the true value.
+	*/
+	constexpr int subBucketBits = 5;
+	constexpr uint64_t subBuckets = uint64_t{ 1 } << subBucketBits;
+	constexpr size_t bucketCount = 2 * subBuckets + (64 - subBucketBits - 1) * subBuckets;
+
+	// Adds to a counter which only one thread writes, a plain load and store is enough then and avoids a locked add
+	inline void increment(std::atomic<uint64_t>& to, const uint64_t value) {
+		to.store(to.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	HISTOGRAM_API size_t bucketOf(const uint64_t value);
+	// Highest value which falls into the bucket
+	HISTOGRAM_API uint64_t bucketUpperBound(const size_t bucket);
+
+	struct HISTOGRAM_API HistogramSnapshot {
+		std::array<uint64_t, bucketCount> buckets{};
+		uint64_t count = 0;
+		uint64_t sum = 0;
+		uint64_t max = 0;
+
+		// Upper bound of the bucket holding the q-th value, 0 <= q <= 1
+		uint64_t quantile(const double q) const;
+		// Values recorded after earlier was taken, max is then the upper bound of the highest bucket
+		HistogramSnapshot since(const HistogramSnapshot& earlier) const;
+		// Merges values recorded by another histogram
+		void add(const HistogramSnapshot& other);
+	};
+
+	// One writer thread at a time, any thread may read it meanwhile
+	struct HISTOGRAM_API Histogram {
+		std::array<std::atomic<uint64_t>, bucketCount> buckets{};
+		std::atomic<uint64_t> count{ 0 };
+		std::atomic<uint64_t> sum{ 0 };
+		std::atomic<uint64_t> max{ 0 };
+
+		void record(const uint64_t value);
+		void addTo(HistogramSnapshot& snapshot) const;
+	};
+
+	// "name value" line like in Prometheus text exposition, skipped when name does not start with prefix
+	HISTOGRAM_API void appendMetric(std::string& out, std::string_view prefix, std::string_view name, const uint64_t value);
+	// name_count, name_sum, name_max and the p50, p90, p99 and p999 lines of a histogram, labels like key="value",key2="value2"
+	HISTOGRAM_API void appendHistogram(std::string& out, std::string_view prefix, std::string_view name, const HistogramSnapshot& histogram,
+		std::string_view labels = {});
+}
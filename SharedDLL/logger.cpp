@@ -1,12 +1,409 @@
 #include "pch.h"
-#include <ctime>
+#include <cstring>
+#include <climits>
+#include <chrono>
+#include <filesystem>
 #include "logger.h"
+#include "compression.h"
 
 #pragma push_macro("ERROR")
 #undef ERROR
 
 namespace logs {
 
+	constexpr auto drainInterval = std::chrono::milliseconds(10);
+	constexpr size_t segmentBlockSize = 64 * 1024;
+
+	// timestamp is steady clock ns, formatId 0 marks an already formatted line
+	struct RecordHeader {
+		uint32_t size;
+		uint32_t formatId;
+		Level lvl;
+		int64_t timestamp;
+	};
+
+	/*
+		Single producer single consumer byte ring owned by one logging thread. head and tail only
+		grow, position in data is their value modulo ringSize.
+	*/
+	class Ring {
+	public:
+		Ring(const std::thread::id owner) :
+			owner(owner),
+			data(ringSize) {}
+
+		bool push(const RecordHeader& header, std::string_view text) {
+			const size_t start = head.load(std::memory_order_relaxed);
+			if (ringSize - (start - tail.load(std::memory_order_acquire)) < sizeof(RecordHeader) + text.size()) {
+				return false;
+			}
+			copyIn(start, reinterpret_cast<const char*>(&header), sizeof(RecordHeader));
+			copyIn(start + sizeof(RecordHeader), text.data(), text.size());
+			head.store(start + sizeof(RecordHeader) + text.size(), std::memory_order_release);
+			return true;
+		}
+
+		template<typename Consumer>
+		void drain(Consumer consume) {
+			size_t start = tail.load(std::memory_order_relaxed);
+			const size_t end = head.load(std::memory_order_acquire);
+			char text[maxLineSize];
+			while (start < end) {
+				RecordHeader header;
+				copyOut(start, reinterpret_cast<char*>(&header), sizeof(RecordHeader));
+				copyOut(start + sizeof(RecordHeader), text, header.size);
+				consume(header, std::string_view{ text, header.size });
+				start += sizeof(RecordHeader) + header.size;
+			}
+			tail.store(start, std::memory_order_release);
+		}
+
+		const std::thread::id owner;
+
+	private:
+		void copyIn(const size_t pos, const char* from, const size_t size) {
+			const size_t offset = pos % ringSize;
+			const size_t first = (std::min)(size, ringSize - offset);
+			memcpy(data.data() + offset, from, first);
+			memcpy(data.data(), from + first, size - first);
+		}
+
+		void copyOut(const size_t pos, char* to, const size_t size) const {
+			const size_t offset = pos % ringSize;
+			const size_t first = (std::min)(size, ringSize - offset);
+			memcpy(to, data.data() + offset, first);
+			memcpy(to + first, data.data(), size - first);
+		}
+
+		std::vector<char> data;
+		std::atomic<size_t> head{ 0 };
+		std::atomic<size_t> tail{ 0 };
+	};
+
+	namespace {
+		struct Format {
+			Level lvl;
+			std::vector<FormatPart> parts;
+		};
+		std::mutex formatsLock;
+		std::vector<Format> formats;
+
+		int64_t nanoseconds(const std::chrono::nanoseconds duration) {
+			return duration.count();
+		}
+
+		constexpr int64_t nanosecondsPerSecond = 1000000000;
+
+		// Proleptic Gregorian date of a day counted from 1970-01-01
+		void civilFromDays(int64_t days, int& year, int& month, int& day) {
+			days += 719468;
+			const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+			const int64_t dayOfEra = days - era * 146097;
+			const int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+			const int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+			const int64_t shiftedMonth = (5 * dayOfYear + 2) / 153;
+			day = static_cast<int>(dayOfYear - (153 * shiftedMonth + 2) / 5 + 1);
+			month = static_cast<int>(shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9);
+			year = static_cast<int>(yearOfEra + era * 400 + (month <= 2));
+		}
+
+		void putDigits(char* out, int value, const int count) {
+			for (int i = count - 1; i >= 0; i--) {
+				out[i] = static_cast<char>('0' + value % 10);
+				value /= 10;
+			}
+		}
+
+		/*
+			"YYYY-MM-DDThh:mm:ss" of the last second seen by this thread. Lines of one second only
+			differ in the fraction, so the date is rendered again once a second at most.
+		*/
+		struct TimestampCache {
+			int64_t second = INT64_MIN;
+			char prefix[19];
+
+			void render(const int64_t newSecond) {
+				second = newSecond;
+				int64_t days = second / 86400;
+				int64_t inDay = second % 86400;
+				if (inDay < 0) {
+					inDay += 86400;
+					days--;
+				}
+				int year, month, day;
+				civilFromDays(days, year, month, day);
+				putDigits(prefix, year, 4);
+				prefix[4] = '-';
+				putDigits(prefix + 5, month, 2);
+				prefix[7] = '-';
+				putDigits(prefix + 8, day, 2);
+				prefix[10] = 'T';
+				putDigits(prefix + 11, static_cast<int>(inDay / 3600), 2);
+				prefix[13] = ':';
+				putDigits(prefix + 14, static_cast<int>(inDay / 60 % 60), 2);
+				prefix[16] = ':';
+				putDigits(prefix + 17, static_cast<int>(inDay % 60), 2);
+			}
+		};
+		thread_local TimestampCache timestampCache;
+
+		void appendLine(std::string& batch, Level lvl, const int64_t wallNanoseconds, std::string_view text) {
+			batch += '[';
+			appendTimestamp(batch, wallNanoseconds);
+			batch.append("] ").append(lvlToStr(lvl)).append(text).append("\n");
+		}
+
+		template<typename T>
+		void put(std::string& out, const T& value) {
+			out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		void putRecord(std::string& out, const binary::Record kind, std::string_view payload) {
+			put(out, kind);
+			put(out, static_cast<uint32_t>(payload.size()));
+			out.append(payload);
+		}
+
+		// Blocks may refer back to the previous ones, so the segment is one LZ4 stream
+		bool compressSegment(const std::string& from, const std::string& to) {
+			std::ifstream in(from, std::ifstream::binary);
+			const std::string raw{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+			std::ofstream out(to, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+			if (!in || !out) {
+				return false;
+			}
+			std::string segment{ segmentMagic, sizeof(segmentMagic) };
+			std::string block(lz4::compressBound(static_cast<int>(segmentBlockSize)), '\0');
+			for (size_t offset = 0; offset < raw.size(); offset += segmentBlockSize) {
+				const size_t rawSize = (std::min)(segmentBlockSize, raw.size() - offset);
+				const int compressedSize = lz4::compress(raw.data(), offset, rawSize, block.data(), static_cast<int>(block.size()), 1);
+				if (compressedSize == 0) {
+					return false;
+				}
+				put(segment, static_cast<uint32_t>(rawSize));
+				put(segment, static_cast<uint32_t>(compressedSize));
+				segment.append(block.data(), compressedSize);
+			}
+			out.write(segment.data(), segment.size());
+			return static_cast<bool>(out);
+		}
+
+		template<typename T>
+		bool take(std::string_view& in, T& value) {
+			if (in.size() < sizeof(T)) {
+				return false;
+			}
+			memcpy(&value, in.data(), sizeof(T));
+			in.remove_prefix(sizeof(T));
+			return true;
+		}
+
+		bool takeText(std::string_view& in, std::string_view& text) {
+			uint32_t size;
+			if (!take(in, size) || in.size() < size) {
+				return false;
+			}
+			text = in.substr(0, size);
+			in.remove_prefix(size);
+			return true;
+		}
+
+		bool renderEvent(std::string_view args, const Format& format, std::string& text) {
+			for (const auto& part : format.parts) {
+				std::string_view textArg;
+				char character;
+				bool boolean;
+				int64_t signedInt;
+				uint64_t unsignedInt;
+				double floating;
+				switch (part.kind) {
+				case binary::Part::literal:
+					text += part.literal;
+					break;
+				case binary::Part::text:
+					if (!takeText(args, textArg)) {
+						return false;
+					}
+					text += textArg;
+					break;
+				case binary::Part::character:
+					if (!take(args, character)) {
+						return false;
+					}
+					text += character;
+					break;
+				case binary::Part::boolean:
+					if (!take(args, boolean)) {
+						return false;
+					}
+					text += boolean ? "1" : "0";
+					break;
+				case binary::Part::signedInt:
+					if (!take(args, signedInt)) {
+						return false;
+					}
+					text += std::to_string(signedInt);
+					break;
+				case binary::Part::unsignedInt:
+					if (!take(args, unsignedInt)) {
+						return false;
+					}
+					text += std::to_string(unsignedInt);
+					break;
+				case binary::Part::floating: {
+					if (!take(args, floating)) {
+						return false;
+					}
+					std::ostringstream stream;
+					stream << floating;
+					text += stream.str();
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+			return args.empty();
+		}
+
+		bool parseFormat(std::string_view payload, uint32_t& id, Format& format) {
+			uint16_t count;
+			if (!take(payload, id) || !take(payload, format.lvl) || !take(payload, count)) {
+				return false;
+			}
+			for (int i = 0; i < count; i++) {
+				FormatPart part;
+				std::string_view literal;
+				if (!take(payload, part.kind)) {
+					return false;
+				}
+				if (part.kind == binary::Part::literal) {
+					if (!takeText(payload, literal)) {
+						return false;
+					}
+					part.literal = literal;
+				}
+				format.parts.push_back(std::move(part));
+			}
+			return payload.empty();
+		}
+	}
+
+	void appendTimestamp(std::string& out, const int64_t wallNanoseconds) {
+		int64_t second = wallNanoseconds / nanosecondsPerSecond;
+		int64_t fraction = wallNanoseconds % nanosecondsPerSecond;
+		if (fraction < 0) {
+			fraction += nanosecondsPerSecond;
+			second--;
+		}
+		if (second != timestampCache.second) {
+			timestampCache.render(second);
+		}
+		char micros[8];
+		micros[0] = '.';
+		putDigits(micros + 1, static_cast<int>(fraction / 1000), 6);
+		micros[7] = 'Z';
+		out.append(timestampCache.prefix, sizeof(timestampCache.prefix)).append(micros, sizeof(micros));
+	}
+
+	bool inflate(std::istream& in, std::string& out) {
+		char magic[sizeof(segmentMagic)];
+		if (!in.read(magic, sizeof(magic)) || memcmp(magic, segmentMagic, sizeof(magic)) != 0) {
+			return false;
+		}
+		uint32_t rawSize;
+		uint32_t compressedSize;
+		std::string block;
+		while (in.read(reinterpret_cast<char*>(&rawSize), sizeof(rawSize))) {
+			if (!in.read(reinterpret_cast<char*>(&compressedSize), sizeof(compressedSize))) {
+				return false;
+			}
+			block.resize(compressedSize);
+			if (!in.read(block.data(), compressedSize) || !lz4::decompress(block, out, rawSize)) {
+				return false;
+			}
+		}
+		return in.eof();
+	}
+
+	uint32_t registerFormat(CallSite& site, Level lvl, std::vector<FormatPart> parts) {
+		std::lock_guard lock{ formatsLock };
+		// Another thread may have registered the same call site in the meantime
+		uint32_t formatId = site.formatId.load(std::memory_order_relaxed);
+		if (formatId != 0) {
+			return formatId;
+		}
+		formats.push_back(Format{ lvl, std::move(parts) });
+		formatId = static_cast<uint32_t>(formats.size());
+		site.formatId.store(formatId, std::memory_order_release);
+		return formatId;
+	}
+
+	bool decode(std::istream& in, std::ostream& out) {
+		char magic[sizeof(binary::magic)];
+		int64_t startWall;
+		int64_t startSteady;
+		in.read(magic, sizeof(magic));
+		in.read(reinterpret_cast<char*>(&startWall), sizeof(startWall));
+		in.read(reinterpret_cast<char*>(&startSteady), sizeof(startSteady));
+		if (!in || memcmp(magic, binary::magic, sizeof(magic)) != 0) {
+			return false;
+		}
+		auto wallTime = [&](const int64_t steady) {
+			return startWall + steady - startSteady;
+		};
+		std::vector<Format> decoded;
+		std::string payload;
+		std::string text;
+		std::string line;
+		binary::Record kind;
+		uint32_t size;
+		while (in.read(reinterpret_cast<char*>(&kind), sizeof(kind))) {
+			if (!in.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+				return false;
+			}
+			payload.resize(size);
+			if (!in.read(payload.data(), size)) {
+				return false;
+			}
+			std::string_view record{ payload };
+			text.clear();
+			line.clear();
+			uint32_t formatId;
+			int64_t timestamp;
+			Level lvl;
+			switch (kind) {
+			case binary::Record::format: {
+				Format format;
+				if (!parseFormat(record, formatId, format) || formatId != decoded.size() + 1) {
+					return false;
+				}
+				decoded.push_back(std::move(format));
+				continue;
+			}
+			case binary::Record::event:
+				if (!take(record, formatId) || !take(record, timestamp) || formatId == 0 || formatId > decoded.size()) {
+					return false;
+				}
+				if (!renderEvent(record, decoded[formatId - 1], text)) {
+					return false;
+				}
+				appendLine(line, decoded[formatId - 1].lvl, wallTime(timestamp), text);
+				break;
+			case binary::Record::line:
+				if (!take(record, lvl) || !take(record, timestamp)) {
+					return false;
+				}
+				appendLine(line, lvl, wallTime(timestamp), record);
+				break;
+			default:
+				return false;
+			}
+			out << line;
+		}
+		return in.eof();
+	}
+
 	std::string lvlToStr(Level lvl) {
 		switch (lvl) {
 		case Level::ERROR:
@@ -19,13 +416,177 @@ namespace logs {
 		return "UNDEFINED";
 	}
 
-	Logger::Logger(std::string logFilePath):
-		file(logFilePath, std::ofstream::out | std::ofstream::trunc) {}
+	Logger::Logger(std::string logFilePath, const Level maxLevel, const Encoding encoding, const Rotation rotation):
+		path(std::move(logFilePath)),
+		rotation(rotation),
+		maxLevel(maxLevel),
+		encoding(encoding),
+		startWall(std::chrono::system_clock::now()),
+		startSteady(std::chrono::steady_clock::now()),
+		writer(&Logger::writeLoop, this) {}
 
 	Logger::~Logger() {
+		{
+			std::lock_guard lock{ wakeLock };
+			stopping = true;
+		}
+		wake.notify_one();
+		writer.join();
 		file.close();
-}
+	}
+
+	void Logger::setLevel(Level lvl) {
+		maxLevel.store(lvl, std::memory_order_relaxed);
+	}
+
+	void Logger::flush() {
+		std::unique_lock lock{ wakeLock };
+		const uint64_t ticket = ++requestedPasses;
+		wake.notify_one();
+		passDone.wait(lock, [&] { return completedPasses >= ticket; });
+	}
+
+	size_t Logger::droppedCount() const {
+		return dropped.load(std::memory_order_relaxed);
+	}
+
+	void Logger::push(const uint32_t formatId, Level lvl, std::string_view payload) {
+		RecordHeader header{ static_cast<uint32_t>(payload.size()), formatId, lvl,
+			nanoseconds(std::chrono::steady_clock::now().time_since_epoch()) };
+		if (!rings.local().push(header, payload)) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void Logger::writeLoop() {
+		std::string batch;
+		openLog();
+		std::unique_lock lock{ wakeLock };
+		while (!stopping) {
+			wake.wait_for(lock, drainInterval, [&] { return stopping || requestedPasses > completedPasses; });
+			const uint64_t ticket = requestedPasses;
+			lock.unlock();
+			writeBatch(batch);
+			lock.lock();
+			completedPasses = ticket;
+			passDone.notify_all();
+		}
+		lock.unlock();
+		writeBatch(batch);
+	}
+
+	void Logger::writeBatch(std::string& batch) {
+		std::string records;
+		auto write = [&](const RecordHeader& header, std::string_view payload) {
+			if (encoding == Encoding::text) {
+				appendLine(records, header.lvl, wallTime(header.timestamp), payload);
+				return;
+			}
+			std::string record;
+			if (header.formatId == 0) {
+				put(record, header.lvl);
+				put(record, header.timestamp);
+				record.append(payload);
+				putRecord(records, binary::Record::line, record);
+			}
+			else {
+				put(record, header.formatId);
+				put(record, header.timestamp);
+				record.append(payload);
+				putRecord(records, binary::Record::event, record);
+			}
+		};
+		rings.forEach([&](Ring& ring) { ring.drain(write); });
+		const size_t droppedNow = droppedCount();
+		if (droppedNow != reportedDropped) {
+			const std::string text = std::to_string(droppedNow - reportedDropped) + " log lines dropped, rings were full";
+			RecordHeader header{ static_cast<uint32_t>(text.size()), 0, Level::ERROR,
+				nanoseconds(std::chrono::steady_clock::now().time_since_epoch()) };
+			write(header, text);
+			reportedDropped = droppedNow;
+		}
+		if (records.empty()) {
+			return;
+		}
+		const bool tooBig = rotation.maxFileSize > 0 && fileSize + records.size() > rotation.maxFileSize;
+		const bool tooOld = rotation.interval.count() > 0 && std::chrono::steady_clock::now() - openedAt >= rotation.interval;
+		if (fileSize > 0 && (tooBig || tooOld)) {
+			rotate();
+		}
+		if (encoding == Encoding::binary) {
+			// Every segment starts with its own header and formats so it can be decoded alone
+			if (fileSize == 0) {
+				batch.append(binary::magic, sizeof(binary::magic));
+				put(batch, nanoseconds(startWall.time_since_epoch()));
+				put(batch, nanoseconds(startSteady.time_since_epoch()));
+				writtenFormats = 0;
+			}
+			// Every drained event was registered before it was logged, so its format is written first
+			appendFormats(batch);
+		}
+		batch += records;
+		file.write(batch.data(), batch.size());
+		file.flush();
+		fileSize += batch.size();
+		batch.clear();
+	}
+
+	void Logger::openLog() {
+		std::error_code error;
+		if (std::filesystem::file_size(path, error) > 0 && !error) {
+			rotate();
+			return;
+		}
+		file.open(path, std::ofstream::out | std::ofstream::trunc | (encoding == Encoding::binary ? std::ofstream::binary : std::ios_base::openmode{}));
+		fileSize = 0;
+		openedAt = std::chrono::steady_clock::now();
+	}
+
+	void Logger::rotate() {
+		file.close();
+		std::error_code error;
+		for (const bool compressed : { false, true }) {
+			std::filesystem::remove(segmentPath(rotation.keptFiles, compressed), error);
+			for (int i = rotation.keptFiles - 1; i > 0; i--) {
+				std::filesystem::rename(segmentPath(i, compressed), segmentPath(i + 1, compressed), error);
+			}
+		}
+		if (rotation.keptFiles > 0 && !(rotation.compress && compressSegment(path, segmentPath(1, true)))) {
+			std::filesystem::rename(path, segmentPath(1, false), error);
+		}
+		std::filesystem::remove(path, error);
+		file.open(path, std::ofstream::out | std::ofstream::trunc | (encoding == Encoding::binary ? std::ofstream::binary : std::ios_base::openmode{}));
+		fileSize = 0;
+		openedAt = std::chrono::steady_clock::now();
+	}
+
+	std::string Logger::segmentPath(const int index, const bool compressed) const {
+		return path + "." + std::to_string(index) + (compressed ? ".lz4" : "");
+	}
+
+	void Logger::appendFormats(std::string& batch) {
+		std::lock_guard lock{ formatsLock };
+		for (; writtenFormats < formats.size(); writtenFormats++) {
+			const Format& format = formats[writtenFormats];
+			std::string record;
+			put(record, static_cast<uint32_t>(writtenFormats + 1));
+			put(record, format.lvl);
+			put(record, static_cast<uint16_t>(format.parts.size()));
+			for (const auto& part : format.parts) {
+				put(record, part.kind);
+				if (part.kind == binary::Part::literal) {
+					put(record, static_cast<uint32_t>(part.literal.size()));
+					record += part.literal;
+				}
+			}
+			putRecord(batch, binary::Record::format, record);
+		}
+	}
+
+	int64_t Logger::wallTime(const int64_t steadyNanoseconds) const {
+		return nanoseconds(startWall.time_since_epoch()) + steadyNanoseconds - nanoseconds(startSteady.time_since_epoch());
+	}
 
 }
 
-#pragma pop_macro("ERROR")
\ No newline at end of file
+#pragma pop_macro("ERROR")
@@ -1,7 +1,22 @@
 #pragma once
 #include <fstream>
 #include <sstream>
-#include <map>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <charconv>
+#include <type_traits>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+
+#include "per_thread.h"
 
 #pragma push_macro("ERROR")
 #undef ERROR
@@ -12,35 +27,333 @@
 #define LOGGER_API __declspec(dllimport)
 #endif
 
+/*
+	Most verbose level compiled in: 0 - ERROR, 1 - INFO, 2 - DEBUG. LOG_INFO and LOG_DEBUG call
+	sites above it are removed together with their arguments, release builds keep up to INFO.
+*/
+#ifndef LOGS_COMPILED_LEVEL
+#ifdef NDEBUG
+#define LOGS_COMPILED_LEVEL 1
+#else
+#define LOGS_COMPILED_LEVEL 2
+#endif
+#endif
+
+// Unlike Logger::log these do not evaluate their arguments when the level is filtered out
+#define LOGS_AT(logger, lvl, ...) do { if ((logger).enabled(lvl)) { static logs::CallSite logsCallSite; (logger).log(logsCallSite, lvl, __VA_ARGS__); } } while (false)
+
+#define LOG_ERROR(logger, ...) LOGS_AT(logger, logs::Level::ERROR, __VA_ARGS__)
+
+#if LOGS_COMPILED_LEVEL >= 1
+#define LOG_INFO(logger, ...) LOGS_AT(logger, logs::Level::INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(logger, ...) do {} while (false)
+#endif
+
+#if LOGS_COMPILED_LEVEL >= 2
+#define LOG_DEBUG(logger, ...) LOGS_AT(logger, logs::Level::DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(logger, ...) do {} while (false)
+#endif
+
 namespace logs {
 	enum class Level { ERROR, INFO, DEBUG};
 
 	std::string LOGGER_API lvlToStr(Level lvl);
 
+	constexpr size_t maxLineSize = 1024;
+	constexpr size_t ringSize = 64 * 1024;
+
+	/*
+		text writes formatted lines. binary writes only raw arguments and a steady clock timestamp,
+		decode() turns such a file into the same text later:
+			header: magic | wall clock ns | steady clock ns, both taken at the start
+			records: kind | uint32 size | payload
+				format: uint32 id | level | uint16 part count | parts (kind, literals with uint32 size)
+				event: uint32 format id | int64 steady ns | arguments in the order of the format
+				line: level | int64 steady ns | already formatted text
+		Numbers are stored in the writing machine's byte order.
+	*/
+	enum class Encoding { text, binary };
+
+	namespace binary {
+		constexpr char magic[8] = { 'T', 'E', 'L', 'O', 'G', 'B', 'I', 'N' };
+		enum class Record : uint8_t { format, event, line };
+		// String literals are kept in the format, the other arguments are stored with every event
+		enum class Part : uint8_t { literal, text, character, boolean, signedInt, unsignedInt, floating };
+
+		template<typename T>
+		constexpr Part partOf() {
+			if constexpr (std::is_array_v<T>) {
+				return Part::literal;
+			}
+			else if constexpr (std::is_same_v<T, char>) {
+				return Part::character;
+			}
+			else if constexpr (std::is_same_v<T, bool>) {
+				return Part::boolean;
+			}
+			else if constexpr (std::is_integral_v<T>) {
+				return std::is_signed_v<T> ? Part::signedInt : Part::unsignedInt;
+			}
+			else if constexpr (std::is_floating_point_v<T>) {
+				return Part::floating;
+			}
+			return Part::text;
+		}
+	}
+
+	/*
+		The log file is moved aside when it would grow past maxFileSize or is older than interval,
+		0 turns either limit off, and when the logger starts over a log left by a previous run.
+		Only keptFiles newest segments are kept - path.1 is the newest one - as path.N.lz4 when
+		compress is set. All of that happens in the background writer.
+	*/
+	struct Rotation {
+		size_t maxFileSize = 16 * 1024 * 1024;
+		std::chrono::seconds interval{ 0 };
+		int keptFiles = 4;
+		bool compress = false;
+	};
+
+	// ISO-8601 UTC with microseconds, e.g. 2024-05-01T12:30:05.123456Z
+	LOGGER_API void appendTimestamp(std::string& out, const int64_t wallNanoseconds);
+
+	// Compressed segment: magic | blocks of uint32 raw size | uint32 compressed size | LZ4 block
+	constexpr char segmentMagic[8] = { 'T', 'E', 'L', 'O', 'G', 'L', 'Z', '4' };
+	// Appends a compressed segment's content to out, false when it is not one or is damaged
+	LOGGER_API bool inflate(std::istream& in, std::string& out);
+
+	struct FormatPart {
+		binary::Part kind;
+		std::string literal;
+	};
+
+	// One LOG_* call site, its format is registered on the first call made in binary encoding
+	struct CallSite {
+		std::atomic<uint32_t> formatId{ 0 };
+	};
+
+	LOGGER_API uint32_t registerFormat(CallSite& site, Level lvl, std::vector<FormatPart> parts);
+	// Writes a binary log as text, false when it is not one or is damaged
+	LOGGER_API bool decode(std::istream& in, std::ostream& out);
+
+	/*
+		One log line formatted on the caller's stack, longer lines are cut at maxLineSize.
+		Strings and numbers are copied directly, anything else goes through operator<<.
+	*/
+	class Line {
+	public:
+		template<typename T>
+		void add(const T& arg) {
+			if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+				append(std::string_view{ arg });
+			}
+			else if constexpr (std::is_same_v<T, char>) {
+				append(std::string_view{ &arg, 1 });
+			}
+			else if constexpr (std::is_same_v<T, bool>) {
+				append(arg ? "1" : "0");
+			}
+			else if constexpr (std::is_integral_v<T>) {
+				auto [end, ec] = std::to_chars(data + size, data + maxLineSize, arg);
+				if (ec == std::errc{}) {
+					size = end - data;
+				}
+			}
+			else {
+				InPlace target{ data + size, data + maxLineSize };
+				std::ostream stream{ &target };
+				stream << arg;
+				size += target.written();
+			}
+		}
+
+		template<typename T>
+		void encode(const T& arg) {
+			constexpr binary::Part part = binary::partOf<T>();
+			if constexpr (part == binary::Part::literal) {
+				return;
+			}
+			else if constexpr (part == binary::Part::text) {
+				if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+					encodeText(std::string_view{ arg });
+				}
+				else if (maxLineSize - size < sizeof(uint32_t)) {
+					cut = true;
+				}
+				else {
+					// Formatted behind the room left for its length
+					InPlace target{ data + size + sizeof(uint32_t), data + maxLineSize };
+					std::ostream stream{ &target };
+					if (!(stream << arg)) {
+						cut = true;
+						return;
+					}
+					put(static_cast<uint32_t>(target.written()));
+					size += target.written();
+				}
+			}
+			else if constexpr (part == binary::Part::signedInt) {
+				put(static_cast<int64_t>(arg));
+			}
+			else if constexpr (part == binary::Part::unsignedInt) {
+				put(static_cast<uint64_t>(arg));
+			}
+			else if constexpr (part == binary::Part::floating) {
+				put(static_cast<double>(arg));
+			}
+			else {
+				put(arg);
+			}
+		}
+
+		void append(std::string_view text) {
+			const size_t count = (std::min)(text.size(), maxLineSize - size);
+			text.copy(data + size, count);
+			size += count;
+		}
+
+		std::string_view view() const {
+			return std::string_view{ data, size };
+		}
+
+		// Encoded arguments did not fit, they cannot be decoded
+		bool overflow() const {
+			return cut;
+		}
+
+	private:
+		// Lets operator<< write straight into the line instead of a heap string, the rest is dropped
+		class InPlace : public std::streambuf {
+		public:
+			InPlace(char* begin, char* end) {
+				setp(begin, end);
+			}
+			size_t written() const {
+				return pptr() - pbase();
+			}
+		};
+
+		template<typename T>
+		void put(const T& value) {
+			if (maxLineSize - size < sizeof(T)) {
+				cut = true;
+				return;
+			}
+			memcpy(data + size, &value, sizeof(T));
+			size += sizeof(T);
+		}
+
+		void encodeText(std::string_view text) {
+			if (maxLineSize - size < sizeof(uint32_t) + text.size()) {
+				cut = true;
+				return;
+			}
+			put(static_cast<uint32_t>(text.size()));
+			append(text);
+		}
+
+		char data[maxLineSize];
+		size_t size = 0;
+		bool cut = false;
+	};
+
+	class Ring;
+
+	/*
+		Asynchronous logger. log() formats the line on the calling thread and copies it into
+		that thread's lock-free ring, it never waits for the file. A background writer drains
+		all rings every drainInterval and writes them in one batch. Lines which do not fit into
+		a full ring are dropped and counted instead of blocking the caller.
+		In binary encoding lines logged through LOG_* macros are not formatted at all.
+	*/
 	class LOGGER_API Logger {
 	public:
-		Logger(std::string logFilePath);
+		Logger(std::string logFilePath, const Level maxLevel = Level::DEBUG, const Encoding encoding = Encoding::text,
+			const Rotation rotation = Rotation{});
+		Logger(const Logger&) = delete;
+		Logger& operator=(const Logger&) = delete;
 		~Logger();
 
 		template<typename... Args>
-		void log(Level lvl, const Args... args) {
-			time_t timestamp;
-			time(&timestamp);
-			std::stringstream stream;
-			char timeBuffer[100];
-			if (ctime_s(timeBuffer, 100, &timestamp)) {
+		void log(Level lvl, const Args&... args) {
+			if (!enabled(lvl)) {
 				return;
 			}
-			stream << "[" << timeBuffer << "] " << lvlToStr(lvl);
-			([&] {
-				stream << args;
-			} (), ...);
-			file << stream.str() << "\n" << std::flush;
+			Line line;
+			(line.add(args), ...);
+			push(0, lvl, line.view());
 		}
 
+		template<typename... Args>
+		void log(CallSite& site, Level lvl, const Args&... args) {
+			if (encoding == Encoding::text) {
+				log(lvl, args...);
+				return;
+			}
+			uint32_t formatId = site.formatId.load(std::memory_order_acquire);
+			if (formatId == 0) {
+				formatId = registerFormat(site, lvl, { describe(args)... });
+			}
+			Line line;
+			(line.encode(args), ...);
+			if (line.overflow()) {
+				log(lvl, args...);
+				return;
+			}
+			push(formatId, lvl, line.view());
+		}
+
+		bool enabled(Level lvl) const {
+			return lvl <= maxLevel.load(std::memory_order_relaxed);
+		}
+		// Lines less severe than lvl are skipped from now on
+		void setLevel(Level lvl);
+
+		// Blocks until every line logged before the call is written to the file
+		void flush();
+		size_t droppedCount() const;
 
 	private:
+		template<typename T>
+		static FormatPart describe(const T& arg) {
+			if constexpr (binary::partOf<T>() == binary::Part::literal) {
+				return FormatPart{ binary::Part::literal, std::string(arg) };
+			}
+			return FormatPart{ binary::partOf<T>(), "" };
+		}
+
+		void push(const uint32_t formatId, Level lvl, std::string_view payload);
+		void writeLoop();
+		void writeBatch(std::string& batch);
+		void appendFormats(std::string& batch);
+		int64_t wallTime(const int64_t steadyNanoseconds) const;
+		void openLog();
+		void rotate();
+		std::string segmentPath(const int index, const bool compressed) const;
+
+		const std::string path;
+		const Rotation rotation;
 		std::ofstream file;
+		size_t fileSize = 0;
+		std::chrono::steady_clock::time_point openedAt;
+		std::atomic<Level> maxLevel;
+		const Encoding encoding;
+		const std::chrono::system_clock::time_point startWall;
+		const std::chrono::steady_clock::time_point startSteady;
+		size_t writtenFormats = 0;
+		threads::PerThread<Ring> rings;
+		std::atomic<size_t> dropped{ 0 };
+		size_t reportedDropped = 0;
+
+		std::mutex wakeLock;
+		std::condition_variable wake;
+		std::condition_variable passDone;
+		uint64_t requestedPasses = 0;
+		uint64_t completedPasses = 0;
+		bool stopping = false;
+		std::thread writer;
 	};
 }
 
@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "messages.h"
+#include <algorithm>
+#include <climits>
 
 namespace msg {
 
@@ -8,31 +10,302 @@ namespace msg {
 		size(0),
 		capacity(capacity) {}
 
+	Buffer::Buffer(std::unique_ptr<char[]> data, const int capacity) :
+		data(std::move(data)),
+		size(0),
+		capacity(capacity) {}
+
 	char* Buffer::get() {
 		return data.get();
 	}
 
+	void Buffer::reserve(const int newCapacity) {
+		if (newCapacity <= capacity) {
+			return;
+		}
+		const int grownCapacity = BufferPool::roundUp((std::max)(newCapacity, 2 * capacity));
+		auto grown = std::unique_ptr<char[]>(new char[grownCapacity]);
+		memcpy(grown.get(), data.get(), size);
+		data = std::move(grown);
+		capacity = grownCapacity;
+	}
+
 	void Buffer::clear() {
-		memset(data.get(), 0, capacity);
 		size = 0;
+		body.reset();
+		docId = 0;
+	}
+
+	std::string_view Buffer::strAt(const int offset) {
+		// Reused buffers keep stale bytes past size, so a missing terminator must not be searched for there
+		if (offset >= size) {
+			return {};
+		}
+		return std::string_view{ data.get() + offset, strnlen(data.get() + offset, size - offset) };
+	}
+
+
+	PooledBuffer::PooledBuffer(std::unique_ptr<char[]> data, const int capacity) :
+		Buffer(std::move(data), capacity) {}
+
+	PooledBuffer::~PooledBuffer() {
+		if (data) {
+			BufferPool::local().release(std::move(data), capacity);
+		}
+	}
+
+
+	BufferPool& BufferPool::local() {
+		thread_local BufferPool pool;
+		return pool;
+	}
+
+	int BufferPool::roundUp(const int capacity) {
+		const int index = classIndex(capacity);
+		return index < 0 ? capacity : sizeClasses[index];
+	}
+
+	PooledBuffer BufferPool::acquire(const int capacity) {
+		const int index = classIndex(capacity);
+		if (index < 0) {
+			return PooledBuffer{ std::unique_ptr<char[]>(new char[capacity]), capacity };
+		}
+		auto& freeList = freeLists[index];
+		if (freeList.empty()) {
+			return PooledBuffer{ std::unique_ptr<char[]>(new char[sizeClasses[index]]), sizeClasses[index] };
+		}
+		auto data = std::move(freeList.back());
+		freeList.pop_back();
+		return PooledBuffer{ std::move(data), sizeClasses[index] };
+	}
+
+	void BufferPool::release(std::unique_ptr<char[]> data, const int capacity) {
+		const int index = classIndex(capacity);
+		if (index < 0 || sizeClasses[index] != capacity || freeLists[index].size() >= maxFreePerClass) {
+			return;
+		}
+		freeLists[index].push_back(std::move(data));
+	}
+
+	size_t BufferPool::freeCount() const {
+		size_t count = 0;
+		for (const auto& freeList : freeLists) {
+			count += freeList.size();
+		}
+		return count;
+	}
+
+	int BufferPool::classIndex(const int capacity) {
+		for (int i = 0; i < sizeClasses.size(); i++) {
+			if (capacity <= sizeClasses[i]) {
+				return i;
+			}
+		}
+		return -1;
 	}
 
 	template<typename T>
-	int parseObj(T& obj, Buffer& buffer, const int offset) {
-		memcpy(&obj, buffer.get() + offset, sizeof(T));
-		return sizeof(T);
+	bool parseView(T& obj, Buffer& buffer, int& pos) {
+		if (pos + static_cast<int>(sizeof(T)) > buffer.size) {
+			return false;
+		}
+		memcpy(&obj, buffer.get() + pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
 	}
-	int parseObj(std::string& obj, Buffer& buffer, const int offset) {
-		obj = std::string{ buffer.get() + offset };
-		return obj.size() + 1;
+	bool parseView(std::string_view& obj, Buffer& buffer, int& pos) {
+		if (pos >= buffer.size) {
+			return false;
+		}
+		const char* begin = buffer.get() + pos;
+		const char* end = static_cast<const char*>(memchr(begin, '\0', buffer.size - pos));
+		if (end == nullptr) {
+			return false;
+		}
+		obj = std::string_view{ begin, static_cast<size_t>(end - begin) };
+		pos += obj.size() + 1;
+		return true;
 	}
 
 	template<typename... Args>
-	int parseMultipleObjs(Buffer& buffer, int pos, Args&... args) {
-		([&] {
-			pos += parseObj(args, buffer, pos);
-			} (), ...);
-		return pos;
+	bool parseMultipleViews(Buffer& buffer, int pos, Args&... args) {
+		return (parseView(args, buffer, pos) && ...);
+	}
+
+	bool parseVarint(uint32_t& value, Buffer& buffer, int& pos) {
+		value = 0;
+		for (int shift = 0; shift < 7 * maxVarintSize; shift += 7) {
+			if (pos >= buffer.size) {
+				return false;
+			}
+			const auto byte = static_cast<unsigned char>(buffer.get()[pos++]);
+			if (shift == 28 && byte > 0x0f) {
+				return false;
+			}
+			value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Fields of Write, Erase, Batch and Chunk in the layout of the msg version, Fixed is the version 1 int
+	template<typename Fixed>
+	bool parseInt(uint32_t& value, Buffer& buffer, int& pos, const int version) {
+		if (version >= compactVersion) {
+			return parseVarint(value, buffer, pos);
+		}
+		Fixed fixed;
+		if (!parseView(fixed, buffer, pos)) {
+			return false;
+		}
+		if constexpr (sizeof(Fixed) == sizeof(u_short)) {
+			value = ntohs(fixed);
+		}
+		else {
+			value = ntohl(fixed);
+		}
+		return true;
+	}
+
+	bool parseText(std::string_view& text, Buffer& buffer, int& pos, const int version) {
+		if (version < compactVersion) {
+			return parseView(text, buffer, pos);
+		}
+		uint32_t length;
+		if (!parseVarint(length, buffer, pos) || length > static_cast<uint32_t>(buffer.size - pos)) {
+			return false;
+		}
+		text = std::string_view{ buffer.get() + pos, length };
+		pos += length;
+		return true;
+	}
+
+	bool parseCursor(COORD& cursorPos, Buffer& buffer, int& pos, const int version) {
+		uint32_t x, y;
+		if (!parseInt<u_short>(x, buffer, pos, version) || !parseInt<u_short>(y, buffer, pos, version)) {
+			return false;
+		}
+		// Positions which do not fit into COORD are rejected instead of wrapped around
+		if (x > SHRT_MAX || y > SHRT_MAX) {
+			return false;
+		}
+		cursorPos = COORD{ static_cast<SHORT>(x), static_cast<SHORT>(y) };
+		return true;
+	}
+
+	// Sizes which do not fit into int are rejected as well, an erase of nothing is no edit
+	bool validEraseSize(const uint32_t eraseSize) {
+		return eraseSize != 0 && eraseSize <= INT_MAX;
+	}
+
+	bool parseRevision(uint32_t& revision, Buffer& buffer, int& pos, const int version) {
+		revision = 0;
+		if (version < resyncVersion) {
+			return true;
+		}
+		// Last field in its shortest form, so the server can stamp it in place
+		const int begin = pos;
+		return parseVarint(revision, buffer, pos) && pos == buffer.size && pos - begin == varintSize(revision);
+	}
+
+	bool parseSentAt(uint32_t& sentAt, Buffer& buffer, int& pos, const int version) {
+		sentAt = 0;
+		return version < timedVersion || parseVarint(sentAt, buffer, pos);
+	}
+
+	template<typename Fixed>
+	void addInt(Buffer& buffer, const uint32_t value, const int version) {
+		if (version >= compactVersion) {
+			buffer.addVarint(value);
+			return;
+		}
+		Fixed fixed;
+		if constexpr (sizeof(Fixed) == sizeof(u_short)) {
+			fixed = htons(static_cast<u_short>(value));
+		}
+		else {
+			fixed = htonl(value);
+		}
+		buffer.add(&fixed);
+	}
+
+	void addText(Buffer& buffer, std::string_view text, const int version) {
+		if (version >= compactVersion) {
+			buffer.addPrefixed(text);
+		}
+		else {
+			buffer.add(text);
+		}
+	}
+
+	void addCursor(Buffer& buffer, const COORD& cursorPos, const int version) {
+		addInt<u_short>(buffer, static_cast<u_short>(cursorPos.X), version);
+		addInt<u_short>(buffer, static_cast<u_short>(cursorPos.Y), version);
+	}
+
+	void addRevision(Buffer& buffer, const uint32_t revision, const int version) {
+		if (version >= resyncVersion) {
+			buffer.addVarint(revision);
+		}
+	}
+
+	void addSentAt(Buffer& buffer, const uint32_t sentAt, const int version) {
+		if (version >= timedVersion) {
+			buffer.addVarint(sentAt);
+		}
+	}
+
+	int sentAtSize(const uint32_t sentAt, const int version) {
+		return version >= timedVersion ? varintSize(sentAt) : 0;
+	}
+
+	template<typename Fixed>
+	int intSize(const uint32_t value, const int version) {
+		return version >= compactVersion ? varintSize(value) : sizeof(Fixed);
+	}
+
+	int textSize(std::string_view text, const int version) {
+		const int length = static_cast<int>(text.size());
+		return version >= compactVersion ? varintSize(length) + length : length + 1;
+	}
+
+	int cursorSize(const COORD& cursorPos, const int version) {
+		return intSize<u_short>(static_cast<u_short>(cursorPos.X), version) + intSize<u_short>(static_cast<u_short>(cursorPos.Y), version);
+	}
+
+	int revisionSize(const uint32_t revision, const int version) {
+		return version >= resyncVersion ? varintSize(revision) : 0;
+	}
+
+	bool parseField(uint32_t& value, Buffer& buffer, int& pos, const int version) {
+		return parseInt<u_long>(value, buffer, pos, version);
+	}
+
+	bool parseField(std::string& value, Buffer& buffer, int& pos, const int version) {
+		std::string_view view;
+		if (!parseView(view, buffer, pos)) {
+			return false;
+		}
+		value = std::string{ view };
+		return true;
+	}
+
+	void addField(Buffer& buffer, const uint32_t value, const int version) {
+		addInt<u_long>(buffer, value, version);
+	}
+
+	void addField(Buffer& buffer, const std::string& value, const int version) {
+		buffer.add(&value);
+	}
+
+	int fieldSize(const uint32_t value, const int version) {
+		return intSize<u_long>(value, version);
+	}
+
+	int fieldSize(const std::string& value, const int version) {
+		return static_cast<int>(value.size()) + 1;
 	}
 
 	Header::Header(MessageType type, const int version, const int errCode) :
@@ -57,158 +330,330 @@ namespace msg {
 	}
 
 
-	Register::Register(const int version, const int errCode, const std::string& username, const std::string& password) :
-		header(MessageType::registration, version, errCode),
-		username(username),
-		password(password),
-		size(header.size + username.size() + password.size() + 2) {}
-
-	Register Register::parse(Buffer& buffer) {
-		Header header = Header::parse(buffer);
-		std::string username, password;
-		parseMultipleObjs(buffer, header.size, username, password);
-		return Register{ header.version, header.errCode, username, password};
-	}
+	Write::Write(const int version, const int errCode, const uint32_t sessionId, const COORD& cursorPos, const std::string& text,
+		const uint32_t revision, const uint32_t sentAt) :
+		header(MessageType::write, version, errCode),
+		sessionId(sessionId),
+		cursorPos(cursorPos),
+		text(text),
+		revision(revision),
+		sentAt(sentAt),
+		size(header.size + intSize<u_long>(sessionId, version) + cursorSize(cursorPos, version) + textSize(text, version) +
+			sentAtSize(sentAt, version) + revisionSize(revision, version)) {}
 
-	void Register::serializeTo(Buffer& buffer) {
+	void Write::serializeTo(Buffer& buffer) {
+		buffer.reserve(buffer.size + size);
 		header.serializeTo(buffer);
-		buffer.add(&username);
-		buffer.add(&password);
+		addInt<u_long>(buffer, sessionId, header.version);
+		addCursor(buffer, cursorPos, header.version);
+		addText(buffer, text, header.version);
+		addSentAt(buffer, sentAt, header.version);
+		addRevision(buffer, revision, header.version);
 	}
 
+	std::pair<Write, bool> Write::parse(Buffer& buffer) {
+		auto [view, valid] = WriteView::parse(buffer);
+		return { Write{ view.header.version, view.header.errCode, view.sessionId, view.cursorPos, std::string{ view.text }, view.revision, view.sentAt }, valid };
+	}
 
-	Login::Login(const int version, const int errCode, const std::string& username, const std::string& password) :
-		header(MessageType::login, version, errCode),
-		username(username),
-		password(password),
-		size(header.size + username.size() + password.size() + 2) {}
 
-	Login Login::parse(Buffer& buffer) {
-		Header header = Header::parse(buffer);
-		std::string username, password;
-		parseMultipleObjs(buffer, header.size, username, password);
-		return Login{ header.version, header.errCode, username, password };
-	}
+	Erase::Erase(const int version, const int errCode, const uint32_t sessionId, const COORD& cursorPos, const int eraseSize,
+		const uint32_t revision, const uint32_t sentAt) :
+		header(MessageType::erase, version, errCode),
+		sessionId(sessionId),
+		cursorPos(cursorPos),
+		eraseSize(eraseSize),
+		revision(revision),
+		sentAt(sentAt),
+		size(header.size + intSize<u_long>(sessionId, version) + cursorSize(cursorPos, version) + intSize<u_long>(eraseSize, version) +
+			sentAtSize(sentAt, version) + revisionSize(revision, version)) {}
 
-	void Login::serializeTo(Buffer& buffer) {
+	void Erase::serializeTo(Buffer& buffer) {
+		buffer.reserve(buffer.size + size);
 		header.serializeTo(buffer);
-		buffer.add(&username);
-		buffer.add(&password);
+		addInt<u_long>(buffer, sessionId, header.version);
+		addCursor(buffer, cursorPos, header.version);
+		addInt<u_long>(buffer, static_cast<uint32_t>(eraseSize), header.version);
+		addSentAt(buffer, sentAt, header.version);
+		addRevision(buffer, revision, header.version);
 	}
 
+	std::pair<Erase, bool> Erase::parse(Buffer& buffer) {
+		auto [view, valid] = EraseView::parse(buffer);
+		return { Erase{ view.header.version, view.header.errCode, view.sessionId, view.cursorPos, view.eraseSize, view.revision, view.sentAt }, valid };
+	}
 
-	Create::Create(const int version, const int errCode, const std::string& token, const std::string& filename) :
-		header(MessageType::create, version, errCode),
-		token(token),
-		filename(filename),
-		size(header.size + token.size() + filename.size() + 2) {}
 
-	Create Create::parse(Buffer& buffer) {
+	WriteView::WriteView(const Header& header, const uint32_t sessionId, const COORD& cursorPos, std::string_view text, const uint32_t revision,
+		const uint32_t sentAt) :
+		header(header),
+		sessionId(sessionId),
+		cursorPos(cursorPos),
+		text(text),
+		revision(revision),
+		sentAt(sentAt) {}
+
+	std::pair<WriteView, bool> WriteView::parse(Buffer& buffer) {
+		const Header invalid{ MessageType::error, 0, 0 };
+		if (buffer.size < invalid.size) {
+			return { WriteView{ invalid, 0, COORD{}, {} }, false };
+		}
 		Header header = Header::parse(buffer);
-		std::string token, filename;
-		parseMultipleObjs(buffer, header.size, token, filename);
-		return Create{ header.version, header.errCode, token, filename };
+		int pos = header.size; uint32_t sessionId, revision, sentAt; COORD cursorPos; std::string_view text;
+		if (!parseInt<u_long>(sessionId, buffer, pos, header.version) || !parseCursor(cursorPos, buffer, pos, header.version) ||
+			!parseText(text, buffer, pos, header.version) || !parseSentAt(sentAt, buffer, pos, header.version) ||
+			!parseRevision(revision, buffer, pos, header.version)) {
+			return { WriteView{ header, 0, COORD{}, {} }, false };
+		}
+		return { WriteView{ header, sessionId, cursorPos, text, revision, sentAt }, true };
 	}
 
-	void Create::serializeTo(Buffer& buffer) {
-		header.serializeTo(buffer);
-		buffer.add(&token);
-		buffer.add(&filename);
+
+	EraseView::EraseView(const Header& header, const uint32_t sessionId, const COORD& cursorPos, const int eraseSize, const uint32_t revision,
+		const uint32_t sentAt) :
+		header(header),
+		sessionId(sessionId),
+		cursorPos(cursorPos),
+		eraseSize(eraseSize),
+		revision(revision),
+		sentAt(sentAt) {}
+
+	std::pair<EraseView, bool> EraseView::parse(Buffer& buffer) {
+		const Header invalid{ MessageType::error, 0, 0 };
+		if (buffer.size < invalid.size) {
+			return { EraseView{ invalid, 0, COORD{}, 0 }, false };
+		}
+		Header header = Header::parse(buffer);
+		int pos = header.size; uint32_t sessionId, eraseSize, revision, sentAt; COORD cursorPos;
+		if (!parseInt<u_long>(sessionId, buffer, pos, header.version) || !parseCursor(cursorPos, buffer, pos, header.version) ||
+			!parseInt<u_long>(eraseSize, buffer, pos, header.version) || !parseSentAt(sentAt, buffer, pos, header.version) ||
+			!parseRevision(revision, buffer, pos, header.version) || !validEraseSize(eraseSize)) {
+			return { EraseView{ header, 0, COORD{}, 0 }, false };
+		}
+		return { EraseView{ header, sessionId, cursorPos, static_cast<int>(eraseSize), revision, sentAt }, true };
 	}
 
 
-	Load::Load(const int version, const int errCode, const std::string& token, const std::string& filename) :
-		header(MessageType::load, version, errCode),
-		token(token),
-		filename(filename),
-		size(header.size + token.size() + filename.size() + 2) {}
+	Chunk::Chunk(const int version, const int errCode, const size_t totalSize, std::string_view text) :
+		Chunk(version, errCode, totalSize, text, text.size()) {}
+
+	Chunk::Chunk(const int version, const int errCode, const size_t totalSize, std::string_view text, const size_t rawSize) :
+		header(MessageType::chunk, version, errCode),
+		totalSize(totalSize),
+		text(text),
+		rawSize(rawSize),
+		size(header.size + intSize<u_long>(static_cast<uint32_t>(totalSize), version) + textSize(text, version)) {
+		assert(version >= compressedVersion || rawSize == text.size());
+		if (version >= compressedVersion) {
+			size += varintSize(static_cast<uint32_t>(rawSize));
+		}
+	}
 
-	Load Load::parse(Buffer& buffer) {
+	std::pair<Chunk, bool> Chunk::parse(Buffer& buffer) {
 		Header header = Header::parse(buffer);
-		std::string token, filename;
-		parseMultipleObjs(buffer, header.size, token, filename);
-		return Load{ header.version, header.errCode, token, filename };
+		int pos = header.size; uint32_t totalSize; std::string_view text;
+		if (!parseInt<u_long>(totalSize, buffer, pos, header.version)) {
+			return { Chunk{ header.version, 1, 0, "" }, false };
+		}
+		uint32_t rawSize = 0;
+		if (header.version >= compressedVersion && !parseVarint(rawSize, buffer, pos)) {
+			return { Chunk{ header.version, 1, 0, "" }, false };
+		}
+		if (!parseText(text, buffer, pos, header.version)) {
+			return { Chunk{ header.version, 1, 0, "" }, false };
+		}
+		if (header.version < compressedVersion) {
+			rawSize = static_cast<uint32_t>(text.size());
+		}
+		return { Chunk{ header.version, header.errCode, totalSize, text, rawSize }, true };
 	}
 
-	void Load::serializeTo(Buffer& buffer) {
+	void Chunk::serializeTo(Buffer& buffer) const {
+		buffer.reserve(buffer.size + size);
 		header.serializeTo(buffer);
-		buffer.add(&token);
-		buffer.add(&filename);
+		addInt<u_long>(buffer, static_cast<uint32_t>(totalSize), header.version);
+		if (header.version >= compressedVersion) {
+			buffer.addVarint(static_cast<uint32_t>(rawSize));
+		}
+		addText(buffer, text, header.version);
+	}
+
+	bool Chunk::compressed() const {
+		return rawSize != text.size();
 	}
 
 
-	Join::Join(const int version, const int errCode, const std::string& token, const std::string& accessCode) :
-		header(MessageType::join, version, errCode),
-		token(token),
-		accessCode(accessCode),
-		size(header.size + token.size() + accessCode.size() + 2) {}
+	int batchOpSize(const BatchOp& op, const int version) {
+		const int payloadSize = op.type == MessageType::write ?
+			textSize(op.text, version) :
+			intSize<u_long>(static_cast<uint32_t>(op.eraseSize), version);
+		return sizeof(OneByteInt) + cursorSize(op.cursorPos, version) + payloadSize;
+	}
 
-	Join Join::parse(Buffer& buffer) {
+	Batch::Batch(const int version, const int errCode, const uint32_t sessionId, std::pmr::vector<BatchOp> ops, const uint32_t revision) :
+		header(MessageType::batch, version, errCode),
+		sessionId(sessionId),
+		ops(std::move(ops)),
+		revision(revision),
+		size(header.size + intSize<u_long>(sessionId, version) + intSize<u_short>(static_cast<uint32_t>(this->ops.size()), version) +
+			revisionSize(revision, version)) {
+		for (const auto& op : this->ops) {
+			size += batchOpSize(op, version);
+		}
+	}
+
+	std::pair<Batch, bool> Batch::parse(Buffer& buffer, std::pmr::memory_resource* resource) {
+		const Header invalid{ MessageType::error, 0, 0 };
+		if (buffer.size < invalid.size) {
+			return { Batch{ invalid.version, 1, 0, {} }, false };
+		}
 		Header header = Header::parse(buffer);
-		std::string token, accessCode;
-		parseMultipleObjs(buffer, header.size, token, accessCode);
-		return Join{ header.version, header.errCode, token, accessCode };
+		const int version = header.version;
+		uint32_t sessionId, count;
+		int pos = header.size;
+		if (!parseInt<u_long>(sessionId, buffer, pos, version) || !parseInt<u_short>(count, buffer, pos, version) ||
+			count > static_cast<uint32_t>(buffer.size - pos)) {
+			return { Batch{ version, 1, 0, {} }, false };
+		}
+		std::pmr::vector<BatchOp> ops{ resource };
+		ops.reserve(count);
+		for (uint32_t i = 0; i < count; i++) {
+			OneByteInt typeBuf; COORD cursorPos;
+			if (!parseView(typeBuf, buffer, pos) || !parseCursor(cursorPos, buffer, pos, version)) {
+				return { Batch{ version, 1, 0, {} }, false };
+			}
+			BatchOp op{ static_cast<MessageType>(typeBuf), cursorPos, {}, 0 };
+			if (op.type == MessageType::write) {
+				if (!parseText(op.text, buffer, pos, version)) {
+					return { Batch{ version, 1, 0, {} }, false };
+				}
+			}
+			else if (op.type == MessageType::erase) {
+				uint32_t eraseSize;
+				if (!parseInt<u_long>(eraseSize, buffer, pos, version) || !validEraseSize(eraseSize)) {
+					return { Batch{ version, 1, 0, {} }, false };
+				}
+				op.eraseSize = static_cast<int>(eraseSize);
+			}
+			else {
+				return { Batch{ version, 1, 0, {} }, false };
+			}
+			ops.push_back(op);
+		}
+		uint32_t revision;
+		if (!parseRevision(revision, buffer, pos, version)) {
+			return { Batch{ version, 1, 0, {} }, false };
+		}
+		return { Batch{ version, header.errCode, sessionId, std::move(ops), revision }, true };
 	}
 
-	void Join::serializeTo(Buffer& buffer) {
+	void Batch::serializeTo(Buffer& buffer) const {
+		buffer.reserve(buffer.size + size);
 		header.serializeTo(buffer);
-		buffer.add(&token);
-		buffer.add(&accessCode);
+		addInt<u_long>(buffer, sessionId, header.version);
+		addInt<u_short>(buffer, static_cast<uint32_t>(ops.size()), header.version);
+		for (const auto& op : ops) {
+			OneByteInt typeByte = static_cast<OneByteInt>(op.type);
+			buffer.add(&typeByte);
+			addCursor(buffer, op.cursorPos, header.version);
+			if (op.type == MessageType::write) {
+				addText(buffer, op.text, header.version);
+			}
+			else {
+				addInt<u_long>(buffer, static_cast<uint32_t>(op.eraseSize), header.version);
+			}
+		}
+		addRevision(buffer, revision, header.version);
 	}
 
 
-	Write::Write(const int version, const int errCode, const std::string& token, const COORD& cursorPos, const std::string& text) :
-		header(MessageType::write, version, errCode),
-		token(token),
-		cursorPos(cursorPos),
-		text(text),
-		size(header.size + 2 * sizeof(u_short) + token.size() + text.size() + 2) {}
+	void stampRevision(Buffer& message, const uint32_t oldRevision, const uint32_t revision) {
+		if (message.size < Header{ MessageType::error, 0, 0 }.size || Header::parse(message).version < resyncVersion) {
+			return;
+		}
+		message.size -= varintSize(oldRevision);
+		message.addVarint(revision);
+	}
 
-	void Write::serializeTo(Buffer& buffer) {
+
+	ResyncReply::ResyncReply(const int version, const int errCode, const uint32_t revision, const bool snapshot, std::string_view payload) :
+		header(MessageType::resync, version, errCode),
+		revision(revision),
+		snapshot(snapshot),
+		payload(payload),
+		size(header.size + varintSize(revision) + sizeof(OneByteInt) + varintSize(static_cast<uint32_t>(payload.size())) + static_cast<int>(payload.size())) {}
+
+	std::pair<ResyncReply, bool> ResyncReply::parse(Buffer& buffer) {
+		Header header = Header::parse(buffer);
+		int pos = header.size; uint32_t revision; OneByteInt snapshot; std::string_view payload;
+		if (!parseVarint(revision, buffer, pos) || !parseView(snapshot, buffer, pos) || !parseText(payload, buffer, pos, compactVersion)) {
+			return { ResyncReply{ header.version, 1, 0, true, "" }, false };
+		}
+		return { ResyncReply{ header.version, header.errCode, revision, snapshot != 0, payload }, true };
+	}
+
+	void ResyncReply::serializeTo(Buffer& buffer) const {
+		buffer.reserve(buffer.size + size);
 		header.serializeTo(buffer);
-		u_short cursorX = htons(cursorPos.X);
-		u_short cursorY = htons(cursorPos.Y);
-		buffer.add(&token);
-		buffer.add(&cursorX);
-		buffer.add(&cursorY);
-		buffer.add(&text);
+		buffer.addVarint(revision);
+		OneByteInt snapshotByte = snapshot ? 1 : 0;
+		buffer.add(&snapshotByte);
+		buffer.addPrefixed(payload);
 	}
 
-	Write Write::parse(Buffer& buffer) {
-		Header header = Header::parse(buffer);
-		std::string token, text; u_short cursorX, cursorY;
-		parseMultipleObjs(buffer, header.size, token, cursorX, cursorY, text);
-		SHORT cursorPosX = static_cast<SHORT>(ntohs(cursorX));
-		SHORT cursorPosY = static_cast<SHORT>(ntohs(cursorY));
-		return Write{ header.version, header.errCode, token, COORD{cursorPosX, cursorPosY}, text };
+
+	void serializeFrame(Buffer& frame, Buffer& message) {
+		frame.clear();
+		frame.reserve(frameHeaderSize + message.size);
+		u_long frameSize = htonl(static_cast<u_long>(message.size));
+		frame.add(&frameSize);
+		memcpy(frame.get() + frame.size, message.get(), message.size);
+		frame.size += message.size;
 	}
 
 
-	Erase::Erase(const int version, const int errCode, const std::string& token, const COORD& cursorPos, const int eraseSize) :
-		header(MessageType::erase, version, errCode),
-		token(token),
-		cursorPos(cursorPos),
-		eraseSize(eraseSize),
-		size(header.size + 2 * sizeof(u_short) + sizeof(u_long) + token.size() + 1) {}
+	FrameReader::FrameReader() :
+		pending(BufferPool::sizeClasses[2]) {}
+
+	void FrameReader::append(const char* bytes, const int count) {
+		if (begin == pending.size) {
+			begin = 0;
+			pending.size = 0;
+		}
+		else if (begin > 0 && pending.size + count > pending.capacity) {
+			memmove(pending.get(), pending.get() + begin, pending.size - begin);
+			pending.size -= begin;
+			begin = 0;
+		}
+		pending.reserve(pending.size + count);
+		memcpy(pending.get() + pending.size, bytes, count);
+		pending.size += count;
+	}
 
-	void Erase::serializeTo(Buffer& buffer) {
-		header.serializeTo(buffer);
-		u_short cursorX = htons(cursorPos.X);
-		u_short cursorY = htons(cursorPos.Y);
-		u_long eraseSizeByte = htonl(eraseSize);
-		buffer.add(&token);
-		buffer.add(&cursorX);
-		buffer.add(&cursorY);
-		buffer.add(&eraseSizeByte);
+	bool FrameReader::next(Buffer& frame) {
+		const int available = pending.size - begin;
+		if (invalid || available < frameHeaderSize) {
+			return false;
+		}
+		u_long frameSizeNet;
+		memcpy(&frameSizeNet, pending.get() + begin, frameHeaderSize);
+		const u_long frameSize = ntohl(frameSizeNet);
+		if (frameSize > maxFrameSize) {
+			invalid = true;
+			return false;
+		}
+		if (available < frameHeaderSize + static_cast<int>(frameSize)) {
+			return false;
+		}
+		frame.clear();
+		frame.reserve(frameSize);
+		memcpy(frame.get(), pending.get() + begin + frameHeaderSize, frameSize);
+		frame.size = frameSize;
+		begin += frameHeaderSize + frameSize;
+		return true;
 	}
 
-	Erase Erase::parse(Buffer& buffer) {
-		Header header = Header::parse(buffer);
-		std::string token; u_short cursorX, cursorY; u_long eraseSizeBuf;
-		parseMultipleObjs(buffer, header.size, token, cursorX, cursorY, eraseSizeBuf);
-		SHORT cursorPosX = static_cast<SHORT>(ntohs(cursorX));
-		SHORT cursorPosY = static_cast<SHORT>(ntohs(cursorY));
-		int eraseSize = static_cast<int>(ntohl(eraseSizeBuf));
-		return Erase{ header.version, header.errCode, token, COORD{cursorPosX, cursorPosY}, eraseSize };
-	}
-}
\ No newline at end of file
+	bool FrameReader::corrupted() const {
+		return invalid;
+	}
+}
@@ -1,8 +1,14 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <assert.h>
 #include <memory>
+#include <memory_resource>
 #include <array>
+#include <vector>
+#include <tuple>
+#include <cstdint>
+#include <chrono>
 
 #include <winsock2.h>
 #include "windows.h"
@@ -21,36 +27,148 @@ namespace msg {
 
 	using OneByteInt = unsigned char;
 	/*
-		Write: Header CursorPos letters (for writing to doc) -> returns same Write msg
-		Erase: Header CursorPos eraseSize (for erasing from doc) -> returns same Erase msg
-		Login: Header nickname (for login into system -> returning userId) -> returns same login msg
+		Write: Header sessionId CursorPos letters (for writing to doc) -> returns same Write msg
+		Erase: Header sessionId CursorPos eraseSize (for erasing from doc) -> returns same Erase msg
+		Login: Header nickname (for login into system) -> returns Header userId sessionId
 		Create: Header filename (for creating new doc) -> returns Header docId
-		Load: Header filename (for loading existing doc) -> returns Header docId
-		Join: Header docId (for joining to specific session) -> returns Header documentData
+		Load: Header filename (for loading existing doc) -> returns Header documentData accessCode revision
+		Join: Header docId (for joining to specific session) -> returns the same fields as Load
+		Undo: Header token (for reverting last own edit) -> broadcasts inverse Write/Erase msg
+		Redo: Header token (for reapplying last undone edit) -> broadcasts Write/Erase msg
+		Chunk: Header totalSize letters (server only, part of a document body too big for one msg,
+		       all chunks are sent right before the Load/Join response whose text is then empty)
+		Batch: Header sessionId count {Write or Erase type, CursorPos, letters or eraseSize}... (edits
+		       applied one after another as a unit) -> broadcasts Batch msg of the applied edits
+		Resync: Header token accessCode revision (for rejoining a doc after reconnect) -> returns
+		        ResyncReply with the edits made after revision or with the whole document
+		Stats: Header prefix (for reading server metrics whose names start with prefix) -> returns
+		       Header text with one "name value" line per metric
+		Spans: Header token (logged in user asking the server to dump its trace spans to a file)
+		       -> returns Header text telling where they were written
+
+		On the wire every msg is preceded by its size (4 bytes, network order), see FrameReader.
+
+		Layout of Write, Erase, Batch and Chunk depends on Header::version. Version 1 has fixed size
+		network order ints and NUL-terminated letters. compactVersion and above encode ints as LEB128
+		varints and prefix letters with their varint length. Positions are kept in COORD in every
+		version, so coordinates above SHRT_MAX are rejected when parsed - varints do not lift the
+		document size limit. Responses use the version of the request.
+		From compressedVersion a Chunk also carries rawSize and its letters may be LZ4 compressed.
+		From resyncVersion Write, Erase and Batch end with the document revision the edit made,
+		stamped by the server (clients send 0).
+		From timedVersion Write and Erase carry sentAt right before the revision - opTimestamp of
+		the author's keystroke, 0 when not measured. The server echoes it untouched, so the author
+		can tell how long its edit took to come back.
 	*/
-	enum class MessageType { registration, login, create, load, join, write, erase, error };
+	enum class MessageType { registration, login, create, load, join, write, erase, error, undo, redo, chunk, batch, resync, stats, spans };
+
+	constexpr int frameHeaderSize = sizeof(u_long);
+	constexpr int maxFrameSize = 1024 * 1024;
+	constexpr int chunkSize = 16 * 1024;
+	constexpr int compactVersion = 2;
+	constexpr int compressedVersion = 3;
+	constexpr int resyncVersion = 4;
+	constexpr int timedVersion = 5;
+	constexpr int maxVarintSize = 5;
+
+	// Microseconds of the steady clock cut to 32 bits, differences of two stay right for over an hour
+	inline uint32_t opTimestamp(const std::chrono::steady_clock::time_point time) {
+		return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count());
+	}
+
+	constexpr int varintSize(uint32_t value) {
+		int size = 1;
+		while (value >= 0x80) {
+			value >>= 7;
+			size++;
+		}
+		return size;
+	}
 
 	class MESSAGE_API Buffer {
 	public:
 		Buffer(const int capacity);
+		Buffer(Buffer&&) = default;
 
 		template<typename T>
-		void add(T* val) {
-			assert(capacity >= size + sizeof(T) && "Error, buffer size excedeed!");
+		void add(const T* val) {
+			reserve(size + sizeof(T));
 			memcpy(data.get() + size, val, sizeof(T));
 			size += sizeof(T);
 		}
-		void add(std::string* str) {
-			assert(capacity >= size + str->size() + 1 && "Error, buffer size excedeed!");
-			memcpy(data.get() + size, str->c_str(), str->size() + 1);
-			size += str->size() + 1;
+		void add(const std::string* str) {
+			add(std::string_view{ *str });
 		}
+		void add(std::string_view str) {
+			reserve(size + str.size() + 1);
+			memcpy(data.get() + size, str.data(), str.size());
+			data[size + str.size()] = '\0';
+			size += str.size() + 1;
+		}
+		// LEB128 - 7 bits per byte starting from the lowest ones, high bit set on all but the last byte
+		void addVarint(uint32_t value) {
+			reserve(size + maxVarintSize);
+			while (value >= 0x80) {
+				data[size++] = static_cast<char>(value | 0x80);
+				value >>= 7;
+			}
+			data[size++] = static_cast<char>(value);
+		}
+		void addPrefixed(std::string_view str) {
+			addVarint(static_cast<uint32_t>(str.size()));
+			reserve(size + static_cast<int>(str.size()));
+			memcpy(data.get() + size, str.data(), str.size());
+			size += static_cast<int>(str.size());
+		}
+		void reserve(const int newCapacity);
 		void clear();
 		char* get();
+		std::string_view strAt(const int offset);
 
 		std::unique_ptr<char[]> data;
 		int size;
-		const int capacity;
+		int capacity;
+		// Document streamed after this msg as Chunk msgs, set only for bodies bigger than chunkSize
+		std::shared_ptr<const std::string> body;
+		// Document an edit msg changed, 0 for other msgs. The server sends edits only to connections on it
+		uint32_t docId = 0;
+
+	protected:
+		Buffer(std::unique_ptr<char[]> data, const int capacity);
+	};
+
+	/*
+		Buffer taken from the pool of the current thread, its memory goes back to the pool
+		of the thread destroying it. Capacity is rounded up to the size class.
+	*/
+	class MESSAGE_API PooledBuffer : public Buffer {
+	public:
+		PooledBuffer(std::unique_ptr<char[]> data, const int capacity);
+		PooledBuffer(PooledBuffer&&) = default;
+		~PooledBuffer();
+	};
+
+	/*
+		Per thread free lists of buffer memory in a few size classes, so receiving and sending
+		messages does not touch the heap once the pool is warm. Requests above the largest
+		class are allocated exactly and freed on release.
+	*/
+	class MESSAGE_API BufferPool {
+	public:
+		static constexpr std::array<int, 4> sizeClasses{ 128, 1024, 4096, 65536 };
+		static constexpr size_t maxFreePerClass = 32;
+
+		static BufferPool& local();
+		static int roundUp(const int capacity);
+		PooledBuffer acquire(const int capacity);
+		void release(std::unique_ptr<char[]> data, const int capacity);
+		size_t freeCount() const;
+
+	private:
+		BufferPool() = default;
+		static int classIndex(const int capacity);
+
+		std::array<std::vector<std::unique_ptr<char[]>>, sizeClasses.size()> freeLists;
 	};
 
 	class MESSAGE_API Header {
@@ -64,97 +182,345 @@ namespace msg {
 		const int size = 3 * sizeof(OneByteInt);
 	};
 
-	class MESSAGE_API Register {
+	template<typename T>
+	int parseObj(T& obj, Buffer& buffer, const int offset) {
+		memcpy(&obj, buffer.get() + offset, sizeof(T));
+		return sizeof(T);
+	}
+
+	template<typename... Args>
+	int parseMultipleObjs(Buffer& buffer, int pos, Args&... args) {
+		([&] {
+			pos += parseObj(args, buffer, pos);
+			} (), ...);
+		return pos;
+	}
+
+	/*
+		Fields of a Message. Ints are laid out like the ints of Write in the msg version, strings
+		are NUL-terminated in every version. Parsing never reads past buffer.size.
+	*/
+	MESSAGE_API bool parseField(uint32_t& value, Buffer& buffer, int& pos, const int version);
+	MESSAGE_API bool parseField(std::string& value, Buffer& buffer, int& pos, const int version);
+	MESSAGE_API void addField(Buffer& buffer, const uint32_t value, const int version);
+	MESSAGE_API void addField(Buffer& buffer, const std::string& value, const int version);
+	MESSAGE_API int fieldSize(const uint32_t value, const int version);
+	MESSAGE_API int fieldSize(const std::string& value, const int version);
+
+	template<typename T>
+	struct FieldOf;
+	template<typename Owner, typename T>
+	struct FieldOf<T Owner::*> {
+		using type = T;
+	};
+
+	/*
+		Schema of a msg made of a Header followed by plain fields. Derived lists its fields once:
+			static constexpr auto fields = std::make_tuple(&Derived::first, &Derived::second);
+		and has a constructor (version, errCode, first, second). parse, serializeTo and size are
+		generated from that list, so adding a msg means declaring its fields.
+	*/
+	template<typename Derived, MessageType Type>
+	class Message {
 	public:
-		Register(const int version, const int errCode, const std::string& username, const std::string& password);
-		static Register parse(Buffer& buffer);
-		void serializeTo(Buffer& buffer);
+		Message(const int version, const int errCode) :
+			header(Type, version, errCode) {}
+
+		// Second member of the result is false for truncated or malformed messages
+		static std::pair<Derived, bool> parse(Buffer& buffer) {
+			Header header = Header::parse(buffer);
+			auto values = std::apply([](auto... field) {
+				return std::tuple<typename FieldOf<decltype(field)>::type...>{};
+			}, Derived::fields);
+			int pos = header.size;
+			const bool valid = std::apply([&](auto&... value) {
+				return (parseField(value, buffer, pos, header.version) && ...);
+			}, values);
+			return { std::apply([&](auto&... value) {
+				return Derived{ header.version, header.errCode, std::move(value)... };
+			}, values), valid };
+		}
+
+		void serializeTo(Buffer& buffer) const {
+			buffer.reserve(buffer.size + size());
+			header.serializeTo(buffer);
+			std::apply([&](auto... field) { (addField(buffer, self().*field, header.version), ...); }, Derived::fields);
+		}
+
+		int size() const {
+			return header.size + std::apply([&](auto... field) {
+				return (0 + ... + fieldSize(self().*field, header.version));
+			}, Derived::fields);
+		}
 
 		Header header;
+
+	private:
+		const Derived& self() const {
+			return static_cast<const Derived&>(*this);
+		}
+	};
+
+	class Register : public Message<Register, MessageType::registration> {
+	public:
+		Register(const int version, const int errCode, std::string username, std::string password) :
+			Message(version, errCode), username(std::move(username)), password(std::move(password)) {}
+
 		std::string username;
 		std::string password;
-		int size;
+		static constexpr auto fields = std::make_tuple(&Register::username, &Register::password);
 	};
 
-	class MESSAGE_API Login {
+	class Login : public Message<Login, MessageType::login> {
 	public:
-		Login(const int version, const int errCode, const std::string& username, const std::string& password);
-		static Login parse(Buffer& buffer);
-		void serializeTo(Buffer& buffer);
+		Login(const int version, const int errCode, std::string username, std::string password) :
+			Message(version, errCode), username(std::move(username)), password(std::move(password)) {}
 
-		Header header;
 		std::string username;
 		std::string password;
-		int size;
+		static constexpr auto fields = std::make_tuple(&Login::username, &Login::password);
 	};
 
-	class MESSAGE_API Create {
+	class Create : public Message<Create, MessageType::create> {
 	public:
-		Create(const int version, const int errCode, const std::string& token, const std::string& filename);
-		static Create parse(Buffer& buffer);
-		void serializeTo(Buffer& buffer);
+		Create(const int version, const int errCode, std::string token, std::string filename) :
+			Message(version, errCode), token(std::move(token)), filename(std::move(filename)) {}
 
-		Header header;
 		std::string token;
 		std::string filename;
-		int size;
+		static constexpr auto fields = std::make_tuple(&Create::token, &Create::filename);
 	};
 
-	class MESSAGE_API Load {
+	class Load : public Message<Load, MessageType::load> {
 	public:
-		Load(const int version, const int errCode, const std::string& token, const std::string& filename);
-		static Load parse(Buffer& buffer);
-		void serializeTo(Buffer& buffer);
+		Load(const int version, const int errCode, std::string token, std::string filename) :
+			Message(version, errCode), token(std::move(token)), filename(std::move(filename)) {}
 
-		Header header;
 		std::string token;
 		std::string filename;
-		int size;
+		static constexpr auto fields = std::make_tuple(&Load::token, &Load::filename);
 	};
 
-	class MESSAGE_API Join {
+	class Join : public Message<Join, MessageType::join> {
 	public:
-		Join(const int version, const int errCode, const std::string& token, const std::string& accessCode);
-		static Join parse(Buffer& buffer);
-		void serializeTo(Buffer& buffer);
+		Join(const int version, const int errCode, std::string token, std::string accessCode) :
+			Message(version, errCode), token(std::move(token)), accessCode(std::move(accessCode)) {}
 
-		Header header;
 		std::string token;
 		std::string accessCode;
-		int size;
+		static constexpr auto fields = std::make_tuple(&Join::token, &Join::accessCode);
 	};
 
 	class MESSAGE_API Write {
 	public:
-		Write(const int version, const int errCode, const std::string& token, const COORD& cursorPos, const std::string& text);
-		static Write parse(Buffer& buffer);
+		Write(const int version, const int errCode, const uint32_t sessionId, const COORD& cursorPos, const std::string& text,
+			const uint32_t revision = 0, const uint32_t sentAt = 0);
+		// Second member of the result is false for truncated or malformed messages
+		static std::pair<Write, bool> parse(Buffer& buffer);
 		void serializeTo(Buffer& buffer);
 
 		Header header;
-		std::string token;
+		uint32_t sessionId;
 		COORD cursorPos;
 		std::string text;
+		uint32_t revision;
+		uint32_t sentAt;
 		int size;
 	};
 
 	class MESSAGE_API Erase {
 	public:
-		Erase(const int version, const int errCode, const std::string& token, const COORD& cursorPos, const int eraseSize);
-		static Erase parse(Buffer& buffer);
+		Erase(const int version, const int errCode, const uint32_t sessionId, const COORD& cursorPos, const int eraseSize,
+			const uint32_t revision = 0, const uint32_t sentAt = 0);
+		// Second member of the result is false for truncated or malformed messages
+		static std::pair<Erase, bool> parse(Buffer& buffer);
 		void serializeTo(Buffer& buffer);
 
 		Header header;
+		uint32_t sessionId;
+		COORD cursorPos;
+		int eraseSize;
+		uint32_t revision;
+		uint32_t sentAt;
+		int size;
+	};
+
+	class Undo : public Message<Undo, MessageType::undo> {
+	public:
+		Undo(const int version, const int errCode, std::string token) :
+			Message(version, errCode), token(std::move(token)) {}
+
 		std::string token;
+		static constexpr auto fields = std::make_tuple(&Undo::token);
+	};
+
+	class Redo : public Message<Redo, MessageType::redo> {
+	public:
+		Redo(const int version, const int errCode, std::string token) :
+			Message(version, errCode), token(std::move(token)) {}
+
+		std::string token;
+		static constexpr auto fields = std::make_tuple(&Redo::token);
+	};
+
+	/*
+		Non-owning counterparts of Write and Erase for the server hot path. Text points directly
+		into the parsed buffer, so a view is valid only until the buffer is cleared or reused.
+		Parsing never reads past buffer.size - second member of the result is false for truncated
+		or malformed messages.
+	*/
+	class MESSAGE_API WriteView {
+	public:
+		WriteView(const Header& header, const uint32_t sessionId, const COORD& cursorPos, std::string_view text, const uint32_t revision = 0,
+			const uint32_t sentAt = 0);
+		static std::pair<WriteView, bool> parse(Buffer& buffer);
+
+		Header header;
+		uint32_t sessionId;
+		COORD cursorPos;
+		std::string_view text;
+		uint32_t revision;
+		uint32_t sentAt;
+	};
+
+	class MESSAGE_API EraseView {
+	public:
+		EraseView(const Header& header, const uint32_t sessionId, const COORD& cursorPos, const int eraseSize, const uint32_t revision = 0,
+			const uint32_t sentAt = 0);
+		static std::pair<EraseView, bool> parse(Buffer& buffer);
+
+		Header header;
+		uint32_t sessionId;
 		COORD cursorPos;
 		int eraseSize;
+		uint32_t revision;
+		uint32_t sentAt;
+	};
+
+	/*
+		Part of a document body, text points into the parsed buffer. When rawSize differs from
+		text.size(), text is an LZ4 block (see compression.h) which may refer to the previous
+		parts of the same body.
+	*/
+	class MESSAGE_API Chunk {
+	public:
+		Chunk(const int version, const int errCode, const size_t totalSize, std::string_view text);
+		Chunk(const int version, const int errCode, const size_t totalSize, std::string_view text, const size_t rawSize);
+		static std::pair<Chunk, bool> parse(Buffer& buffer);
+		void serializeTo(Buffer& buffer) const;
+		bool compressed() const;
+
+		Header header;
+		size_t totalSize;
+		std::string_view text;
+		size_t rawSize;
+		int size;
+	};
+
+	/*
+		Single edit of a Batch, type is MessageType::write or MessageType::erase.
+		text is not owned - it points into the parsed buffer or into strings of the sender.
+	*/
+	struct MESSAGE_API BatchOp {
+		MessageType type;
+		COORD cursorPos;
+		std::string_view text;
+		int eraseSize;
+	};
+
+	class MESSAGE_API Batch {
+	public:
+		Batch(const int version, const int errCode, const uint32_t sessionId, std::pmr::vector<BatchOp> ops, const uint32_t revision = 0);
+		// ops are allocated from resource, the server passes its per request scratch arena
+		static std::pair<Batch, bool> parse(Buffer& buffer, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+		void serializeTo(Buffer& buffer) const;
+
+		Header header;
+		uint32_t sessionId;
+		std::pmr::vector<BatchOp> ops;
+		uint32_t revision;
 		int size;
 	};
 
+	/*
+		Replaces the revision at the end of a parsed Write, Erase or Batch, msgs older than
+		resyncVersion are left as they are
+	*/
+	MESSAGE_API void stampRevision(Buffer& message, const uint32_t oldRevision, const uint32_t revision);
+
+	class Resync : public Message<Resync, MessageType::resync> {
+	public:
+		Resync(const int version, const int errCode, std::string token, std::string accessCode, const uint32_t revision) :
+			Message(version, errCode), token(std::move(token)), accessCode(std::move(accessCode)), revision(revision) {}
+
+		std::string token;
+		std::string accessCode;
+		uint32_t revision;
+		static constexpr auto fields = std::make_tuple(&Resync::token, &Resync::accessCode, &Resync::revision);
+	};
+
+	class Stats : public Message<Stats, MessageType::stats> {
+	public:
+		Stats(const int version, const int errCode, std::string prefix) :
+			Message(version, errCode), prefix(std::move(prefix)) {}
+
+		std::string prefix;
+		static constexpr auto fields = std::make_tuple(&Stats::prefix);
+	};
+
+	// Asks the server to dump its trace spans, see spans.h
+	class Spans : public Message<Spans, MessageType::spans> {
+	public:
+		Spans(const int version, const int errCode, std::string token) :
+			Message(version, errCode), token(std::move(token)) {}
+
+		std::string token;
+		static constexpr auto fields = std::make_tuple(&Spans::token);
+	};
+
+	/*
+		Answer to Resync: Header revision snapshot payload
+		payload holds either the framed Write/Erase/Batch msgs made after the revision of the
+		request, or (snapshot) the whole document text, which may come as a body like in Join.
+		It is not owned and points into the parsed buffer.
+	*/
+	class MESSAGE_API ResyncReply {
+	public:
+		ResyncReply(const int version, const int errCode, const uint32_t revision, const bool snapshot, std::string_view payload);
+		static std::pair<ResyncReply, bool> parse(Buffer& buffer);
+		void serializeTo(Buffer& buffer) const;
+
+		Header header;
+		uint32_t revision;
+		bool snapshot;
+		std::string_view payload;
+		int size;
+	};
+
+	MESSAGE_API void serializeFrame(Buffer& frame, Buffer& message);
+
+	/*
+		TCP does not keep msg boundaries - one recv may return a part of a msg or a few of them.
+		Received bytes are accumulated here and cut back into msgs using their size prefixes.
+	*/
+	class MESSAGE_API FrameReader {
+	public:
+		FrameReader();
+		void append(const char* bytes, const int count);
+		bool next(Buffer& frame);
+		bool corrupted() const;
+
+	private:
+		Buffer pending;
+		int begin = 0;
+		bool invalid = false;
+	};
+
 	template<size_t N>
 	int parseStrArray(Buffer& buffer, int offset, std::array<std::string, N>& arr) {
 		int size = 0;
 		for (auto& str : arr) {
-			str = std::string{ buffer.get() + offset };
+			str = std::string{ buffer.strAt(offset) };
 			size += str.size() + 1;
 			offset += str.size() + 1;
 		}
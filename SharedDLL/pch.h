@@ -12,5 +12,7 @@
 #include "document.h"
 #include "logger.h"
 #include "messages.h"
+#include "crdt_document.h"
+#include "compression.h"
 
 #endif //PCH_H
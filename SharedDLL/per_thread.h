@@ -0,0 +1,64 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace threads {
+	/*
+		One Slot for every thread using the owner, like the log ring or the metrics shard of a
+		thread. Slot is constructed from the id of its thread and has it as owner. Each thread
+		remembers the slot it used last, so only its first call per owner takes the lock. Owners are
+		told apart by id there, as the address of a destroyed one gets reused.
+	*/
+	template<typename Slot>
+	class PerThread {
+	public:
+		PerThread() :
+			id(nextId()++) {}
+
+		Slot& local() {
+			thread_local Cache cache;
+			if (cache.ownerId == id) {
+				return *cache.slot;
+			}
+			const auto thisThread = std::this_thread::get_id();
+			std::scoped_lock lock{ slotsLock };
+			auto it = std::find_if(slots.begin(), slots.end(), [&](const auto& slot) { return slot->owner == thisThread; });
+			if (it == slots.end()) {
+				// A finished thread's id may be given to a new one, which then takes over its slot
+				slots.push_back(std::make_unique<Slot>(thisThread));
+				it = slots.end() - 1;
+			}
+			cache = Cache{ id, it->get() };
+			return **it;
+		}
+
+		// Visits the slots of all threads, which may be writing to them meanwhile
+		template<typename Visitor>
+		void forEach(Visitor visit) const {
+			std::scoped_lock lock{ slotsLock };
+			for (const auto& slot : slots) {
+				visit(*slot);
+			}
+		}
+
+	private:
+		struct Cache {
+			uint64_t ownerId = 0;
+			Slot* slot = nullptr;
+		};
+
+		static std::atomic<uint64_t>& nextId() {
+			static std::atomic<uint64_t> next{ 1 };
+			return next;
+		}
+
+		const uint64_t id;
+		mutable std::mutex slotsLock;
+		std::vector<std::unique_ptr<Slot>> slots;
+	};
+}
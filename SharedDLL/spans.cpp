@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "spans.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+
+namespace spans {
+
+	namespace {
+		const auto epoch = std::chrono::steady_clock::now();
+
+		// Rings outlive their threads, spans of finished workers stay in the dump
+		std::mutex ringsLock;
+		std::vector<std::shared_ptr<Ring>> rings;
+
+		Ring& local() {
+			thread_local std::shared_ptr<Ring> ring = []() {
+				auto ring = std::make_shared<Ring>();
+				std::scoped_lock lock{ringsLock};
+				ring->threadId = static_cast<uint32_t>(rings.size() + 1);
+				rings.push_back(ring);
+				return ring;
+			}();
+			return *ring;
+		}
+
+		uint64_t sinceEpoch(const std::chrono::steady_clock::time_point time) {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch).count();
+		}
+
+		void writeMicroseconds(std::ostream& out, const uint64_t ns) {
+			out << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000;
+		}
+	}
+
+	void record(const char* name, const std::chrono::steady_clock::time_point start, const std::chrono::steady_clock::time_point end) {
+		Ring& ring = local();
+		const uint64_t written = ring.written.load(std::memory_order_relaxed);
+		Slot& slot = ring.slots[written % ringCapacity];
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.startNs.store(sinceEpoch(start), std::memory_order_relaxed);
+		slot.durationNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), std::memory_order_relaxed);
+		ring.written.store(written + 1, std::memory_order_release);
+	}
+
+	size_t dump(std::ostream& out) {
+		std::vector<std::shared_ptr<Ring>> snapshot;
+		{
+			std::scoped_lock lock{ringsLock};
+			snapshot = rings;
+		}
+		struct Copied {
+			const char* name;
+			uint64_t startNs;
+			uint64_t durationNs;
+		};
+		std::vector<Copied> copied;
+		size_t count = 0;
+		out << "{\"traceEvents\":[";
+		for (const auto& ring : snapshot) {
+			const uint64_t before = ring->written.load(std::memory_order_acquire);
+			const uint64_t first = before > ringCapacity ? before - ringCapacity : 0;
+			copied.clear();
+			for (uint64_t i = first; i < before; i++) {
+				const Slot& slot = ring->slots[i % ringCapacity];
+				copied.push_back({ slot.name.load(std::memory_order_relaxed), slot.startNs.load(std::memory_order_relaxed),
+					slot.durationNs.load(std::memory_order_relaxed) });
+			}
+			// The thread went on meanwhile, its newest spans replaced the oldest copied ones - and
+			// the slot of the span it records right now may be half written
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t after = ring->written.load(std::memory_order_acquire) + 1;
+			const uint64_t overwritten = after > first + ringCapacity ? (std::min)(after - first - ringCapacity, before - first) : 0;
+			for (size_t i = static_cast<size_t>(overwritten); i < copied.size(); i++) {
+				out << (count++ == 0 ? "" : ",") << "\n{\"name\":\"" << copied[i].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->threadId << ",\"ts\":";
+				writeMicroseconds(out, copied[i].startNs);
+				out << ",\"dur\":";
+				writeMicroseconds(out, copied[i].durationNs);
+				out << "}";
+			}
+		}
+		out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+		return count;
+	}
+
+	Scope::Scope(const char* name) :
+		name(name),
+		start(std::chrono::steady_clock::now()) {}
+
+	Scope::~Scope() {
+		end();
+	}
+
+	void Scope::end() {
+		if (open) {
+			open = false;
+			record(name, start, std::chrono::steady_clock::now());
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+#ifdef SHAREDDLL_EXPORTS
+#define SPANS_API __declspec(dllexport)
+#else
+#define SPANS_API __declspec(dllimport)
+#endif
+
+/*
+	Scoped spans of the hot paths: 1 compiles them in, 0 (the default) removes SPAN call sites
+	entirely. Build every project with the same value.
+*/
+#ifndef SPANS_ENABLED
+#define SPANS_ENABLED 0
+#endif
+
+#define SPANS_CONCAT_IMPL(first, second) first##second
+#define SPANS_CONCAT(first, second) SPANS_CONCAT_IMPL(first, second)
+
+#if SPANS_ENABLED
+// Span from here to the end of the enclosing scope, name must be a string literal
+#define SPAN(name) spans::Scope SPANS_CONCAT(spansScope, __LINE__){ name }
+// Named span ended early by SPAN_END, e.g. around the wait for a lock only
+#define SPAN_BEGIN(span, name) spans::Scope span{ name }
+#define SPAN_END(span) span.end()
+#else
+#define SPAN(name) do {} while (false)
+#define SPAN_BEGIN(span, name) do {} while (false)
+#define SPAN_END(span) do {} while (false)
+#endif
+
+namespace spans {
+	constexpr bool compiledIn = SPANS_ENABLED != 0;
+	// Spans kept per thread, the oldest ones are overwritten
+	constexpr size_t ringCapacity = 16 * 1024;
+
+	struct Slot {
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> startNs{ 0 };
+		std::atomic<uint64_t> durationNs{ 0 };
+	};
+
+	// Written only by its thread, dump reads it meanwhile and drops slots overwritten during the copy
+	struct SPANS_API Ring {
+		uint32_t threadId = 0;
+		std::atomic<uint64_t> written{ 0 };
+		std::array<Slot, ringCapacity> slots;
+	};
+
+	SPANS_API void record(const char* name, const std::chrono::steady_clock::time_point start, const std::chrono::steady_clock::time_point end);
+	// Chrome trace event format, loads in chrome://tracing and ui.perfetto.dev. Returns the number of spans.
+	SPANS_API size_t dump(std::ostream& out);
+
+	class SPANS_API Scope {
+	public:
+		explicit Scope(const char* name);
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+		~Scope();
+		void end();
+
+	private:
+		const char* name;
+		std::chrono::steady_clock::time_point start;
+		bool open = true;
+	};
+}
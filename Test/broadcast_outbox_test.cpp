@@ -0,0 +1,81 @@
+#include "pch.h"
+#include <thread>
+
+#include "broadcast_outbox.h"
+
+TEST(BroadcastOutboxTests, MsgsOfOneTickLeaveAsOneCompoundFrameTest) {
+	BroadcastOutbox outbox{ std::chrono::microseconds{ 0 } };
+	msg::Buffer message{ 128 };
+	msg::Write{ 1, 0, 1, COORD{ 1, 2 }, "a" }.serializeTo(message);
+	message.docId = 1;
+	outbox.add(message);
+	message.clear();
+	msg::Erase{ 1, 0, 2, COORD{ 3, 4 }, 5 }.serializeTo(message);
+	message.docId = 1;
+	outbox.add(message);
+
+	BroadcastOutbox::Frames frames;
+	ASSERT_TRUE(outbox.take(frames));
+	EXPECT_TRUE(outbox.empty());
+	EXPECT_FALSE(outbox.take(frames));
+	ASSERT_EQ(frames.size(), 1);
+
+	msg::FrameReader reader;
+	reader.append(frames.at(1).get(), frames.at(1).size);
+	ASSERT_TRUE(reader.next(message));
+	EXPECT_EQ(msg::Write::parse(message).first.sessionId, 1);
+	ASSERT_TRUE(reader.next(message));
+	EXPECT_EQ(msg::Erase::parse(message).first.sessionId, 2);
+	EXPECT_FALSE(reader.next(message));
+}
+
+TEST(BroadcastOutboxTests, MsgsOfTwoDocsLeaveInSeparateFramesTest) {
+	BroadcastOutbox outbox{ std::chrono::microseconds{ 0 } };
+	msg::Buffer message{ 128 };
+	msg::Write{ 1, 0, 1, COORD{ 1, 2 }, "first doc" }.serializeTo(message);
+	message.docId = 1;
+	outbox.add(message);
+	message.clear();
+	msg::Write{ 1, 0, 2, COORD{ 1, 2 }, "second doc" }.serializeTo(message);
+	message.docId = 2;
+	outbox.add(message);
+
+	BroadcastOutbox::Frames frames;
+	ASSERT_TRUE(outbox.take(frames));
+	EXPECT_EQ(outbox.pendingBytes(), 0);
+	for (const uint32_t docId : { 1u, 2u }) {
+		msg::FrameReader reader;
+		reader.append(frames.at(docId).get(), frames.at(docId).size);
+		ASSERT_TRUE(reader.next(message));
+		EXPECT_EQ(msg::Write::parse(message).first.sessionId, docId);
+		EXPECT_FALSE(reader.next(message));
+	}
+
+	// Taken buffers go back to the outbox empty, the next but one tick collects into them
+	message.docId = 2;
+	for (int tick = 0; tick < 2; tick++) {
+		outbox.add(message);
+		ASSERT_TRUE(outbox.take(frames));
+	}
+	EXPECT_EQ(frames.at(1).size, 0);
+	EXPECT_EQ(frames.at(2).size, msg::frameHeaderSize + message.size);
+}
+
+TEST(BroadcastOutboxTests, MsgsAreHeldBackForWindowUnlessForcedTest) {
+	BroadcastOutbox outbox{ std::chrono::milliseconds{ 20 } };
+	msg::Buffer message{ 128 };
+	msg::Undo{ 1, 0, "token" }.serializeTo(message);
+	outbox.add(message);
+
+	BroadcastOutbox::Frames frames;
+	EXPECT_FALSE(outbox.take(frames));
+	EXPECT_GT(outbox.untilDue().count(), 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 25 });
+	EXPECT_EQ(outbox.untilDue().count(), 0);
+	EXPECT_TRUE(outbox.take(frames));
+	EXPECT_EQ(frames.at(0).size, msg::frameHeaderSize + message.size);
+
+	outbox.add(message);
+	EXPECT_TRUE(outbox.take(frames, true));
+	EXPECT_EQ(outbox.untilDue(), std::chrono::microseconds::max());
+}
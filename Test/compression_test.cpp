@@ -0,0 +1,111 @@
+#include "pch.h"
+#include <string>
+#include <random>
+
+#include "compression.h"
+#include "messages.h"
+
+std::string compressPart(const std::string& data, const size_t offset, const size_t size, const int acceleration = 1) {
+	std::string out(lz4::compressBound(static_cast<int>(size)), '\0');
+	const int compressedSize = lz4::compress(data.data(), offset, size, out.data(), static_cast<int>(out.size()), acceleration);
+	out.resize(compressedSize);
+	return out;
+}
+
+TEST(CompressionTests, RepetitiveTextRoundTripTest) {
+	std::string text;
+	for (int i = 0; i < 500; i++) {
+		text += "line " + std::to_string(i % 7) + " of a document which repeats itself\n";
+	}
+	for (int acceleration : { 1, 8 }) {
+		const std::string compressed = compressPart(text, 0, text.size(), acceleration);
+		EXPECT_GT(compressed.size(), 0);
+		EXPECT_LT(compressed.size(), text.size() / 5);
+
+		std::string out;
+		ASSERT_TRUE(lz4::decompress(compressed, out, text.size()));
+		EXPECT_EQ(out, text);
+	}
+}
+
+TEST(CompressionTests, LaterPartsReferToEarlierOnesTest) {
+	std::mt19937 random{ 7 };
+	std::string part(4000, '\0');
+	for (auto& letter : part) {
+		letter = static_cast<char>('a' + random() % 26);
+	}
+	// Second part repeats the first one, alone it does not compress at all
+	const std::string text = part + part;
+	const std::string first = compressPart(text, 0, part.size());
+	const std::string second = compressPart(text, part.size(), part.size());
+	EXPECT_LT(second.size(), 100);
+
+	std::string out;
+	ASSERT_TRUE(lz4::decompress(first, out, part.size()));
+	ASSERT_TRUE(lz4::decompress(second, out, part.size()));
+	EXPECT_EQ(out, text);
+}
+
+TEST(CompressionTests, RepeatsBeyondWindowAreNotReferredToTest) {
+	std::mt19937 random{ 11 };
+	std::string pattern(64, '\0');
+	for (auto& letter : pattern) {
+		letter = static_cast<char>('a' + random() % 26);
+	}
+	// The second copy is more than windowSize bytes after the first one
+	std::string text(200 * 1024, '\0');
+	text.replace(70000, pattern.size(), pattern);
+	text.replace(140000, pattern.size(), pattern);
+	for (const size_t partSize : { static_cast<size_t>(msg::chunkSize), text.size() }) {
+		std::string out;
+		for (size_t offset = 0; offset < text.size(); offset += partSize) {
+			const size_t size = (std::min)(partSize, text.size() - offset);
+			ASSERT_TRUE(lz4::decompress(compressPart(text, offset, size), out, size));
+		}
+		EXPECT_EQ(out, text);
+	}
+}
+
+TEST(CompressionTests, ShortAndEmptyInputsTest) {
+	for (const std::string text : { std::string{}, std::string{ "abc" }, std::string(12, 'x'), std::string(13, 'x') }) {
+		const std::string compressed = compressPart(text, 0, text.size());
+		std::string out;
+		ASSERT_TRUE(lz4::decompress(compressed, out, text.size()));
+		EXPECT_EQ(out, text);
+	}
+}
+
+TEST(CompressionTests, MalformedInputIsRejectedTest) {
+	const std::string text(1000, 'x');
+	const std::string compressed = compressPart(text, 0, text.size());
+	std::string out = "kept";
+	EXPECT_FALSE(lz4::decompress(compressed.substr(0, compressed.size() - 1), out, text.size()));
+	EXPECT_EQ(out, "kept");
+	EXPECT_FALSE(lz4::decompress(compressed, out, text.size() - 1));
+	// Match reaching before the beginning of the output
+	const std::string badOffset{ "\x00\xff\x00", 3 };
+	EXPECT_FALSE(lz4::decompress(badOffset, out, 4));
+	EXPECT_EQ(out, "kept");
+}
+
+TEST(CompressionTests, CompressedChunkSerializeAndParseTest) {
+	const std::string text(3000, 'y');
+	const std::string compressed = compressPart(text, 0, text.size());
+	msg::Buffer buffer{ 128 };
+	msg::Chunk msg{ msg::compressedVersion, 0, 9000, compressed, text.size() };
+	msg.serializeTo(buffer);
+	EXPECT_EQ(buffer.size, msg.size);
+
+	auto [parsed, valid] = msg::Chunk::parse(buffer);
+	ASSERT_TRUE(valid);
+	EXPECT_TRUE(parsed.compressed());
+	EXPECT_EQ(parsed.totalSize, 9000);
+	EXPECT_EQ(parsed.rawSize, text.size());
+	std::string out;
+	ASSERT_TRUE(lz4::decompress(parsed.text, out, parsed.rawSize));
+	EXPECT_EQ(out, text);
+
+	buffer.clear();
+	msg::Chunk{ msg::compactVersion, 0, 9000, text }.serializeTo(buffer);
+	EXPECT_FALSE(msg::Chunk::parse(buffer).first.compressed());
+}
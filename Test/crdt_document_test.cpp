@@ -0,0 +1,142 @@
+#include "pch.h"
+#include <string>
+#include <vector>
+
+#include "crdt_document.h"
+
+TEST(CrdtDocumentTests, LocalInsertAndEraseTest) {
+	crdt::CrdtDocument doc{ 1 };
+	doc.insert(0, "Hello world");
+	doc.insert(5, ",");
+	EXPECT_EQ(doc.getText(), "Hello, world");
+
+	doc.erase(5, 7);
+	EXPECT_EQ(doc.getText(), "Hello");
+	EXPECT_EQ(doc.size(), 5);
+}
+
+TEST(CrdtDocumentTests, TypingIsRunLengthEncodedTest) {
+	crdt::CrdtDocument doc{ 1 };
+	const std::string text = "consecutive letters typed by one agent";
+	for (int i = 0; i < text.size(); i++) {
+		doc.insert(i, std::string{ text[i] });
+	}
+	EXPECT_EQ(doc.getText(), text);
+	EXPECT_EQ(doc.runCount(), 1);
+}
+
+TEST(CrdtDocumentTests, ConcurrentInsertsConvergeTest) {
+	crdt::CrdtDocument first{ 1 };
+	crdt::CrdtDocument second{ 2 };
+	first.setText("ab");
+	second.setText("ab");
+
+	auto firstOp = first.insert(1, "XX");
+	auto secondOp = second.insert(1, "YY");
+	first.apply(secondOp);
+	second.apply(firstOp);
+	EXPECT_EQ(first.getText(), second.getText());
+	EXPECT_EQ(first.size(), 6);
+}
+
+TEST(CrdtDocumentTests, OutOfOrderOpsArePendingUntilOriginArrivesTest) {
+	crdt::CrdtDocument author{ 1 };
+	crdt::CrdtDocument replica{ 2 };
+	auto firstOp = author.insert(0, "abc");
+	auto secondOp = author.insert(3, "def");
+	auto eraseOps = author.erase(1, 4);
+
+	for (const auto& op : eraseOps) {
+		EXPECT_FALSE(replica.apply(op));
+	}
+	EXPECT_FALSE(replica.apply(secondOp));
+	EXPECT_EQ(replica.getText(), "");
+	EXPECT_TRUE(replica.apply(firstOp));
+	EXPECT_EQ(replica.pendingCount(), 0);
+	EXPECT_EQ(replica.getText(), author.getText());
+	EXPECT_EQ(replica.getText(), "af");
+}
+
+TEST(CrdtDocumentTests, DuplicatedOpsAreIgnoredTest) {
+	crdt::CrdtDocument author{ 1 };
+	crdt::CrdtDocument replica{ 2 };
+	auto insertOp = author.insert(0, "abc");
+	auto eraseOps = author.erase(0, 1);
+	replica.apply(insertOp);
+	replica.apply(insertOp);
+	replica.apply(eraseOps[0]);
+	replica.apply(eraseOps[0]);
+	EXPECT_EQ(replica.getText(), "bc");
+}
+
+TEST(CrdtDocumentTests, GarbageCollectionDropsStableTombstonesTest) {
+	crdt::CrdtDocument doc{ 1 };
+	doc.insert(0, "some text to erase");
+	doc.erase(4, 14);
+	EXPECT_EQ(doc.runCount(), 2);
+
+	EXPECT_EQ(doc.collectGarbage({}), 0);
+	EXPECT_EQ(doc.collectGarbage({ { 1, doc.getClock() } }), 1);
+	EXPECT_EQ(doc.runCount(), 1);
+	EXPECT_EQ(doc.getText(), "some");
+
+	doc.insert(4, " more");
+	EXPECT_EQ(doc.getText(), "some more");
+}
+
+TEST(CrdtDocumentTests, InsertConcurrentWithEraseSurvivesGarbageCollectionTest) {
+	crdt::CrdtDocument first{ 1 };
+	crdt::CrdtDocument second{ 2 };
+	auto typed = first.insert(0, "abc");
+	second.apply(typed);
+	const uint32_t typedClock = typed.id.clock + static_cast<uint32_t>(typed.text.size()) - 1;
+
+	// second inserts after 'b' before the erase of 'b' reaches it
+	auto concurrent = second.insert(2, "X");
+	auto erased = first.erase(1, 1);
+	ASSERT_EQ(erased.size(), 1);
+	EXPECT_EQ(first.collectGarbage({ { 1, typedClock } }), 0);
+
+	EXPECT_TRUE(first.apply(concurrent));
+	EXPECT_TRUE(second.apply(erased[0]));
+	EXPECT_EQ(first.getText(), "aXc");
+	EXPECT_EQ(second.getText(), "aXc");
+
+	// Both replicas reported the erase and the insert, the tombstone is not needed anymore
+	const crdt::VersionVector stable{ { 1, erased[0].id.clock }, { 2, concurrent.id.clock } };
+	EXPECT_EQ(first.collectGarbage(stable), 1);
+	EXPECT_EQ(second.collectGarbage(stable), 1);
+	auto later = second.insert(1, "Y");
+	EXPECT_TRUE(first.apply(later));
+	EXPECT_TRUE(first.apply(concurrent));
+	EXPECT_EQ(first.pendingCount(), 0);
+	EXPECT_EQ(first.getText(), second.getText());
+	EXPECT_EQ(first.getText(), "aYXc");
+}
+
+TEST(CrdtDocumentTests, ManyReplicasConvergeTest) {
+	std::vector<crdt::CrdtDocument> replicas;
+	for (uint32_t agent = 1; agent <= 3; agent++) {
+		replicas.emplace_back(agent);
+	}
+	std::vector<crdt::Op> ops;
+	ops.push_back(replicas[0].insert(0, "shared "));
+	for (auto& replica : replicas) {
+		replica.apply(ops[0]);
+	}
+	ops.push_back(replicas[0].insert(7, "one"));
+	ops.push_back(replicas[1].insert(7, "two"));
+	ops.push_back(replicas[2].insert(0, "three "));
+	for (const auto& op : replicas[1].erase(0, 2)) {
+		ops.push_back(op);
+	}
+
+	for (auto& replica : replicas) {
+		for (auto it = ops.rbegin(); it != ops.rend(); it++) {
+			replica.apply(*it);
+		}
+	}
+	EXPECT_EQ(replicas[0].getText(), replicas[1].getText());
+	EXPECT_EQ(replicas[1].getText(), replicas[2].getText());
+	EXPECT_EQ(replicas[0].pendingCount(), 0);
+}
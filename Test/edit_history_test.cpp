@@ -0,0 +1,69 @@
+#include "pch.h"
+#include <string>
+
+#include "edit_history.h"
+
+constexpr uint16_t firstUser = 0;
+constexpr uint16_t secondUser = 1;
+constexpr COORD startPos{ 3, 1 };
+constexpr COORD endPos{ 8, 1 };
+
+TEST(EditHistoryTests, UndoAndRedoAreStackedPerUserTest) {
+	EditHistory history{ 1024 };
+	history.record(firstUser, EditKind::write, startPos, endPos, "first");
+	history.record(secondUser, EditKind::erase, startPos, endPos, "other");
+	history.record(firstUser, EditKind::write, endPos, endPos, "second");
+
+	auto [undone, undoSuccess] = history.undo(firstUser);
+	EXPECT_TRUE(undoSuccess);
+	EXPECT_EQ(undone.text, "second");
+	auto [undoneNext, undoNextSuccess] = history.undo(firstUser);
+	EXPECT_TRUE(undoNextSuccess);
+	EXPECT_EQ(undoneNext.text, "first");
+	EXPECT_EQ(undoneNext.pos.X, startPos.X);
+	EXPECT_EQ(undoneNext.endPos.X, endPos.X);
+	EXPECT_FALSE(history.undo(firstUser).second);
+
+	auto [redone, redoSuccess] = history.redo(firstUser);
+	EXPECT_TRUE(redoSuccess);
+	EXPECT_EQ(redone.text, "first");
+
+	auto [otherUndone, otherSuccess] = history.undo(secondUser);
+	EXPECT_TRUE(otherSuccess);
+	EXPECT_EQ(otherUndone.kind, EditKind::erase);
+	EXPECT_EQ(otherUndone.text, "other");
+}
+
+TEST(EditHistoryTests, NewEditDiscardsRedoTest) {
+	EditHistory history{ 1024 };
+	history.record(firstUser, EditKind::write, startPos, endPos, "first");
+	history.undo(firstUser);
+	history.record(firstUser, EditKind::write, startPos, endPos, "second");
+	EXPECT_FALSE(history.redo(firstUser).second);
+	EXPECT_EQ(history.undo(firstUser).first.text, "second");
+	EXPECT_FALSE(history.undo(firstUser).second);
+}
+
+TEST(EditHistoryTests, OldestEditsAreEvictedWhenBudgetIsExceededTest) {
+	constexpr size_t budget = 256;
+	EditHistory history{ budget };
+	for (int i = 0; i < 100; i++) {
+		history.record(firstUser, EditKind::write, startPos, endPos, "edit" + std::to_string(i));
+		EXPECT_LE(history.usedBytes(), budget);
+	}
+	EXPECT_LT(history.recordCount(), 100);
+	EXPECT_EQ(history.undo(firstUser).first.text, "edit99");
+
+	int undoCount = 1;
+	while (history.undo(firstUser).second) {
+		undoCount++;
+	}
+	EXPECT_EQ(undoCount, history.recordCount());
+}
+
+TEST(EditHistoryTests, EditBiggerThanBudgetIsNotRecordedTest) {
+	EditHistory history{ 64 };
+	history.record(firstUser, EditKind::write, startPos, endPos, "small");
+	history.record(firstUser, EditKind::write, startPos, endPos, std::string(128, 'x'));
+	EXPECT_FALSE(history.undo(firstUser).second);
+}
@@ -0,0 +1,84 @@
+#include "pch.h"
+#include <string>
+
+#include "histogram.h"
+
+TEST(HistogramTests, BucketsKeepRelativePrecisionTest) {
+	for (uint64_t value = 0; value < 2 * metrics::subBuckets; value++) {
+		EXPECT_EQ(metrics::bucketUpperBound(metrics::bucketOf(value)), value);
+	}
+	for (uint64_t value : { uint64_t{ 64 }, uint64_t{ 1000 }, uint64_t{ 123456789 }, uint64_t{ 1 } << 40, UINT64_MAX / 3 }) {
+		const size_t bucket = metrics::bucketOf(value);
+		const uint64_t upper = metrics::bucketUpperBound(bucket);
+		EXPECT_GE(upper, value);
+		EXPECT_LE(upper - value, value / metrics::subBuckets);
+		EXPECT_LT(metrics::bucketUpperBound(bucket - 1), value);
+	}
+	EXPECT_EQ(metrics::bucketOf(UINT64_MAX), metrics::bucketCount - 1);
+	EXPECT_EQ(metrics::bucketUpperBound(metrics::bucketCount - 1), UINT64_MAX);
+}
+
+TEST(HistogramTests, QuantilesTest) {
+	metrics::Histogram histogram;
+	for (uint64_t value = 1; value <= 1000; value++) {
+		histogram.record(value * 1000);
+	}
+	metrics::HistogramSnapshot snapshot;
+	histogram.addTo(snapshot);
+	EXPECT_EQ(snapshot.count, 1000);
+	EXPECT_EQ(snapshot.max, 1000000);
+	EXPECT_NEAR(static_cast<double>(snapshot.quantile(0.5)), 500000, 500000 / metrics::subBuckets);
+	EXPECT_NEAR(static_cast<double>(snapshot.quantile(0.99)), 990000, 990000 / metrics::subBuckets);
+	EXPECT_NEAR(static_cast<double>(snapshot.quantile(0.999)), 999000, 999000 / metrics::subBuckets);
+	EXPECT_EQ(snapshot.quantile(1), 1000000);
+	EXPECT_EQ(metrics::HistogramSnapshot{}.quantile(0.5), 0);
+}
+
+TEST(HistogramTests, SinceKeepsOnlyNewValuesTest) {
+	metrics::Histogram histogram;
+	histogram.record(5000);
+	metrics::HistogramSnapshot earlier;
+	histogram.addTo(earlier);
+	histogram.record(10);
+	histogram.record(20);
+	metrics::HistogramSnapshot later;
+	histogram.addTo(later);
+
+	auto interval = later.since(earlier);
+	EXPECT_EQ(interval.count, 2);
+	EXPECT_EQ(interval.sum, 30);
+	EXPECT_EQ(interval.max, 20);
+	EXPECT_EQ(interval.quantile(0.5), 10);
+}
+
+TEST(HistogramTests, MergesSnapshotsTest) {
+	metrics::Histogram first;
+	metrics::Histogram second;
+	first.record(3);
+	second.record(1000);
+	metrics::HistogramSnapshot merged;
+	first.addTo(merged);
+	metrics::HistogramSnapshot other;
+	second.addTo(other);
+
+	merged.add(other);
+	EXPECT_EQ(merged.count, 2);
+	EXPECT_EQ(merged.sum, 1003);
+	EXPECT_EQ(merged.max, 1000);
+	EXPECT_EQ(merged.quantile(0), 3);
+}
+
+TEST(HistogramTests, AppendsPrefixedLinesTest) {
+	metrics::Histogram histogram;
+	histogram.record(7);
+	metrics::HistogramSnapshot snapshot;
+	histogram.addTo(snapshot);
+
+	std::string out;
+	metrics::appendHistogram(out, "rtt_m", "rtt", snapshot);
+	EXPECT_EQ(out, "rtt_max 7\n");
+	out.clear();
+	metrics::appendHistogram(out, "", "rtt", snapshot);
+	EXPECT_NE(out.find("rtt{quantile=\"0.999\"} 7\n"), std::string::npos);
+	EXPECT_NE(out.find("rtt_count 1\n"), std::string::npos);
+}
@@ -0,0 +1,312 @@
+#include "pch.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <regex>
+
+#include "logger.h"
+
+#pragma push_macro("ERROR")
+#undef ERROR
+
+std::vector<std::string> readLines(const std::string& path) {
+	std::ifstream file(path);
+	std::vector<std::string> lines;
+	std::string line;
+	while (std::getline(file, line)) {
+		lines.push_back(line);
+	}
+	return lines;
+}
+
+TEST(LoggerTests, LinesFromManyThreadsAreWrittenWholeTest) {
+	const std::string path = "LoggerManyThreads.log";
+	{
+		logs::Logger logger(path);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; t++) {
+			threads.emplace_back([&logger, t] {
+				for (int i = 0; i < 100; i++) {
+					logger.log(logs::Level::INFO, "thread ", t, " line ", i, " end");
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		logger.flush();
+		EXPECT_EQ(logger.droppedCount(), 0);
+	}
+
+	int written = 0;
+	for (const auto& line : readLines(path)) {
+		if (line.find("INFO thread ") != std::string::npos) {
+			EXPECT_EQ(line.substr(line.size() - 4), " end");
+			written++;
+		}
+	}
+	EXPECT_EQ(written, 400);
+	EXPECT_FALSE(std::remove(path.c_str()));
+}
+
+TEST(LoggerTests, LongLinesAreCutTest) {
+	const std::string path = "LoggerLongLine.log";
+	{
+		logs::Logger logger(path);
+		logger.log(logs::Level::ERROR, std::string(2 * logs::maxLineSize, 'x'), 42);
+	}
+	const std::string log = [&] {
+		std::ifstream file(path);
+		return std::string{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	}();
+	EXPECT_NE(log.find(std::string(logs::maxLineSize, 'x')), std::string::npos);
+	EXPECT_EQ(log.find(std::string(logs::maxLineSize + 1, 'x')), std::string::npos);
+	// Timestamps may contain 42 as well
+	EXPECT_EQ(log.find("x42"), std::string::npos);
+	EXPECT_FALSE(std::remove(path.c_str()));
+}
+
+TEST(LoggerTests, LessSevereLevelsAreSkippedTest) {
+	const std::string path = "LoggerLevels.log";
+	{
+		logs::Logger logger(path, logs::Level::INFO);
+		int evaluated = 0;
+		auto argument = [&evaluated] { return ++evaluated; };
+		logger.log(logs::Level::DEBUG, "skipped debug");
+		LOG_DEBUG(logger, "skipped macro ", argument());
+		LOG_INFO(logger, "kept info ", argument());
+		logger.setLevel(logs::Level::ERROR);
+		LOG_INFO(logger, "skipped info ", argument());
+		logger.log(logs::Level::ERROR, "kept error");
+		EXPECT_EQ(evaluated, 1);
+	}
+	const auto lines = readLines(path);
+	std::string log;
+	for (const auto& line : lines) {
+		log += line;
+	}
+	EXPECT_EQ(log.find("skipped"), std::string::npos);
+	EXPECT_NE(log.find("INFO kept info 1"), std::string::npos);
+	EXPECT_NE(log.find("ERROR kept error"), std::string::npos);
+	EXPECT_FALSE(std::remove(path.c_str()));
+}
+
+std::string readFile(const std::string& path) {
+	std::ifstream file(path, std::ifstream::binary);
+	return std::string{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+}
+
+TEST(LoggerTests, BinaryLogIsDecodedToTextTest) {
+	const std::string path = "LoggerBinary.log";
+	{
+		logs::Logger logger(path, logs::Level::DEBUG, logs::Encoding::binary);
+		for (int i = 0; i < 2; i++) {
+			LOG_INFO(logger, "[", i, ",", -7, "] wrote '", std::string{ "letters" }, "'");
+		}
+		LOG_DEBUG(logger, 'c', " ", true, " ", 2.5, " ", static_cast<size_t>(9));
+		logger.log(logs::Level::ERROR, "plain ", 42);
+	}
+	const std::string binaryLog = readFile(path);
+	const size_t literal = binaryLog.find("] wrote '");
+	ASSERT_NE(literal, std::string::npos);
+	EXPECT_EQ(binaryLog.find("] wrote '", literal + 1), std::string::npos);
+	EXPECT_EQ(binaryLog.find("[0,-7]"), std::string::npos);
+
+	std::ifstream in(path, std::ifstream::binary);
+	std::ostringstream out;
+	ASSERT_TRUE(logs::decode(in, out));
+	const std::string text = out.str();
+	EXPECT_NE(text.find("INFO [0,-7] wrote 'letters'"), std::string::npos);
+	EXPECT_NE(text.find("INFO [1,-7] wrote 'letters'"), std::string::npos);
+	EXPECT_NE(text.find("DEBUG c 1 2.5 9"), std::string::npos);
+	EXPECT_NE(text.find("ERROR plain 42"), std::string::npos);
+	EXPECT_FALSE(std::remove(path.c_str()));
+}
+
+TEST(LoggerTests, StreamedArgumentsAreFormattedInPlaceTest) {
+	const std::string textPath = "LoggerStreamedText.log";
+	const std::string binaryPath = "LoggerStreamedBinary.log";
+	std::ostringstream id;
+	id << std::this_thread::get_id();
+	{
+		logs::Logger textLogger(textPath);
+		textLogger.log(logs::Level::INFO, "thread ", std::this_thread::get_id(), " half ", 0.5f);
+		textLogger.log(logs::Level::INFO, std::string(logs::maxLineSize - 2, 'x'), std::this_thread::get_id());
+		logs::Logger binaryLogger(binaryPath, logs::Level::DEBUG, logs::Encoding::binary);
+		LOG_INFO(binaryLogger, "thread ", std::this_thread::get_id());
+	}
+	const std::string text = readFile(textPath);
+	EXPECT_NE(text.find("INFO thread " + id.str() + " half 0.5"), std::string::npos);
+	// What does not fit is cut like any other argument
+	EXPECT_NE(text.find(std::string(logs::maxLineSize - 2, 'x') + id.str().substr(0, 2) + "\n"), std::string::npos);
+
+	std::ifstream in(binaryPath, std::ifstream::binary);
+	std::ostringstream out;
+	ASSERT_TRUE(logs::decode(in, out));
+	EXPECT_NE(out.str().find("INFO thread " + id.str()), std::string::npos);
+	EXPECT_FALSE(std::remove(textPath.c_str()));
+	EXPECT_FALSE(std::remove(binaryPath.c_str()));
+}
+
+TEST(LoggerTests, DamagedBinaryLogIsRejectedTest) {
+	std::istringstream textLog{ "[Mon Jan  1 00:00:00 2024] INFO text\n" };
+	std::ostringstream out;
+	EXPECT_FALSE(logs::decode(textLog, out));
+
+	const std::string path = "LoggerBinaryDamaged.log";
+	{
+		logs::Logger logger(path, logs::Level::DEBUG, logs::Encoding::binary);
+		LOG_INFO(logger, "value ", 1);
+	}
+	const std::string binaryLog = readFile(path);
+	std::istringstream cut{ binaryLog.substr(0, binaryLog.size() - 3) };
+	EXPECT_FALSE(logs::decode(cut, out));
+	EXPECT_FALSE(std::remove(path.c_str()));
+}
+
+void removeLogs(const std::string& path) {
+	std::remove(path.c_str());
+	for (int i = 1; i <= 4; i++) {
+		std::remove((path + "." + std::to_string(i)).c_str());
+		std::remove((path + "." + std::to_string(i) + ".lz4").c_str());
+	}
+}
+
+TEST(LoggerTests, RestartKeepsPreviousLogTest) {
+	const std::string path = "LoggerRestart.log";
+	removeLogs(path);
+	{
+		logs::Logger logger(path);
+		logger.log(logs::Level::INFO, "first run");
+	}
+	{
+		logs::Logger logger(path);
+		logger.log(logs::Level::INFO, "second run");
+	}
+	EXPECT_NE(readFile(path).find("second run"), std::string::npos);
+	EXPECT_EQ(readFile(path).find("first run"), std::string::npos);
+	EXPECT_NE(readFile(path + ".1").find("first run"), std::string::npos);
+	removeLogs(path);
+}
+
+TEST(LoggerTests, BigLogIsRotatedIntoBoundedSegmentsTest) {
+	const std::string path = "LoggerRotation.log";
+	removeLogs(path);
+	{
+		logs::Logger logger(path, logs::Level::DEBUG, logs::Encoding::text, logs::Rotation{ 200, std::chrono::seconds{ 0 }, 2, false });
+		for (int i = 0; i < 20; i++) {
+			logger.log(logs::Level::INFO, "line ", i);
+			logger.flush();
+		}
+	}
+	EXPECT_NE(readFile(path).find("line 19"), std::string::npos);
+	for (const auto& segment : { path, path + ".1", path + ".2" }) {
+		const std::string content = readFile(segment);
+		EXPECT_FALSE(content.empty());
+		EXPECT_LE(content.size(), 200);
+	}
+	std::ifstream third(path + ".3");
+	EXPECT_FALSE(third.is_open());
+	removeLogs(path);
+}
+
+TEST(LoggerTests, RotatedSegmentsAreCompressedTest) {
+	const std::string path = "LoggerCompressed.log";
+	removeLogs(path);
+	std::string firstSegment;
+	{
+		logs::Logger logger(path, logs::Level::DEBUG, logs::Encoding::text, logs::Rotation{ 4096, std::chrono::seconds{ 0 }, 2, true });
+		for (int i = 0; i < 100; i++) {
+			logger.log(logs::Level::INFO, "the same line repeated over and over ", i % 10);
+			logger.flush();
+		}
+	}
+	std::ifstream plain(path + ".1");
+	EXPECT_FALSE(plain.is_open());
+	std::ifstream segment(path + ".1.lz4", std::ifstream::binary);
+	ASSERT_TRUE(segment.is_open());
+	std::string inflated;
+	ASSERT_TRUE(logs::inflate(segment, inflated));
+	EXPECT_NE(inflated.find("INFO the same line repeated over and over 9"), std::string::npos);
+	EXPECT_LT(readFile(path + ".1.lz4").size(), inflated.size() / 2);
+	removeLogs(path);
+}
+
+TEST(LoggerTests, BigCompressedSegmentInflatesToSameTextTest) {
+	const std::string path = "LoggerBigCompressed.log";
+	removeLogs(path);
+	// Few distinct words, so a line repeats text from much more than one 64 KB block back
+	const std::vector<std::string> words{ "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta" };
+	auto lineText = [&words](const int i) {
+		std::string text = "line " + std::to_string(i);
+		for (int k = 0; k < 12; k++) {
+			text += " " + words[(i * 7 + k * k) % words.size()];
+		}
+		return text;
+	};
+	constexpr int lineCount = 20000;
+	{
+		logs::Logger logger(path, logs::Level::DEBUG, logs::Encoding::text, logs::Rotation{ 1024 * 1024, std::chrono::seconds{ 0 }, 2, true });
+		for (int i = 0; i < lineCount; i++) {
+			logger.log(logs::Level::INFO, lineText(i));
+			if (i % 100 == 99) {
+				logger.flush();
+			}
+		}
+		EXPECT_EQ(logger.droppedCount(), 0);
+	}
+	std::ifstream segment(path + ".1.lz4", std::ifstream::binary);
+	ASSERT_TRUE(segment.is_open());
+	std::string inflated;
+	ASSERT_TRUE(logs::inflate(segment, inflated));
+	EXPECT_GT(inflated.size(), 512 * 1024);
+
+	// Timestamps aside, the segment holds consecutive lines exactly as they were logged
+	std::istringstream lines{ inflated };
+	std::string line;
+	int expected = -1;
+	int checked = 0;
+	while (std::getline(lines, line)) {
+		const size_t text = line.find(" INFO line ");
+		ASSERT_NE(text, std::string::npos) << line;
+		const int i = std::stoi(line.substr(text + 11));
+		if (expected >= 0) {
+			ASSERT_EQ(i, expected);
+		}
+		ASSERT_EQ(line.substr(text + 6), lineText(i));
+		expected = i + 1;
+		checked++;
+	}
+	EXPECT_EQ(inflated.back(), '\n');
+	EXPECT_GT(checked, 5000);
+	removeLogs(path);
+}
+
+TEST(LoggerTests, TimestampIsIso8601WithMicrosecondsTest) {
+	std::string out;
+	logs::appendTimestamp(out, 1714566605123456789);
+	EXPECT_EQ(out, "2024-05-01T12:30:05.123456Z");
+	out.clear();
+	logs::appendTimestamp(out, 1714566605999999000);
+	logs::appendTimestamp(out, 951782400000001000);
+	EXPECT_EQ(out, "2024-05-01T12:30:05.999999Z2000-02-29T00:00:00.000001Z");
+}
+
+TEST(LoggerTests, EveryLineStartsWithTimestampTest) {
+	const std::string path = "LoggerTimestamp.log";
+	removeLogs(path);
+	{
+		logs::Logger logger(path);
+		logger.log(logs::Level::INFO, "first");
+		logger.log(logs::Level::ERROR, "second");
+	}
+	const auto lines = readLines(path);
+	ASSERT_EQ(lines.size(), 2);
+	const std::regex format{ R"(\[\d{4}-\d{2}-\d{2}T\d{2}:\d{2}:\d{2}\.\d{6}Z\] (INFO first|ERROR second))" };
+	for (const auto& line : lines) {
+		EXPECT_TRUE(std::regex_match(line, format)) << line;
+	}
+	removeLogs(path);
+}
+
+#pragma pop_macro("ERROR")
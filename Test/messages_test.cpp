@@ -1,5 +1,6 @@
 #include "pch.h"
 #include <array>
+#include <climits>
 
 #include "messages.h"
 
@@ -10,6 +11,7 @@ constexpr COORD cursorPos{ 32, 54 };
 const std::string username = "username";
 const std::string password = "password";
 const std::string token = "token";
+constexpr uint32_t sessionId = 7;
 const std::string filename = "filename.txt";
 const std::string accessCode = "C7JKFN";
 const std::string text = "mea culpa";
@@ -34,7 +36,8 @@ TEST(MessagesTest, RegisterSerializeAndParseTest) {
     EXPECT_EQ(buffer.size, 21);
     EXPECT_EQ(buffer.capacity, 128);
 
-    auto parsed = msg::Register::parse(buffer);
+    auto [parsed, valid] = msg::Register::parse(buffer);
+    EXPECT_TRUE(valid);
     EXPECT_EQ(parsed.header.version, version);
     EXPECT_EQ(parsed.header.type, msg::MessageType::registration);
     EXPECT_EQ(parsed.header.errCode, errCode);
@@ -49,7 +52,8 @@ TEST(MessagesTest, LoginSerializeAndParseTest) {
     EXPECT_EQ(buffer.size, 21);
     EXPECT_EQ(buffer.capacity, 128);
 
-    auto parsed = msg::Login::parse(buffer);
+    auto [parsed, valid] = msg::Login::parse(buffer);
+    EXPECT_TRUE(valid);
     EXPECT_EQ(parsed.header.version, version);
     EXPECT_EQ(parsed.header.type, msg::MessageType::login);
     EXPECT_EQ(parsed.header.errCode, errCode);
@@ -64,7 +68,8 @@ TEST(MessagesTest, CreateSerializeAndParseTest) {
     EXPECT_EQ(buffer.size, 22);
     EXPECT_EQ(buffer.capacity, 128);
 
-    auto parsed = msg::Create::parse(buffer);
+    auto [parsed, valid] = msg::Create::parse(buffer);
+    EXPECT_TRUE(valid);
     EXPECT_EQ(parsed.header.version, version);
     EXPECT_EQ(parsed.header.type, msg::MessageType::create);
     EXPECT_EQ(parsed.header.errCode, errCode);
@@ -79,7 +84,8 @@ TEST(MessagesTest, LoadSerializeAndParseTest) {
     EXPECT_EQ(buffer.size, 22);
     EXPECT_EQ(buffer.capacity, 128);
 
-    auto parsed = msg::Load::parse(buffer);
+    auto [parsed, valid] = msg::Load::parse(buffer);
+    EXPECT_TRUE(valid);
     EXPECT_EQ(parsed.header.version, version);
     EXPECT_EQ(parsed.header.type, msg::MessageType::load);
     EXPECT_EQ(parsed.header.errCode, errCode);
@@ -94,7 +100,8 @@ TEST(MessagesTest, JoinSerializeAndParseTest) {
     EXPECT_EQ(buffer.size, 16);
     EXPECT_EQ(buffer.capacity, 128);
 
-    auto parsed = msg::Join::parse(buffer);
+    auto [parsed, valid] = msg::Join::parse(buffer);
+    EXPECT_TRUE(valid);
     EXPECT_EQ(parsed.header.version, version);
     EXPECT_EQ(parsed.header.type, msg::MessageType::join);
     EXPECT_EQ(parsed.header.errCode, errCode);
@@ -104,16 +111,17 @@ TEST(MessagesTest, JoinSerializeAndParseTest) {
 
 TEST(MessagesTest, WriteSerializeAndParseTest) {
     msg::Buffer buffer{ 128 };
-    msg::Write msg{version, errCode, token, cursorPos, text};
+    msg::Write msg{version, errCode, sessionId, cursorPos, text};
     msg.serializeTo(buffer);
-    EXPECT_EQ(buffer.size, 23);
+    EXPECT_EQ(buffer.size, 21);
     EXPECT_EQ(buffer.capacity, 128);
 
-    msg::Write parsed = msg::Write::parse(buffer);
+    auto [parsed, valid] = msg::Write::parse(buffer);
+    EXPECT_TRUE(valid);
     EXPECT_EQ(parsed.header.version, version);
     EXPECT_EQ(parsed.header.type, msg::MessageType::write);
     EXPECT_EQ(parsed.header.errCode, errCode);
-    EXPECT_EQ(parsed.token, token);
+    EXPECT_EQ(parsed.sessionId, sessionId);
     EXPECT_EQ(parsed.cursorPos.X, cursorPos.X);
     EXPECT_EQ(parsed.cursorPos.Y, cursorPos.Y);
     EXPECT_EQ(parsed.text, text);
@@ -121,21 +129,48 @@ TEST(MessagesTest, WriteSerializeAndParseTest) {
 
 TEST(MessagesTest, EraseSerializeAndParseTest) {
     msg::Buffer buffer{ 128 };
-    msg::Erase msg{version, errCode, token, cursorPos, eraseSize};
+    msg::Erase msg{version, errCode, sessionId, cursorPos, eraseSize};
     msg.serializeTo(buffer);
-    EXPECT_EQ(buffer.size, 17);
+    EXPECT_EQ(buffer.size, 15);
     EXPECT_EQ(buffer.capacity, 128);
 
-    msg::Erase parsed = msg::Erase::parse(buffer);
+    auto [parsed, valid] = msg::Erase::parse(buffer);
+    EXPECT_TRUE(valid);
     EXPECT_EQ(parsed.header.version, version);
     EXPECT_EQ(parsed.header.type, msg::MessageType::erase);
     EXPECT_EQ(parsed.header.errCode, errCode);
-    EXPECT_EQ(parsed.token, token);
+    EXPECT_EQ(parsed.sessionId, sessionId);
     EXPECT_EQ(parsed.cursorPos.X, cursorPos.X);
     EXPECT_EQ(parsed.cursorPos.Y, cursorPos.Y);
     EXPECT_EQ(parsed.eraseSize, eraseSize);
 }
 
+TEST(MessagesTest, UndoSerializeAndParseTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Undo msg{version, errCode, token};
+    msg.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, 9);
+
+    auto [parsed, valid] = msg::Undo::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.header.version, version);
+    EXPECT_EQ(parsed.header.type, msg::MessageType::undo);
+    EXPECT_EQ(parsed.header.errCode, errCode);
+    EXPECT_EQ(parsed.token, token);
+}
+
+TEST(MessagesTest, RedoSerializeAndParseTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Redo msg{version, errCode, token};
+    msg.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, 9);
+
+    auto [parsed, valid] = msg::Redo::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.header.type, msg::MessageType::redo);
+    EXPECT_EQ(parsed.token, token);
+}
+
 TEST(MessagesTest, ServerResponseSerializeAndParseTest) {
     msg::Buffer buffer{ 128 };
     std::array<std::string, 3> messages = {"msg1", "msg2", "msg3"};
@@ -152,3 +187,392 @@ TEST(MessagesTest, ServerResponseSerializeAndParseTest) {
     EXPECT_EQ(parsed.messages[1], "msg2");
     EXPECT_EQ(parsed.messages[2], "msg3");
 }
+
+TEST(MessagesTest, WriteViewParseTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Write msg{version, errCode, sessionId, cursorPos, text};
+    msg.serializeTo(buffer);
+
+    auto [parsed, valid] = msg::WriteView::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.header.type, msg::MessageType::write);
+    EXPECT_EQ(parsed.header.errCode, errCode);
+    EXPECT_EQ(parsed.sessionId, sessionId);
+    EXPECT_EQ(parsed.cursorPos.X, cursorPos.X);
+    EXPECT_EQ(parsed.cursorPos.Y, cursorPos.Y);
+    EXPECT_EQ(parsed.text, text);
+    EXPECT_EQ(parsed.text.data(), buffer.get() + buffer.size - text.size() - 1);
+}
+
+TEST(MessagesTest, TruncatedWriteViewParseTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Write msg{version, errCode, sessionId, cursorPos, text};
+    msg.serializeTo(buffer);
+    buffer.size -= 1;
+    EXPECT_FALSE(msg::WriteView::parse(buffer).second);
+    buffer.size = 10;
+    EXPECT_FALSE(msg::WriteView::parse(buffer).second);
+    buffer.size = 2;
+    EXPECT_FALSE(msg::WriteView::parse(buffer).second);
+}
+
+TEST(MessagesTest, EraseViewParseTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Erase msg{version, errCode, sessionId, cursorPos, eraseSize};
+    msg.serializeTo(buffer);
+
+    auto [parsed, valid] = msg::EraseView::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.header.type, msg::MessageType::erase);
+    EXPECT_EQ(parsed.sessionId, sessionId);
+    EXPECT_EQ(parsed.cursorPos.X, cursorPos.X);
+    EXPECT_EQ(parsed.cursorPos.Y, cursorPos.Y);
+    EXPECT_EQ(parsed.eraseSize, eraseSize);
+
+    buffer.size -= 1;
+    EXPECT_FALSE(msg::EraseView::parse(buffer).second);
+}
+
+TEST(MessagesTest, PooledBufferIsReusedTest) {
+    auto& pool = msg::BufferPool::local();
+    char* first = nullptr;
+    {
+        auto buffer = pool.acquire(100);
+        EXPECT_EQ(buffer.capacity, 128);
+        first = buffer.get();
+    }
+    size_t freeCount = pool.freeCount();
+    EXPECT_GE(freeCount, 1);
+
+    auto buffer = pool.acquire(128);
+    EXPECT_EQ(buffer.get(), first);
+    EXPECT_EQ(buffer.size, 0);
+    EXPECT_EQ(pool.freeCount(), freeCount - 1);
+}
+
+TEST(MessagesTest, OversizedBufferIsNotPooledTest) {
+    auto& pool = msg::BufferPool::local();
+    size_t freeCount = pool.freeCount();
+    {
+        auto buffer = pool.acquire(msg::BufferPool::sizeClasses.back() + 1);
+        EXPECT_EQ(buffer.capacity, msg::BufferPool::sizeClasses.back() + 1);
+    }
+    EXPECT_EQ(pool.freeCount(), freeCount);
+}
+
+TEST(MessagesTest, ParseIgnoresStaleBytesAfterClearTest) {
+    auto buffer = msg::BufferPool::local().acquire(128);
+    msg::Login{ version, errCode, "a very long username", "a very long password" }.serializeTo(buffer);
+    buffer.clear();
+    EXPECT_EQ(buffer.size, 0);
+
+    msg::Header{ msg::MessageType::login, version, errCode }.serializeTo(buffer);
+    std::string user = "user";
+    buffer.add(&user);
+    buffer.size -= 1;
+    // The terminator of username is past size, so the stale one behind it must not be used
+    EXPECT_FALSE(msg::Login::parse(buffer).second);
+}
+
+TEST(MessagesTest, ResyncSerializeAndParseTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Resync msg{ msg::resyncVersion, errCode, token, accessCode, 300 };
+    msg.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, msg.size());
+
+    auto [parsed, valid] = msg::Resync::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.token, token);
+    EXPECT_EQ(parsed.accessCode, accessCode);
+    EXPECT_EQ(parsed.revision, 300);
+
+    buffer.size -= 1;
+    EXPECT_FALSE(msg::Resync::parse(buffer).second);
+}
+
+TEST(MessagesTest, ResyncRevisionIsInNetworkOrderInVersion1Test) {
+    msg::Buffer buffer{ 128 };
+    msg::Resync{ version, errCode, token, accessCode, 300 }.serializeTo(buffer);
+    EXPECT_EQ(std::string(buffer.get() + buffer.size - 4, 4), std::string("\0\0\x01\x2c", 4));
+
+    auto [parsed, valid] = msg::Resync::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.revision, 300);
+}
+
+TEST(MessagesTest, BufferGrowsOnOverflowTest) {
+    msg::Buffer buffer{ 4 };
+    msg::Write msg{version, errCode, sessionId, cursorPos, std::string(1000, 'a')};
+    msg.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, msg.size);
+    EXPECT_GE(buffer.capacity, msg.size);
+
+    auto [parsed, valid] = msg::Write::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.text, std::string(1000, 'a'));
+}
+
+TEST(MessagesTest, ChunkSerializeAndParseTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Chunk msg{version, 0, 1234, text};
+    msg.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, msg.size);
+
+    auto [parsed, valid] = msg::Chunk::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.header.type, msg::MessageType::chunk);
+    EXPECT_EQ(parsed.totalSize, 1234);
+    EXPECT_EQ(parsed.text, text);
+}
+
+TEST(MessagesTest, FrameReaderSplitsAndJoinsFramesTest) {
+    msg::Buffer first{ 128 }, second{ 128 }, frame{ 128 };
+    msg::Write{version, errCode, sessionId, cursorPos, text}.serializeTo(first);
+    msg::Erase{version, errCode, sessionId, cursorPos, eraseSize}.serializeTo(second);
+    std::string frames;
+    msg::serializeFrame(frame, first);
+    frames.append(frame.get(), frame.size);
+    msg::serializeFrame(frame, second);
+    frames.append(frame.get(), frame.size);
+
+    // Two frames coalesced and then torn apart at an arbitrary byte
+    msg::FrameReader reader;
+    reader.append(frames.data(), 5);
+    EXPECT_FALSE(reader.next(frame));
+    reader.append(frames.data() + 5, frames.size() - 10);
+    ASSERT_TRUE(reader.next(frame));
+    EXPECT_EQ(msg::Write::parse(frame).first.text, text);
+    EXPECT_FALSE(reader.next(frame));
+    reader.append(frames.data() + frames.size() - 5, 5);
+    ASSERT_TRUE(reader.next(frame));
+    EXPECT_EQ(msg::Erase::parse(frame).first.eraseSize, eraseSize);
+    EXPECT_FALSE(reader.corrupted());
+}
+
+TEST(MessagesTest, FrameReaderRejectsOversizedFrameTest) {
+    msg::Buffer frame{ 128 };
+    u_long frameSize = htonl(msg::maxFrameSize + 1);
+    msg::FrameReader reader;
+    reader.append(reinterpret_cast<const char*>(&frameSize), sizeof(frameSize));
+    EXPECT_FALSE(reader.next(frame));
+    EXPECT_TRUE(reader.corrupted());
+}
+
+class Rename : public msg::Message<Rename, msg::MessageType::create> {
+public:
+    Rename(const int version, const int errCode, const std::string& token, const uint32_t docId, const std::string& filename) :
+        Message(version, errCode), token(token), docId(docId), filename(filename) {}
+
+    std::string token;
+    uint32_t docId;
+    std::string filename;
+    static constexpr auto fields = std::make_tuple(&Rename::token, &Rename::docId, &Rename::filename);
+};
+
+TEST(MessagesTest, SchemaGeneratesParseSerializeAndSizeTest) {
+    msg::Buffer buffer{ 8 };
+    Rename msg{version, errCode, token, 42, filename};
+    EXPECT_EQ(msg.size(), 3 + token.size() + 1 + sizeof(uint32_t) + filename.size() + 1);
+    msg.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, msg.size());
+
+    auto [parsed, valid] = Rename::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.header.type, msg::MessageType::create);
+    EXPECT_EQ(parsed.header.version, version);
+    EXPECT_EQ(parsed.header.errCode, errCode);
+    EXPECT_EQ(parsed.token, token);
+    EXPECT_EQ(parsed.docId, 42);
+    EXPECT_EQ(parsed.filename, filename);
+}
+
+TEST(MessagesTest, BatchSerializeAndParseTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Batch msg{version, errCode, sessionId, {
+        msg::BatchOp{ msg::MessageType::write, cursorPos, text, 0 },
+        msg::BatchOp{ msg::MessageType::erase, COORD{ 3, 4 }, "", eraseSize }
+    }};
+    msg.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, msg.size);
+
+    auto [parsed, valid] = msg::Batch::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.header.type, msg::MessageType::batch);
+    EXPECT_EQ(parsed.sessionId, sessionId);
+    ASSERT_EQ(parsed.ops.size(), 2);
+    EXPECT_EQ(parsed.ops[0].type, msg::MessageType::write);
+    EXPECT_EQ(parsed.ops[0].cursorPos.X, cursorPos.X);
+    EXPECT_EQ(parsed.ops[0].cursorPos.Y, cursorPos.Y);
+    EXPECT_EQ(parsed.ops[0].text, text);
+    EXPECT_EQ(parsed.ops[1].type, msg::MessageType::erase);
+    EXPECT_EQ(parsed.ops[1].cursorPos.X, 3);
+    EXPECT_EQ(parsed.ops[1].eraseSize, eraseSize);
+
+    buffer.size -= 1;
+    EXPECT_FALSE(msg::Batch::parse(buffer).second);
+}
+
+TEST(MessagesTest, VarintSerializeTest) {
+    msg::Buffer buffer{ 128 };
+    for (uint32_t value : { 0u, 127u, 128u, 300u, 0xffffffffu }) {
+        const int before = buffer.size;
+        buffer.addVarint(value);
+        EXPECT_EQ(buffer.size - before, msg::varintSize(value));
+    }
+    EXPECT_EQ(msg::varintSize(127), 1);
+    EXPECT_EQ(msg::varintSize(300), 2);
+    EXPECT_EQ(msg::varintSize(0xffffffffu), msg::maxVarintSize);
+    // 300 = 0b10'0101100
+    EXPECT_EQ(static_cast<unsigned char>(buffer.get()[4]), 0xac);
+    EXPECT_EQ(static_cast<unsigned char>(buffer.get()[5]), 0x02);
+}
+
+TEST(MessagesTest, CompactWriteSerializeAndParseTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Write msg{msg::compactVersion, errCode, sessionId, cursorPos, text};
+    msg.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, 3 + 1 + 1 + 1 + 1 + text.size());
+    EXPECT_EQ(buffer.size, msg.size);
+
+    auto [parsed, valid] = msg::Write::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.header.version, msg::compactVersion);
+    EXPECT_EQ(parsed.header.type, msg::MessageType::write);
+    EXPECT_EQ(parsed.sessionId, sessionId);
+    EXPECT_EQ(parsed.cursorPos.X, cursorPos.X);
+    EXPECT_EQ(parsed.cursorPos.Y, cursorPos.Y);
+    EXPECT_EQ(parsed.text, text);
+
+    buffer.size -= 1;
+    EXPECT_FALSE(msg::WriteView::parse(buffer).second);
+}
+
+TEST(MessagesTest, CompactEraseKeepsBigPositionsTest) {
+    msg::Buffer buffer{ 128 };
+    const COORD farPos{ 300, 30000 };
+    msg::Erase msg{msg::compactVersion, errCode, 100000, farPos, eraseSize};
+    msg.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, 3 + 3 + 2 + 3 + 1);
+    EXPECT_EQ(buffer.size, msg.size);
+
+    auto [parsed, valid] = msg::EraseView::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.sessionId, 100000);
+    EXPECT_EQ(parsed.cursorPos.X, farPos.X);
+    EXPECT_EQ(parsed.cursorPos.Y, farPos.Y);
+    EXPECT_EQ(parsed.eraseSize, eraseSize);
+
+    // Varint which never ends
+    buffer.clear();
+    msg::Header{ msg::MessageType::erase, msg::compactVersion, 0 }.serializeTo(buffer);
+    for (int i = 0; i < 8; i++) {
+        buffer.addVarint(0xffffffffu);
+    }
+    EXPECT_FALSE(msg::EraseView::parse(buffer).second);
+}
+
+TEST(MessagesTest, TruncatedCompactWriteAndEraseParseTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Write{msg::compactVersion, errCode, sessionId, cursorPos, text}.serializeTo(buffer);
+    buffer.size -= 1;
+    EXPECT_FALSE(msg::Write::parse(buffer).second);
+
+    buffer.clear();
+    msg::Erase{msg::compactVersion, errCode, sessionId, cursorPos, eraseSize}.serializeTo(buffer);
+    buffer.size -= 1;
+    EXPECT_FALSE(msg::Erase::parse(buffer).second);
+}
+
+TEST(MessagesTest, EraseSizeOutOfIntRangeIsRejectedTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Erase{msg::compactVersion, errCode, sessionId, cursorPos, INT_MIN}.serializeTo(buffer);
+    EXPECT_FALSE(msg::EraseView::parse(buffer).second);
+
+    buffer.clear();
+    msg::Erase{msg::compactVersion, errCode, sessionId, cursorPos, 0}.serializeTo(buffer);
+    EXPECT_FALSE(msg::EraseView::parse(buffer).second);
+
+    buffer.clear();
+    msg::Batch{msg::compactVersion, errCode, sessionId, {
+        msg::BatchOp{ msg::MessageType::erase, cursorPos, "", INT_MIN }
+    }}.serializeTo(buffer);
+    EXPECT_FALSE(msg::Batch::parse(buffer).second);
+}
+
+TEST(MessagesTest, CompactBatchSerializeAndParseTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Batch msg{msg::compactVersion, errCode, sessionId, {
+        msg::BatchOp{ msg::MessageType::write, cursorPos, text, 0 },
+        msg::BatchOp{ msg::MessageType::erase, COORD{ 3, 4 }, "", eraseSize }
+    }};
+    msg.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, msg.size);
+
+    auto [parsed, valid] = msg::Batch::parse(buffer);
+    EXPECT_TRUE(valid);
+    ASSERT_EQ(parsed.ops.size(), 2);
+    EXPECT_EQ(parsed.ops[0].text, text);
+    EXPECT_EQ(parsed.ops[1].cursorPos.Y, 4);
+    EXPECT_EQ(parsed.ops[1].eraseSize, eraseSize);
+
+    buffer.size -= 1;
+    EXPECT_FALSE(msg::Batch::parse(buffer).second);
+}
+
+TEST(MessagesTest, RevisionIsStampedInPlaceTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Write{msg::resyncVersion, errCode, sessionId, cursorPos, text}.serializeTo(buffer);
+    msg::stampRevision(buffer, 0, 300);
+    auto [parsed, valid] = msg::WriteView::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.revision, 300);
+    EXPECT_EQ(parsed.text, text);
+
+    buffer.clear();
+    msg::Erase{msg::resyncVersion, errCode, sessionId, cursorPos, eraseSize, 5}.serializeTo(buffer);
+    EXPECT_EQ(msg::Erase::parse(buffer).first.revision, 5);
+    // Older versions have no revision
+    buffer.clear();
+    msg::Erase{msg::compressedVersion, errCode, sessionId, cursorPos, eraseSize}.serializeTo(buffer);
+    const int size = buffer.size;
+    msg::stampRevision(buffer, 0, 7);
+    EXPECT_EQ(buffer.size, size);
+}
+
+TEST(MessagesTest, SentAtSurvivesRevisionStampTest) {
+    msg::Buffer buffer{ 128 };
+    msg::Write write{msg::timedVersion, errCode, sessionId, cursorPos, text, 0, 123456789};
+    write.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, write.size);
+    msg::stampRevision(buffer, 0, 300);
+    auto [parsed, valid] = msg::WriteView::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.sentAt, 123456789);
+    EXPECT_EQ(parsed.revision, 300);
+
+    buffer.clear();
+    msg::Erase{msg::timedVersion, errCode, sessionId, cursorPos, eraseSize, 0, 42}.serializeTo(buffer);
+    EXPECT_EQ(msg::Erase::parse(buffer).first.sentAt, 42);
+    // Older versions do not carry it
+    buffer.clear();
+    msg::Erase{msg::resyncVersion, errCode, sessionId, cursorPos, eraseSize, 0, 42}.serializeTo(buffer);
+    EXPECT_EQ(msg::Erase::parse(buffer).first.sentAt, 0);
+}
+
+TEST(MessagesTest, ResyncReplySerializeAndParseTest) {
+    msg::Buffer buffer{ 128 };
+    const std::string payload{ "\0\0\0\1a", 5 };
+    msg::ResyncReply msg{msg::resyncVersion, 0, 42, false, payload};
+    msg.serializeTo(buffer);
+    EXPECT_EQ(buffer.size, msg.size);
+
+    auto [parsed, valid] = msg::ResyncReply::parse(buffer);
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(parsed.header.type, msg::MessageType::resync);
+    EXPECT_EQ(parsed.revision, 42);
+    EXPECT_FALSE(parsed.snapshot);
+    EXPECT_EQ(parsed.payload, payload);
+
+    buffer.size -= 1;
+    EXPECT_FALSE(msg::ResyncReply::parse(buffer).second);
+}
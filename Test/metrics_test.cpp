@@ -0,0 +1,58 @@
+#include "pch.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+
+TEST(MetricsTests, SumsShardsOfAllThreadsTest) {
+	metrics::Registry registry;
+	std::vector<std::thread> workers;
+	for (int i = 0; i < 4; i++) {
+		workers.emplace_back([&registry]() {
+			for (int j = 0; j < 1000; j++) {
+				registry.countMessage(msg::MessageType::write);
+				registry.add(metrics::Counter::bytesIn, 10);
+				registry.record(metrics::Distribution::processLatencyNs, j);
+			}
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	auto snapshot = registry.snapshot();
+	EXPECT_EQ(snapshot.messages[static_cast<size_t>(msg::MessageType::write)], 4000);
+	EXPECT_EQ(snapshot.counters[static_cast<size_t>(metrics::Counter::bytesIn)], 40000);
+	const auto& latency = snapshot.distributions[static_cast<size_t>(metrics::Distribution::processLatencyNs)];
+	EXPECT_EQ(latency.count, 4000);
+	EXPECT_EQ(latency.sum, 4 * 999 * 1000 / 2);
+	EXPECT_EQ(latency.max, 999);
+}
+
+TEST(MetricsTests, RegistriesDoNotShareShardsTest) {
+	metrics::Registry first;
+	metrics::Registry second;
+	first.add(metrics::Counter::connectionsAccepted, 1);
+	second.add(metrics::Counter::connectionsAccepted, 2);
+	first.add(metrics::Counter::connectionsAccepted, 1);
+	EXPECT_EQ(first.snapshot().counters[static_cast<size_t>(metrics::Counter::connectionsAccepted)], 2);
+	EXPECT_EQ(second.snapshot().counters[static_cast<size_t>(metrics::Counter::connectionsAccepted)], 2);
+}
+
+TEST(MetricsTests, RendersOnlyMetricsWithPrefixTest) {
+	metrics::Registry registry;
+	registry.countMessage(msg::MessageType::login);
+	registry.countMessage(static_cast<msg::MessageType>(200));
+	registry.add(metrics::Counter::bytesOut, 42);
+
+	std::string all;
+	metrics::render(registry.snapshot(), "", all);
+	EXPECT_NE(all.find("messages_total{type=\"login\"} 1\n"), std::string::npos);
+	EXPECT_NE(all.find("messages_total{type=\"unknown\"} 1\n"), std::string::npos);
+	EXPECT_NE(all.find("bytes_out_total 42\n"), std::string::npos);
+
+	std::string bytes;
+	metrics::render(registry.snapshot(), "bytes_", bytes);
+	EXPECT_EQ(bytes, "bytes_in_total 0\nbytes_out_total 42\n");
+}
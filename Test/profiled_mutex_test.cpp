@@ -0,0 +1,52 @@
+#include "pch.h"
+#include <string>
+#include <thread>
+#include <chrono>
+
+#include "profiled_mutex.h"
+
+TEST(ProfiledMutexTests, MeasuresWaitAndHoldPerSiteTest) {
+	metrics::ProfiledMutex mutex{ "testLock" };
+	std::thread holder;
+	{
+		metrics::SiteLock lock{ "holder", mutex };
+		holder = std::thread{ [&mutex]() {
+			metrics::SiteLock lock{ "waiter", mutex };
+		} };
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+	}
+	holder.join();
+
+	std::string out;
+	mutex.render("lock_", out);
+	EXPECT_NE(out.find("lock_wait_ns_count{lock=\"testLock\",site=\"holder\"} 1\n"), std::string::npos);
+	EXPECT_NE(out.find("lock_hold_ns_count{lock=\"testLock\",site=\"waiter\"} 1\n"), std::string::npos);
+	EXPECT_NE(out.find("lock_wait_ns{lock=\"testLock\",site=\"waiter\",quantile=\"0.5\"}"), std::string::npos);
+
+	const auto valueOf = [&out](const std::string& name) {
+		const auto begin = out.find(name) + name.size() + 1;
+		return std::stoull(out.substr(begin, out.find('\n', begin) - begin));
+	};
+	constexpr uint64_t millisecond = 1000 * 1000;
+	EXPECT_GE(valueOf("lock_hold_ns_max{lock=\"testLock\",site=\"holder\"}"), 10 * millisecond);
+	EXPECT_GE(valueOf("lock_wait_ns_max{lock=\"testLock\",site=\"waiter\"}"), millisecond);
+}
+
+TEST(ProfiledMutexTests, WorksWithScopedLockOfManyMutexesTest) {
+	metrics::ProfiledMutex first{ "first" };
+	metrics::ProfiledMutex second{ "second" };
+	{
+		metrics::SiteLock lock{ "both", first, second };
+	}
+	{
+		std::scoped_lock lock{ second };
+	}
+
+	std::string out;
+	first.render("", out);
+	second.render("", out);
+	EXPECT_NE(out.find("lock_hold_ns_count{lock=\"first\",site=\"both\"} 1\n"), std::string::npos);
+	EXPECT_NE(out.find("lock_hold_ns_count{lock=\"second\",site=\"both\"} 1\n"), std::string::npos);
+	// Taken without a SiteLock
+	EXPECT_NE(out.find("lock_hold_ns_count{lock=\"second\",site=\"unknown\"} 1\n"), std::string::npos);
+}
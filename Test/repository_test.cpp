@@ -13,6 +13,7 @@ const std::string existingUserId = "9f3d9e66-af0e-4f66-bbbc-c714f4c40ebd";
 const std::string anotherExistingUserId = "214bae8c-218d-474e-92d0-56dc344f3112";
 const std::string existingUsername = "username1";
 const std::string existingPassword = "password";
+const std::string anotherExistingUsername = "username2";
 
 void fillUserDb(const std::string& dbPath) {
 	std::ofstream dbFstream(dbPath, std::ostream::out);
@@ -41,13 +42,30 @@ void createDocFileForWrite(const std::string& name) {
 	}
 }
 
+template<typename MESSAGE>
+MESSAGE parsed(MESSAGE message) {
+	return message;
+}
+
+// Write and Erase tell whether they parsed
+template<typename MESSAGE>
+MESSAGE parsed(std::pair<MESSAGE, bool> message) {
+	EXPECT_TRUE(message.second);
+	return message.first;
+}
+
 template<typename MESSAGE, typename RESPONSE, typename... Args>
 std::pair<RESPONSE, ResponseType> processMsg(Repository& repo, Args&... args) {
 	msg::Buffer buffer{128};
 	MESSAGE msg{ args... };
 	msg.serializeTo(buffer);
 	auto [outBuff, dst] = repo.process(buffer);
-	return std::pair<RESPONSE, ResponseType>( RESPONSE::parse(outBuff), dst );
+	return std::pair<RESPONSE, ResponseType>( parsed(RESPONSE::parse(outBuff)), dst );
+}
+
+uint32_t loginSession(Repository& repo, const std::string& username) {
+	auto [out, dst] = processMsg<msg::Login, msg::ServerResponse<2>>(repo, version, errCode, username, existingPassword);
+	return static_cast<uint32_t>(std::stoul(out.messages[1]));
 }
 
 TEST(RepositoryTests, HappyRegisterTest) {
@@ -88,13 +106,14 @@ TEST(RepositoryTests, HappyLoginTest) {
 	logs::Logger logger("test.log");
 	Repository repository{ "ReadUserTest.csv", "ReadDocTest.csv", logger};
 
-	auto [out, dst] = processMsg<msg::Login, msg::ServerResponse<1>>(
+	auto [out, dst] = processMsg<msg::Login, msg::ServerResponse<2>>(
 		repository, version, errCode, existingUsername, existingPassword
 	);
 	EXPECT_EQ(dst, ResponseType::unicast);
 	EXPECT_EQ(out.header.type, msg::MessageType::login);
 	EXPECT_EQ(out.header.errCode, 0);
 	EXPECT_EQ(out.messages[0], existingUserId);
+	EXPECT_EQ(out.messages[1], "1");
 }
 
 TEST(RepositoryTests, InvalidUsernameLoginTest) {
@@ -235,16 +254,17 @@ TEST(RepositoryTests, HappyJoinDocTest) {
 	fillUserDb(userDbPath);
 	fillDocDb(docDbPath);
 
-	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<2>>(
+	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<3>>(
 		repository, version, errCode, existingUserId, "loadTest.txt"
 	);
-	auto [joinOut, joinDst] = processMsg<msg::Join, msg::ServerResponse<1>>(
+	auto [joinOut, joinDst] = processMsg<msg::Join, msg::ServerResponse<3>>(
 		repository, version, errCode, anotherExistingUserId, loadOut.messages[1]
 	);
 	EXPECT_EQ(joinDst, ResponseType::unicast);
 	EXPECT_EQ(joinOut.header.type, msg::MessageType::join);
 	EXPECT_EQ(joinOut.header.errCode, 0);
-	EXPECT_EQ(joinOut.messages[0], "Some random text,\neverything should work!\n");
+	// Same fields as the Load response
+	EXPECT_EQ(joinOut.messages, loadOut.messages);
 
 	EXPECT_FALSE(std::remove(userDbPath.c_str()));
 	EXPECT_FALSE(std::remove(docDbPath.c_str()));
@@ -310,8 +330,9 @@ TEST(RepositoryTests, OriginalUserWriteToDocTest) {
 	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<2>>(
 		repository, version, errCode, existingUserId, "test.txt"
 	);
+	const uint32_t sessionId = loginSession(repository, existingUsername);
 	auto [writeOut, writeDst] = processMsg<msg::Write, msg::Write>(
-		repository, version, errCode, existingUserId, cursorPos, "by unit test "
+		repository, version, errCode, sessionId, cursorPos, "by unit test "
 	);
 	EXPECT_EQ(writeDst, ResponseType::broadcast);
 	EXPECT_EQ(writeOut.header.type, msg::MessageType::write);
@@ -348,8 +369,9 @@ TEST(RepositoryTests, JoinedUserWriteToDocTest) {
 	auto [joinOut, joinDst] = processMsg<msg::Join, msg::ServerResponse<1>>(
 		repository, version, errCode, anotherExistingUserId, loadOut.messages[1]
 	);
+	const uint32_t sessionId = loginSession(repository, anotherExistingUsername);
 	auto [writeOut, writeDst] = processMsg<msg::Write, msg::Write>(
-		repository, version, errCode, anotherExistingUserId, cursorPos, "by unit test "
+		repository, version, errCode, sessionId, cursorPos, "by unit test "
 	);
 	EXPECT_EQ(writeDst, ResponseType::broadcast);
 	EXPECT_EQ(writeOut.header.type, msg::MessageType::write);
@@ -381,8 +403,9 @@ TEST(RepositoryTests, OriginalUserEraseFromDocTest) {
 	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<2>>(
 		repository, version, errCode, existingUserId, "test.txt"
 	);
+	const uint32_t sessionId = loginSession(repository, existingUsername);
 	auto [eraseOut, eraseDst] = processMsg<msg::Erase, msg::Erase>(
-		repository, version, errCode, existingUserId, cursorPos, eraseSize
+		repository, version, errCode, sessionId, cursorPos, eraseSize
 	);
 	EXPECT_EQ(eraseDst, ResponseType::broadcast);
 	EXPECT_EQ(eraseOut.header.type, msg::MessageType::erase);
@@ -419,8 +442,9 @@ TEST(RepositoryTests, JoinedUserEraseFromDocTest) {
 	auto [joinOut, joinDst] = processMsg<msg::Join, msg::ServerResponse<1>>(
 		repository, version, errCode, anotherExistingUserId, loadOut.messages[1]
 	);
+	const uint32_t sessionId = loginSession(repository, anotherExistingUsername);
 	auto [eraseOut, eraseDst] = processMsg<msg::Erase, msg::Erase>(
-		repository, version, errCode, anotherExistingUserId, cursorPos, eraseSize
+		repository, version, errCode, sessionId, cursorPos, eraseSize
 	);
 	EXPECT_EQ(eraseDst, ResponseType::broadcast);
 	EXPECT_EQ(eraseOut.header.type, msg::MessageType::erase);
@@ -436,4 +460,480 @@ TEST(RepositoryTests, JoinedUserEraseFromDocTest) {
 	EXPECT_FALSE(std::remove(userDbPath.c_str()));
 	EXPECT_FALSE(std::remove(docDbPath.c_str()));
 	EXPECT_FALSE(std::remove(docFileForWrite.c_str()));
-}
\ No newline at end of file
+}
+
+TEST(RepositoryTests, UndoAndRedoWriteTest) {
+	const std::string docFileForWrite = existingUserId + "-" + "test.txt";
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	const std::string originalText = "This is test for write\nIt will be updated during some tests and then deleted\n";
+	const std::string updatedText = "This is test for write\nIt will be updated by unit test during some tests and then deleted\n";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger };
+	fillUserDb(userDbPath);
+	fillDocDb(docDbPath);
+	createDocFileForWrite(docFileForWrite);
+
+	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<2>>(
+		repository, version, errCode, existingUserId, "test.txt"
+	);
+	const uint32_t sessionId = loginSession(repository, existingUsername);
+	processMsg<msg::Write, msg::Write>(
+		repository, version, errCode, sessionId, cursorPos, "by unit test "
+	);
+	auto [undoOut, undoDst] = processMsg<msg::Undo, msg::Erase>(
+		repository, version, errCode, existingUserId
+	);
+	EXPECT_EQ(undoDst, ResponseType::broadcast);
+	EXPECT_EQ(undoOut.header.type, msg::MessageType::erase);
+	EXPECT_EQ(undoOut.eraseSize, 13);
+	EXPECT_EQ(undoOut.cursorPos.X, cursorPos.X + 13);
+	auto [joinOut, joinDst] = processMsg<msg::Join, msg::ServerResponse<1>>(
+		repository, version, errCode, anotherExistingUserId, loadOut.messages[1]
+	);
+	EXPECT_EQ(joinOut.messages[0], originalText);
+
+	auto [redoOut, redoDst] = processMsg<msg::Redo, msg::Write>(
+		repository, version, errCode, existingUserId
+	);
+	EXPECT_EQ(redoDst, ResponseType::broadcast);
+	EXPECT_EQ(redoOut.header.type, msg::MessageType::write);
+	EXPECT_EQ(redoOut.text, "by unit test ");
+	auto [joinOut2, joinDst2] = processMsg<msg::Join, msg::ServerResponse<1>>(
+		repository, version, errCode, anotherExistingUserId, loadOut.messages[1]
+	);
+	EXPECT_EQ(joinOut2.messages[0], updatedText);
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docFileForWrite.c_str()));
+}
+
+TEST(RepositoryTests, UndoOfShiftedWriteIsRejectedTest) {
+	const std::string docFileForWrite = existingUserId + "-" + "test.txt";
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	const std::string shiftedText = "This is test for write\nXXIt will be updated by unit test during some tests and then deleted\n";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger };
+	fillUserDb(userDbPath);
+	fillDocDb(docDbPath);
+	createDocFileForWrite(docFileForWrite);
+
+	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<2>>(
+		repository, version, errCode, existingUserId, "test.txt"
+	);
+	const uint32_t sessionId = loginSession(repository, existingUsername);
+	processMsg<msg::Write, msg::Write>(
+		repository, version, errCode, sessionId, cursorPos, "by unit test "
+	);
+	// Another user writes in front of it, the stored position now points two letters too far left
+	processMsg<msg::Join, msg::ServerResponse<1>>(
+		repository, version, errCode, anotherExistingUserId, loadOut.messages[1]
+	);
+	const uint32_t anotherSessionId = loginSession(repository, anotherExistingUsername);
+	const COORD lineStart{ 0, 1 };
+	const std::string shift = "XX";
+	processMsg<msg::Write, msg::Write>(
+		repository, version, errCode, anotherSessionId, lineStart, shift
+	);
+	auto [undoOut, undoDst] = processMsg<msg::Undo, msg::ServerResponse<1>>(
+		repository, version, errCode, existingUserId
+	);
+	EXPECT_EQ(undoDst, ResponseType::unicast);
+	EXPECT_EQ(undoOut.header.type, msg::MessageType::error);
+	auto [joinOut, joinDst] = processMsg<msg::Join, msg::ServerResponse<1>>(
+		repository, version, errCode, anotherExistingUserId, loadOut.messages[1]
+	);
+	EXPECT_EQ(joinOut.messages[0], shiftedText);
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docFileForWrite.c_str()));
+}
+
+TEST(RepositoryTests, UndoEraseAndNothingToUndoTest) {
+	const std::string docFileForWrite = existingUserId + "-" + "test.txt";
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger };
+	fillUserDb(userDbPath);
+	fillDocDb(docDbPath);
+	createDocFileForWrite(docFileForWrite);
+
+	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<2>>(
+		repository, version, errCode, existingUserId, "test.txt"
+	);
+	const uint32_t sessionId = loginSession(repository, existingUsername);
+	processMsg<msg::Erase, msg::Erase>(
+		repository, version, errCode, sessionId, cursorPos, eraseSize
+	);
+	auto [undoOut, undoDst] = processMsg<msg::Undo, msg::Write>(
+		repository, version, errCode, existingUserId
+	);
+	EXPECT_EQ(undoDst, ResponseType::broadcast);
+	EXPECT_EQ(undoOut.header.type, msg::MessageType::write);
+	EXPECT_EQ(undoOut.text, "e\nIt will be updated ");
+	auto [joinOut, joinDst] = processMsg<msg::Join, msg::ServerResponse<1>>(
+		repository, version, errCode, anotherExistingUserId, loadOut.messages[1]
+	);
+	EXPECT_EQ(joinOut.messages[0], "This is test for write\nIt will be updated during some tests and then deleted\n");
+
+	auto [emptyOut, emptyDst] = processMsg<msg::Undo, msg::ServerResponse<1>>(
+		repository, version, errCode, existingUserId
+	);
+	EXPECT_EQ(emptyDst, ResponseType::unicast);
+	EXPECT_EQ(emptyOut.header.type, msg::MessageType::error);
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docFileForWrite.c_str()));
+}
+
+TEST(RepositoryTests, SessionIdIsKeptAcrossLoginsTest) {
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger };
+	fillUserDb(userDbPath);
+
+	const uint32_t first = loginSession(repository, existingUsername);
+	const uint32_t second = loginSession(repository, anotherExistingUsername);
+	EXPECT_NE(first, second);
+	EXPECT_EQ(loginSession(repository, existingUsername), first);
+
+	// Session without an active document cannot edit anything
+	auto [writeOut, writeDst] = processMsg<msg::Write, msg::ServerResponse<1>>(
+		repository, version, errCode, first, cursorPos, "text"
+	);
+	EXPECT_EQ(writeDst, ResponseType::unicast);
+	EXPECT_EQ(writeOut.header.type, msg::MessageType::error);
+	const uint32_t unknown = 1000;
+	auto [eraseOut, eraseDst] = processMsg<msg::Erase, msg::ServerResponse<1>>(
+		repository, version, errCode, unknown, cursorPos, eraseSize
+	);
+	EXPECT_EQ(eraseOut.header.type, msg::MessageType::error);
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+}
+
+TEST(RepositoryTests, SessionIsBoundToItsConnectionTest) {
+	const std::string docFileForWrite = existingUserId + "-" + "test.txt";
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger };
+	fillUserDb(userDbPath);
+	fillDocDb(docDbPath);
+	createDocFileForWrite(docFileForWrite);
+
+	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<2>>(
+		repository, version, errCode, existingUserId, "test.txt"
+	);
+	const uint32_t sessionId = loginSession(repository, existingUsername);
+	auto writeFrom = [&](const uint64_t connection) {
+		msg::Buffer buffer{ 128 };
+		msg::Write{ version, errCode, sessionId, cursorPos, "text" }.serializeTo(buffer);
+		return repository.process(buffer, connection).second;
+	};
+	// Someone else guessing the session id
+	const uint64_t otherConnection = 5;
+	EXPECT_EQ(writeFrom(otherConnection), ResponseType::unicast);
+	EXPECT_EQ(writeFrom(0), ResponseType::broadcast);
+
+	// The user reconnected and proved it with its token
+	msg::Buffer buffer{ 128 };
+	msg::Resync{ version, errCode, existingUserId, loadOut.messages[1], 0 }.serializeTo(buffer);
+	repository.process(buffer, otherConnection);
+	EXPECT_EQ(writeFrom(otherConnection), ResponseType::broadcast);
+	EXPECT_EQ(writeFrom(0), ResponseType::unicast);
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docFileForWrite.c_str()));
+}
+
+TEST(RepositoryTests, ClosedConnectionLosesItsSessionTest) {
+	const std::string docFileForWrite = existingUserId + "-" + "test.txt";
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger };
+	fillUserDb(userDbPath);
+	fillDocDb(docDbPath);
+	createDocFileForWrite(docFileForWrite);
+
+	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<2>>(
+		repository, version, errCode, existingUserId, "test.txt"
+	);
+	const uint32_t sessionId = loginSession(repository, existingUsername);
+	auto writeFrom = [&](const uint64_t connection) {
+		msg::Buffer buffer{ 128 };
+		msg::Write{ version, errCode, sessionId, cursorPos, "text" }.serializeTo(buffer);
+		return repository.process(buffer, connection).second;
+	};
+	EXPECT_EQ(writeFrom(0), ResponseType::broadcast);
+
+	// The next connection which gets the same socket handle is someone else
+	repository.closeConnection(0);
+	EXPECT_EQ(writeFrom(0), ResponseType::unicast);
+
+	loginSession(repository, existingUsername);
+	EXPECT_EQ(writeFrom(0), ResponseType::broadcast);
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docFileForWrite.c_str()));
+}
+
+TEST(RepositoryTests, BigDocIsStreamedAsBodyTest) {
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	const std::string docPath = existingUserId + "-" + name + ".txt";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger };
+	fillUserDb(userDbPath);
+	fillDocDb(docDbPath);
+	const std::string docTxt(3 * msg::chunkSize + 5, 'x');
+	{
+		std::ofstream docFile(docPath, std::ostream::out);
+		docFile << docTxt;
+	}
+
+	msg::Buffer buffer{ 128 };
+	msg::Load{ version, errCode, existingUserId, name + ".txt" }.serializeTo(buffer);
+	auto [outBuff, dst] = repository.process(buffer);
+	auto out = msg::ServerResponse<2>::parse(outBuff);
+	EXPECT_EQ(dst, ResponseType::unicast);
+	EXPECT_EQ(out.header.type, msg::MessageType::load);
+	EXPECT_EQ(out.messages[0], "");
+	ASSERT_TRUE(outBuff.body);
+	EXPECT_EQ(*outBuff.body, docTxt);
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docPath.c_str()));
+}
+
+TEST(RepositoryTests, BatchIsAppliedUpToFirstFailingOpTest) {
+	const std::string docFileForWrite = existingUserId + "-" + "test.txt";
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger };
+	fillUserDb(userDbPath);
+	fillDocDb(docDbPath);
+	createDocFileForWrite(docFileForWrite);
+
+	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<2>>(
+		repository, version, errCode, existingUserId, "test.txt"
+	);
+	std::pmr::vector<msg::BatchOp> ops{
+		msg::BatchOp{ msg::MessageType::write, cursorPos, "by unit test ", 0 },
+		msg::BatchOp{ msg::MessageType::erase, COORD{ 32, 1 }, "", 5 },
+		msg::BatchOp{ msg::MessageType::write, COORD{ 100, 50 }, "never written", 0 }
+	};
+	msg::Buffer buffer{ 128 };
+	const uint32_t sessionId = loginSession(repository, existingUsername);
+	msg::Batch{ version, errCode, sessionId, ops }.serializeTo(buffer);
+	auto [outBuff, dst] = repository.process(buffer);
+	auto [out, valid] = msg::Batch::parse(outBuff);
+	EXPECT_EQ(dst, ResponseType::broadcast);
+	EXPECT_TRUE(valid);
+	EXPECT_EQ(out.header.type, msg::MessageType::batch);
+	EXPECT_EQ(out.sessionId, sessionId);
+	ASSERT_EQ(out.ops.size(), 2);
+	EXPECT_EQ(out.ops[0].text, "by unit test ");
+	EXPECT_EQ(out.ops[1].eraseSize, 5);
+
+	auto [joinOut, joinDst] = processMsg<msg::Join, msg::ServerResponse<1>>(
+		repository, version, errCode, anotherExistingUserId, loadOut.messages[1]
+	);
+	EXPECT_EQ(joinOut.messages[0], "This is test for write\nIt will be updated by unit during some tests and then deleted\n");
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docFileForWrite.c_str()));
+}
+
+TEST(RepositoryTests, ResyncSendsMissedEditsTest) {
+	const std::string docFileForWrite = existingUserId + "-" + "test.txt";
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger };
+	fillUserDb(userDbPath);
+	fillDocDb(docDbPath);
+	createDocFileForWrite(docFileForWrite);
+
+	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<3>>(
+		repository, msg::resyncVersion, errCode, existingUserId, "test.txt"
+	);
+	EXPECT_EQ(loadOut.messages[2], "0");
+	const uint32_t sessionId = loginSession(repository, existingUsername);
+	auto [firstOut, firstDst] = processMsg<msg::Write, msg::Write>(
+		repository, msg::resyncVersion, errCode, sessionId, cursorPos, "first "
+	);
+	auto [secondOut, secondDst] = processMsg<msg::Write, msg::Write>(
+		repository, msg::resyncVersion, errCode, sessionId, cursorPos, "second "
+	);
+	EXPECT_EQ(firstOut.revision, 1);
+	EXPECT_EQ(secondOut.revision, 2);
+
+	msg::Buffer buffer{ 128 };
+	msg::Resync{ msg::resyncVersion, errCode, anotherExistingUserId, loadOut.messages[1], 1 }.serializeTo(buffer);
+	auto [outBuff, resyncDst] = repository.process(buffer);
+	auto [resyncOut, resyncValid] = msg::ResyncReply::parse(outBuff);
+	EXPECT_TRUE(resyncValid);
+	EXPECT_EQ(resyncDst, ResponseType::unicast);
+	EXPECT_EQ(resyncOut.header.type, msg::MessageType::resync);
+	EXPECT_EQ(resyncOut.revision, 2);
+	EXPECT_FALSE(resyncOut.snapshot);
+
+	msg::FrameReader reader;
+	reader.append(resyncOut.payload.data(), resyncOut.payload.size());
+	msg::Buffer frame{ 128 };
+	ASSERT_TRUE(reader.next(frame));
+	auto [missed, valid] = msg::WriteView::parse(frame);
+	EXPECT_TRUE(valid);
+	EXPECT_EQ(missed.text, "second ");
+	EXPECT_EQ(missed.revision, 2);
+	EXPECT_FALSE(reader.next(frame));
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docFileForWrite.c_str()));
+}
+
+TEST(RepositoryTests, UnappliedEditGetsNoRevisionTest) {
+	const std::string docFileForWrite = existingUserId + "-" + "test.txt";
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger };
+	fillUserDb(userDbPath);
+	fillDocDb(docDbPath);
+	createDocFileForWrite(docFileForWrite);
+
+	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<3>>(
+		repository, msg::resyncVersion, errCode, existingUserId, "test.txt"
+	);
+	const uint32_t sessionId = loginSession(repository, existingUsername);
+	const COORD farPos{ 100, 50 };
+	auto [writeOut, writeDst] = processMsg<msg::Write, msg::ServerResponse<1>>(
+		repository, msg::resyncVersion, errCode, sessionId, farPos, "never written"
+	);
+	EXPECT_EQ(writeDst, ResponseType::unicast);
+	EXPECT_EQ(writeOut.header.type, msg::MessageType::error);
+	auto [eraseOut, eraseDst] = processMsg<msg::Erase, msg::ServerResponse<1>>(
+		repository, msg::resyncVersion, errCode, sessionId, farPos, eraseSize
+	);
+	EXPECT_EQ(eraseDst, ResponseType::unicast);
+	EXPECT_EQ(eraseOut.header.type, msg::MessageType::error);
+
+	auto [appliedOut, appliedDst] = processMsg<msg::Write, msg::Write>(
+		repository, msg::resyncVersion, errCode, sessionId, cursorPos, "applied "
+	);
+	EXPECT_EQ(appliedDst, ResponseType::broadcast);
+	EXPECT_EQ(appliedOut.revision, 1);
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docFileForWrite.c_str()));
+}
+
+TEST(RepositoryTests, EditsOfTwoDocsAreKeptApartTest) {
+	const std::string docFileForWrite = existingUserId + "-" + "test.txt";
+	const std::string createdDocFile = anotherExistingUserId + "-" + filename;
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger };
+	fillUserDb(userDbPath);
+	fillDocDb(docDbPath);
+	createDocFileForWrite(docFileForWrite);
+
+	const uint32_t loadingSession = loginSession(repository, existingUsername);
+	const uint32_t creatingSession = loginSession(repository, anotherExistingUsername);
+	const uint64_t loadingConnection = 1;
+	const uint64_t creatingConnection = 2;
+	msg::Buffer buffer{ 128 };
+	msg::Load{ msg::resyncVersion, errCode, existingUserId, "test.txt" }.serializeTo(buffer);
+	EXPECT_EQ(repository.process(buffer, loadingConnection).second, ResponseType::unicast);
+	buffer.clear();
+	msg::Create{ msg::resyncVersion, errCode, anotherExistingUserId, filename }.serializeTo(buffer);
+	EXPECT_EQ(repository.process(buffer, creatingConnection).second, ResponseType::unicast);
+
+	auto writeFrom = [&](const uint32_t sessionId, const uint64_t connection) {
+		msg::Buffer write{ 128 };
+		msg::Write{ msg::resyncVersion, errCode, sessionId, COORD{ 0, 0 }, "text" }.serializeTo(write);
+		auto [out, dst] = repository.process(write, connection);
+		EXPECT_EQ(dst, ResponseType::broadcast);
+		auto [parsed, valid] = msg::WriteView::parse(out);
+		EXPECT_TRUE(valid);
+		return std::pair<uint32_t, uint32_t>{ out.docId, parsed.revision };
+	};
+	auto [loadedDoc, loadedRevision] = writeFrom(loadingSession, loadingConnection);
+	auto [createdDoc, createdRevision] = writeFrom(creatingSession, creatingConnection);
+	EXPECT_NE(loadedDoc, createdDoc);
+	// Each document counts its own revisions, so their edits must not reach clients of the other
+	EXPECT_EQ(loadedRevision, 1);
+	EXPECT_EQ(createdRevision, 1);
+
+	std::unordered_map<uint64_t, uint32_t> docs;
+	repository.docsOfConnections(docs);
+	EXPECT_EQ(docs.size(), 2);
+	EXPECT_EQ(docs[loadingConnection], loadedDoc);
+	EXPECT_EQ(docs[creatingConnection], createdDoc);
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docFileForWrite.c_str()));
+	EXPECT_FALSE(std::remove(createdDocFile.c_str()));
+}
+
+TEST(RepositoryTests, ResyncAfterEvictionSendsSnapshotTest) {
+	const std::string docFileForWrite = existingUserId + "-" + "test.txt";
+	const std::string name = testing::UnitTest::GetInstance()->current_test_info()->name();
+	const std::string userDbPath = name + "Users.csv";
+	const std::string docDbPath = name + "Docs.csv";
+	logs::Logger logger("test.log");
+	Repository repository{ userDbPath, docDbPath, logger, 16 };
+	fillUserDb(userDbPath);
+	fillDocDb(docDbPath);
+	createDocFileForWrite(docFileForWrite);
+
+	auto [loadOut, loadDst] = processMsg<msg::Load, msg::ServerResponse<3>>(
+		repository, msg::resyncVersion, errCode, existingUserId, "test.txt"
+	);
+	const uint32_t sessionId = loginSession(repository, existingUsername);
+	for (int i = 0; i < 3; i++) {
+		processMsg<msg::Write, msg::Write>(repository, msg::resyncVersion, errCode, sessionId, cursorPos, "evicted ");
+	}
+
+	msg::Buffer buffer{ 128 };
+	msg::Resync{ msg::resyncVersion, errCode, anotherExistingUserId, loadOut.messages[1], 0 }.serializeTo(buffer);
+	auto [outBuff, resyncDst] = repository.process(buffer);
+	auto [resyncOut, resyncValid] = msg::ResyncReply::parse(outBuff);
+	EXPECT_TRUE(resyncValid);
+	EXPECT_EQ(resyncOut.header.type, msg::MessageType::resync);
+	EXPECT_EQ(resyncOut.revision, 3);
+	EXPECT_TRUE(resyncOut.snapshot);
+	EXPECT_EQ(resyncOut.payload, "This is test for write\nIt will be updated evicted evicted evicted during some tests and then deleted\n");
+
+	EXPECT_FALSE(std::remove(userDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docDbPath.c_str()));
+	EXPECT_FALSE(std::remove(docFileForWrite.c_str()));
+}
@@ -0,0 +1,45 @@
+#include "pch.h"
+#include <string>
+
+#include "revision_log.h"
+
+std::vector<std::string> unframe(msg::Buffer& frames) {
+	msg::FrameReader reader;
+	reader.append(frames.get(), frames.size);
+	std::vector<std::string> messages;
+	msg::Buffer frame{ 128 };
+	while (reader.next(frame)) {
+		messages.emplace_back(frame.get(), frame.size);
+	}
+	return messages;
+}
+
+TEST(RevisionLogTests, CollectsEditsAfterRevisionTest) {
+	RevisionLog log{ 1024 };
+	log.append(1, "first");
+	log.append(2, "second");
+	log.append(3, "third");
+	EXPECT_EQ(log.latest(), 3);
+
+	msg::Buffer frames{ 128 };
+	ASSERT_TRUE(log.collect(1, frames));
+	EXPECT_EQ(unframe(frames), (std::vector<std::string>{ "second", "third" }));
+
+	frames.clear();
+	ASSERT_TRUE(log.collect(3, frames));
+	EXPECT_EQ(frames.size, 0);
+	EXPECT_FALSE(log.collect(4, frames));
+}
+
+TEST(RevisionLogTests, EvictedRevisionsCannotBeCollectedTest) {
+	RevisionLog log{ 10 };
+	log.append(1, "12345");
+	log.append(2, "12345");
+	log.append(3, "12345");
+	EXPECT_EQ(log.usedBytes(), 10);
+
+	msg::Buffer frames{ 128 };
+	EXPECT_FALSE(log.collect(0, frames));
+	ASSERT_TRUE(log.collect(1, frames));
+	EXPECT_EQ(unframe(frames).size(), 2);
+}
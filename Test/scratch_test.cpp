@@ -0,0 +1,44 @@
+#include "pch.h"
+#include <string>
+#include <vector>
+
+#include "scratch.h"
+#include "messages.h"
+
+TEST(ScratchTests, ResetRewindsArenaTest) {
+	scratch::Arena arena{ 1024 };
+	std::pmr::vector<int> numbers{ &arena };
+	numbers.reserve(16);
+	const int* first = numbers.data();
+	EXPECT_EQ(arena.used(), 16 * sizeof(int));
+
+	std::pmr::string tooBig(2048, 'x', &arena);
+	EXPECT_EQ(arena.used(), 16 * sizeof(int));
+	EXPECT_GE(arena.overflowed(), 2048);
+
+	numbers.clear();
+	numbers.shrink_to_fit();
+	tooBig = std::pmr::string{ &arena };
+	arena.reset();
+	EXPECT_EQ(arena.used(), 0);
+	EXPECT_EQ(arena.overflowed(), 0);
+	std::pmr::vector<int> again{ &arena };
+	again.reserve(16);
+	EXPECT_EQ(again.data(), first);
+}
+
+TEST(ScratchTests, BatchOpsAreParsedIntoArenaTest) {
+	msg::Buffer buffer{ 128 };
+	msg::Batch{ msg::timedVersion, 0, 7, {
+		msg::BatchOp{ msg::MessageType::write, COORD{ 1, 2 }, "letters", 0 },
+		msg::BatchOp{ msg::MessageType::erase, COORD{ 3, 4 }, "", 2 }
+	} }.serializeTo(buffer);
+
+	scratch::Arena arena;
+	auto [batch, valid] = msg::Batch::parse(buffer, &arena);
+	ASSERT_TRUE(valid);
+	ASSERT_EQ(batch.ops.size(), 2);
+	EXPECT_EQ(batch.ops[0].text, "letters");
+	EXPECT_EQ(batch.ops.get_allocator().resource(), &arena);
+	EXPECT_EQ(arena.used(), 2 * sizeof(msg::BatchOp));
+}
@@ -0,0 +1,52 @@
+#include "pch.h"
+
+#include "send_queue.h"
+
+constexpr SOCKET slowReader = 1;
+constexpr SOCKET fastReader = 2;
+
+TEST(SendQueueTests, ReaderWhichNeverReadsHitsTheLimitTest) {
+	SendQueue queue{ 1000 };
+	const std::string frame(100, 'a');
+	size_t queued = 0;
+	while (queue.push(slowReader, PendingSend{ frame, 0 })) {
+		queued++;
+		ASSERT_LE(queued, 10);
+	}
+	EXPECT_EQ(queued, 10);
+	EXPECT_EQ(queue.bytesOf(slowReader), 1000);
+	EXPECT_EQ(queue.sendCount(), 10);
+
+	// Other sockets keep their own budget
+	EXPECT_TRUE(queue.push(fastReader, PendingSend{ frame, 0 }));
+	queue.erase(slowReader);
+	EXPECT_FALSE(queue.contains(slowReader));
+	EXPECT_EQ(queue.bytesOf(slowReader), 0);
+	EXPECT_EQ(queue.sendCount(), 1);
+}
+
+TEST(SendQueueTests, SentBytesAreNotCountedTest) {
+	SendQueue queue{ 1000 };
+	ASSERT_TRUE(queue.push(slowReader, PendingSend{ std::string(100, 'a'), 60 }));
+	EXPECT_EQ(queue.bytesOf(slowReader), 40);
+	ASSERT_TRUE(queue.push(slowReader, PendingSend{ std::string(100, 'b'), 0 }));
+	EXPECT_EQ(queue.bytesOf(slowReader), 140);
+
+	queue.pop(slowReader);
+	EXPECT_EQ(queue.bytesOf(slowReader), 100);
+	EXPECT_EQ(queue.front(slowReader)->frame[0], 'b');
+	queue.pop(slowReader);
+	EXPECT_FALSE(queue.contains(slowReader));
+	EXPECT_EQ(queue.front(slowReader), nullptr);
+}
+
+TEST(SendQueueTests, BodyBiggerThanTheLimitIsTakenOnlyAloneTest) {
+	SendQueue queue{ 1000 };
+	auto body = std::make_shared<const std::string>(5000, 'a');
+	ASSERT_TRUE(queue.push(slowReader, PendingSend{ "", 0, body, 0, 1 }));
+	EXPECT_EQ(queue.bytesOf(slowReader), 5000);
+	EXPECT_FALSE(queue.push(slowReader, PendingSend{ "frame", 0 }));
+
+	ASSERT_TRUE(queue.push(fastReader, PendingSend{ "frame", 0 }));
+	EXPECT_FALSE(queue.push(fastReader, PendingSend{ "", 0, body, 0, 1 }));
+}
@@ -0,0 +1,55 @@
+#include "pch.h"
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "spans.h"
+
+namespace {
+	size_t occurrences(const std::string& text, const std::string& part) {
+		size_t count = 0;
+		for (size_t pos = text.find(part); pos != std::string::npos; pos = text.find(part, pos + 1)) {
+			count++;
+		}
+		return count;
+	}
+}
+
+TEST(SpansTests, DumpsScopesOfAllThreadsAsChromeTraceTest) {
+	std::thread worker{ []() {
+		spans::Scope scope{ "SpansTests::worker" };
+	} };
+	worker.join();
+	{
+		spans::Scope outer{ "SpansTests::outer" };
+		spans::Scope ended{ "SpansTests::ended" };
+		ended.end();
+	}
+
+	std::ostringstream out;
+	spans::dump(out);
+	const std::string json = out.str();
+	EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0);
+	EXPECT_EQ(occurrences(json, "\"name\":\"SpansTests::worker\",\"ph\":\"X\""), 1);
+	EXPECT_EQ(occurrences(json, "\"name\":\"SpansTests::outer\""), 1);
+	// Ending a span early records it once, not again when it goes out of scope
+	EXPECT_EQ(occurrences(json, "\"name\":\"SpansTests::ended\""), 1);
+}
+
+TEST(SpansTests, KeepsNewestSpansOfFullRingTest) {
+	std::thread worker{ []() {
+		const auto now = std::chrono::steady_clock::now();
+		spans::record("SpansTests::oldest", now, now);
+		for (size_t i = 0; i < spans::ringCapacity; i++) {
+			spans::record("SpansTests::newer", now, now);
+		}
+	} };
+	worker.join();
+
+	std::ostringstream out;
+	spans::dump(out);
+	const std::string json = out.str();
+	EXPECT_EQ(occurrences(json, "SpansTests::oldest"), 0);
+	// The oldest slot of a full ring is the next one written, it is left out as it may be half written
+	EXPECT_EQ(occurrences(json, "SpansTests::newer"), spans::ringCapacity - 1);
+}
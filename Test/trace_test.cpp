@@ -0,0 +1,136 @@
+#include "pch.h"
+#include <string>
+#include <cstdio>
+
+#include "trace.h"
+
+namespace {
+	const std::string tracePassword = "tracerSecret";
+	const std::string traceFilename = "traced.txt";
+
+	// Processes the msg like a server worker would, recording the request and its response
+	template<typename MESSAGE, typename... Args>
+	msg::Buffer& serve(Repository& repo, trace::Recorder& recorder, const SOCKET client, msg::Buffer& buffer, Args&&... args) {
+		buffer.clear();
+		MESSAGE message{ args... };
+		message.serializeTo(buffer);
+		recorder.request(client, buffer);
+		auto [response, responseType] = repo.process(buffer);
+		if (responseType == ResponseType::unicast) {
+			recorder.response(client, response);
+		}
+		return response;
+	}
+
+	std::string loginToken(Repository& repo, const std::string& username, const std::string& password) {
+		msg::Buffer buffer{ 128 };
+		msg::Login{ msg::timedVersion, 0, username, password }.serializeTo(buffer);
+		return msg::ServerResponse<2>::parse(repo.process(buffer).first).messages[0];
+	}
+}
+
+TEST(TraceTests, ReadsBackRecordedEventsTest) {
+	const std::string path = "ReadsBackRecordedEventsTest.trace";
+	{
+		trace::Recorder recorder{ path };
+		ASSERT_TRUE(recorder.valid());
+		msg::Buffer buffer{ 128 };
+		msg::Write{ msg::timedVersion, 0, 3, COORD{ 1, 2 }, "abc", 7, 99 }.serializeTo(buffer);
+		recorder.request(100, buffer);
+		recorder.request(200, buffer);
+		recorder.closed(100);
+		recorder.request(300, buffer);
+	}
+
+	trace::Reader reader{ path };
+	ASSERT_TRUE(reader.valid());
+	trace::Event event;
+	std::vector<std::pair<trace::EventKind, uint32_t>> events;
+	std::chrono::microseconds previous{ 0 };
+	while (reader.next(event)) {
+		events.emplace_back(event.kind, event.connection);
+		EXPECT_GE(event.at, previous);
+		previous = event.at;
+		if (event.kind == trace::EventKind::request) {
+			auto [write, valid] = msg::WriteView::parse(event.message);
+			ASSERT_TRUE(valid);
+			EXPECT_EQ(write.text, "abc");
+			EXPECT_EQ(write.sentAt, 99);
+		}
+	}
+	EXPECT_FALSE(reader.corrupted());
+	// Connection 0 is free again after the close, the next socket gets it
+	const std::vector<std::pair<trace::EventKind, uint32_t>> expected{ { trace::EventKind::request, 0 }, { trace::EventKind::request, 1 },
+		{ trace::EventKind::closed, 0 }, { trace::EventKind::request, 0 } };
+	EXPECT_EQ(events, expected);
+	EXPECT_FALSE(std::remove(path.c_str()));
+}
+
+TEST(TraceTests, DetectsTruncatedTraceTest) {
+	const std::string path = "DetectsTruncatedTraceTest.trace";
+	{
+		trace::Recorder recorder{ path };
+		msg::Buffer buffer{ 128 };
+		msg::Undo{ msg::timedVersion, 0, "token" }.serializeTo(buffer);
+		recorder.request(1, buffer);
+	}
+	std::string content;
+	{
+		std::ifstream in{ path, std::ios::binary };
+		content.assign(std::istreambuf_iterator<char>{ in }, {});
+	}
+	{
+		std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+		out.write(content.data(), content.size() - 2);
+	}
+
+	trace::Reader reader{ path };
+	trace::Event event;
+	EXPECT_FALSE(reader.next(event));
+	EXPECT_TRUE(reader.corrupted());
+	EXPECT_FALSE(std::remove(path.c_str()));
+}
+
+TEST(TraceTests, ReplaysWithIdentifiersOfFreshRepositoryTest) {
+	const std::string path = "ReplaysWithIdentifiersOfFreshRepositoryTest.trace";
+	logs::Logger logger{ "ReplaysWithIdentifiersOfFreshRepositoryTest.log" };
+	std::string recordedToken;
+	{
+		Repository recorded{ "RecordedUsers.csv", "RecordedDocs.csv", logger };
+		trace::Recorder recorder{ path };
+		msg::Buffer buffer{ 128 };
+		const SOCKET client = 5;
+		serve<msg::Register>(recorded, recorder, client, buffer, msg::timedVersion, 0, "tracer", tracePassword);
+		auto login = msg::ServerResponse<2>::parse(serve<msg::Login>(recorded, recorder, client, buffer, msg::timedVersion, 0, "tracer", tracePassword));
+		recordedToken = login.messages[0];
+		const uint32_t sessionId = static_cast<uint32_t>(std::stoul(login.messages[1]));
+		serve<msg::Create>(recorded, recorder, client, buffer, msg::timedVersion, 0, recordedToken, traceFilename);
+		serve<msg::Write>(recorded, recorder, client, buffer, msg::timedVersion, 0, sessionId, COORD{ 0, 0 }, "hello", 0u, 0u);
+		serve<msg::Erase>(recorded, recorder, client, buffer, msg::timedVersion, 0, sessionId, COORD{ 5, 0 }, 2, 1u, 0u);
+		serve<msg::Undo>(recorded, recorder, client, buffer, msg::timedVersion, 0, recordedToken);
+		recorder.closed(client);
+	}
+	std::ifstream traceFile{ path, std::ios::binary };
+	const std::string traced{ std::istreambuf_iterator<char>(traceFile), std::istreambuf_iterator<char>() };
+	traceFile.close();
+	EXPECT_EQ(traced.find(tracePassword), std::string::npos);
+
+	Repository replayed{ "ReplayedUsers.csv", "ReplayedDocs.csv", logger };
+	trace::Replayer replayer{ replayed };
+	trace::Reader reader{ path };
+	auto report = replayer.run(reader, trace::Pace::flatOut);
+	EXPECT_EQ(report.requests, 6);
+	// Create and the edits would fail with the recorded token, it is unknown to the fresh user db
+	EXPECT_EQ(report.errors, 0);
+	EXPECT_EQ(report.processNs.count, 6);
+	// Users are registered and logged in with the same placeholder password
+	const std::string replayedToken = loginToken(replayed, "tracer", trace::redactedPassword);
+	EXPECT_NE(replayedToken, recordedToken);
+
+	EXPECT_FALSE(std::remove((recordedToken + "-" + traceFilename).c_str()));
+	EXPECT_FALSE(std::remove((replayedToken + "-" + traceFilename).c_str()));
+	for (const auto* file : { "RecordedUsers.csv", "RecordedDocs.csv", "ReplayedUsers.csv", "ReplayedDocs.csv" }) {
+		EXPECT_FALSE(std::remove(file));
+	}
+	EXPECT_FALSE(std::remove(path.c_str()));
+}